@@ -25,6 +25,8 @@ const char *FILE_ALREADY_EXISTS = "file already exists.";
 const char *MAKE_TMP_PACKAGE_FAILED = "make tmp-package failed.";
 const char *MERGE_TMP_PACKAGE_FAILED = "merge tmp-package failed.";
 const char *INTERRUPT_ERROR = "interrupt operation may damage the package.";
+const char *PACKAGE_SEALED = "package is sealed.";
+const char *PACKAGE_COMPACTED = "package is compacted.";
 
 // Utils
 
@@ -60,6 +62,19 @@ static void BenchmarkLog(size_t fnum, int64_t microseconds) {
     InfoLog("\tSeconds : %f\n", seconds);
 }
 
+// Names matched by wildcard all start with its literal prefix, only that range of sorted names is scanned
+static bool ForeachMatchedNames(xpack::Package &pack, const std::string &wildcard, std::function<bool(const std::string &name)> callback) {
+    torch::WildcardPattern pattern;
+    int ret = pattern.Compile(wildcard);
+    if (ret < 0) {
+        ErrorLog("%s\n", torch::WildcardMatcher::FormatError(ret));
+        return false;
+    }
+    return pack.ListPrefix(pattern.GetPrefix(), [&](const std::string &name) {
+        return !pattern.Match(name) || callback(name);
+    });
+}
+
 // MainCommand
 
 bool OnCommand_Main(torch::Commander &command, std::vector<std::string> args) {
@@ -116,7 +131,7 @@ bool OnCommand_Add(torch::Commander &command, std::vector<std::string> args) {
     if (force) {
         pack.RemoveEntry(key);
     }
-    if (!pack.AddEntry(key, torch::File::GetBytes(path), crypto, compress)) {
+    if (!pack.AddEntryFromFile(key, path, crypto, compress)) {
         PathStatusLog(args[1], false);
         ErrorLog("%s\n", xpack::GetLastErrorMessage());
         return true;
@@ -159,7 +174,7 @@ bool OnCommand_MultiAdd(torch::Commander &command, std::vector<std::string> args
         if (force) {
             pack.RemoveEntry(args[i]);
         }
-        if (!pack.AddEntry(args[i], torch::File::GetBytes(args[i]), crypto, compress)) {
+        if (!pack.AddEntryFromFile(args[i], args[i], crypto, compress)) {
             PathStatusLog(args[i], false);
             ErrorLog("%s\n", xpack::GetLastErrorMessage());
             break;
@@ -185,15 +200,8 @@ bool OnCommand_Remove(torch::Commander &command, std::vector<std::string> args)
     
     std::string wildcard = args[1];
     std::vector<std::string> removeLater;
-    pack.ForeachEntryNames([&](const std::string &name){
-        int ret = torch::WildcardMatcher::Match(wildcard, name);
-        if (ret == 1) {
-            removeLater.push_back(name);
-        }
-        else if (ret < 0) {
-            ErrorLog("%s\n", torch::WildcardMatcher::FormatError(ret));
-            return false;
-        }
+    ForeachMatchedNames(pack, wildcard, [&](const std::string &name){
+        removeLater.push_back(name);
         return true;
     });
     
@@ -234,18 +242,11 @@ bool OnCommand_Cat(torch::Commander &command, std::vector<std::string> args) {
 
     bool exist = false;
     std::string wildcard = args[1];
-    pack.ForeachEntryNames([&](const std::string &name){
-        int ret = torch::WildcardMatcher::Match(wildcard, name);
-        if (ret == 1) {
-            exist = true;
-            torch::Data content = pack.GetEntryDataByName(name);
-            if (!content.IsNull()) {
-                InfoLog("%s", content.ToString().c_str());
-            }
-        }
-        else if (ret < 0) {
-            ErrorLog("%s\n", torch::WildcardMatcher::FormatError(ret));
-            return false;
+    ForeachMatchedNames(pack, wildcard, [&](const std::string &name){
+        exist = true;
+        torch::Data content = pack.GetEntryDataByName(name);
+        if (!content.IsNull()) {
+            InfoLog("%s", content.ToString().c_str());
         }
         return true;
     });
@@ -273,21 +274,17 @@ bool OnCommand_List(torch::Commander &command, std::vector<std::string> args) {
     }
     std::string wildcard = args.size()>1 ? args[1] : "";
     
-    std::vector<std::string> allnames = pack.GetEntryNames();
     std::vector<std::string> displaynames;
     if (wildcard.length() <= 0) {
-        displaynames = allnames;
+        displaynames = pack.ListPrefix("");
     }
     else {
-        for (auto name : allnames) {
-            int ret = torch::WildcardMatcher::Match(wildcard, name);
-            if (ret == 1) {
-                displaynames.push_back(name);
-            }
-            else if (ret < 0) {
-                ErrorLog("%s\n", torch::WildcardMatcher::FormatError(ret));
-                return true;
-            }
+        bool ok = ForeachMatchedNames(pack, wildcard, [&](const std::string &name){
+            displaynames.push_back(name);
+            return true;
+        });
+        if (!ok) {
+            return true;
         }
     }
     
@@ -305,7 +302,7 @@ bool OnCommand_List(torch::Commander &command, std::vector<std::string> args) {
     if (isDisplayMore) {
         size_t maxl = 0;
         for (auto name : displaynames) {
-            size_t l = torch::ByteToHumanReadableString((int)pack.GetEntrySizeByName(name)).length();
+            size_t l = torch::ByteToHumanReadableString(pack.GetEntrySizeByName(name)).length();
             if (l > maxl) {
                 maxl = l;
             }
@@ -315,7 +312,7 @@ bool OnCommand_List(torch::Commander &command, std::vector<std::string> args) {
             xpack::Context *ctx = pack.GetContxt();
             auto shsct = ctx->hash->GetById(ctx->HashMaker(name, 0));
             auto hsct = ctx->hash->QueryByName(name);
-            uint32_t size = pack.GetEntrySizeByName(name);
+            uint64_t size = pack.GetEntrySizeByName(name);
             std::string stringflags = torch::ToBinaryHumanReadable<uint8_t>(hsct->flags);
             for (int i = 0; i < stringflags.length(); i++) {
                 stringflags[i] = (stringflags[i] == '0') ? '-' : '+';
@@ -326,7 +323,7 @@ bool OnCommand_List(torch::Commander &command, std::vector<std::string> args) {
             info += "   ";
             info += torch::String::Format("%s", stringflags.c_str());
             info += torch::String::LeftPad(torch::String::Format("%d(bi)", hsct->block_index), 9, ' ');
-            info += torch::String::LeftPad(torch::String::Format("%s", torch::ByteToHumanReadableString((int)size).c_str()), (int)maxl + 2, ' ');
+            info += torch::String::LeftPad(torch::String::Format("%s", torch::ByteToHumanReadableString(size).c_str()), (int)maxl + 2, ' ');
             info += torch::String::RightPad(torch::String::Format("%s", shsct->conflict_refc > 0 ? "!C" : " "), 3, ' ');
             InfoLog("%s%s\n", info.c_str(), name.c_str());
         }
@@ -417,8 +414,8 @@ bool OnCommand_Dump(torch::Commander &command, std::vector<std::string> args) {
     }
     if (command.HasOption("--data-offsize")) {
         std::vector<std::string> args = command.GetOptionArgs("--data-offsize");
-        uint32_t offset = (uint32_t)atoll(args[0].c_str());
-        uint32_t size   = (uint32_t)atoll(args[1].c_str());
+        uint64_t offset = (uint64_t)atoll(args[0].c_str());
+        uint64_t size   = (uint64_t)atoll(args[1].c_str());
         InfoLog("%s\n", xpack::DumpUtils::DumpData(pack.GetContxt(), offset, size).c_str());
         return true;
     }
@@ -669,11 +666,55 @@ bool OnCommand_Optimize(torch::Commander &command, std::vector<std::string> args
     return true;
 }
 
+// SubCommand: seal
+
+bool OnCommand_Seal(torch::Commander &command, std::vector<std::string> args) {
+    assert(args.size() == 1);
+    if (!torch::FileSystem::IsFile(args[0])) {
+        ErrorLog("%s\n", PACKAGE_NOT_EXISTS);
+        return true;
+    }
+    xpack::Package pack;
+    if (!pack.Open(args[0], false)) {
+        ErrorLog("%s\n", xpack::GetLastErrorMessage());
+        return true;
+    }
+    if (!pack.Seal() || !pack.Flush()) {
+        ErrorLog("%s\n", xpack::GetLastErrorMessage());
+        return true;
+    }
+    InfoLog("%s\n", PACKAGE_SEALED);
+    return true;
+}
+
+// SubCommand: compact
+
+bool OnCommand_Compact(torch::Commander &command, std::vector<std::string> args) {
+    assert(args.size() == 1);
+    if (!torch::FileSystem::IsFile(args[0])) {
+        ErrorLog("%s\n", PACKAGE_NOT_EXISTS);
+        return true;
+    }
+    xpack::Package pack;
+    if (!pack.Open(args[0], false)) {
+        ErrorLog("%s\n", xpack::GetLastErrorMessage());
+        return true;
+    }
+    uint64_t unused = pack.GetUnusedContentSize();
+    if (!pack.Compact()) {
+        ErrorLog("%s\n", xpack::GetLastErrorMessage());
+        return true;
+    }
+    InfoLog("%s (%s released)\n", PACKAGE_COMPACTED, torch::ByteToHumanReadableString(unused).c_str());
+    return true;
+}
+
 // Benchmark
 
 bool OnCommand_Benchmark(torch::Commander &command, std::vector<std::string> args) {
     assert(args.size() >= 1);
     bool needcrc = command.HasOption("-c");
+    xpack::StreamType stype = command.HasOption("-m") ? xpack::StreamType::Mmap : xpack::StreamType::File;
     
     if (command.HasOption("-p")) {
         std::string path = command.GetOptionArgs("-p").front();
@@ -684,7 +725,7 @@ bool OnCommand_Benchmark(torch::Commander &command, std::vector<std::string> arg
         
         xpack::Package pkg;
         pkg.SetNeedCrcVerify(needcrc);
-        if (!pkg.Open(path)) {
+        if (!pkg.Open(path, true, stype)) {
             ErrorLog("%s\n", xpack::GetLastErrorMessage());
             return true;
         }
@@ -836,6 +877,16 @@ int main(int argc, const char * argv[]) {
     .Usage("usage: xpack optimize <package> [options]")
     .Option("-h", 0, "show subcommand help document", torch::Arguments::CallbackFail);
     
+    // Compact
+    app.SubCommand("compact", 1, "defragment package in place.", OnCommand_Compact)
+    .Usage("usage: xpack compact <package> [options]")
+    .Option("-h", 0, "show subcommand help document", torch::Arguments::CallbackFail);
+    
+    // Seal
+    app.SubCommand("seal", 1, "build perfect hash index for release package.", OnCommand_Seal)
+    .Usage("usage: xpack seal <package> [options]")
+    .Option("-h", 0, "show subcommand help document", torch::Arguments::CallbackFail);
+    
     // Diff
     app.SubCommand("diff", 2, "show two package differences.", OnCommand_Diff)
     .Usage("usage: xpack diff <main-package> <other-package> [options]")
@@ -846,6 +897,7 @@ int main(int argc, const char * argv[]) {
     .Usage("usage: xpack benchmark <filename> [filename ...] [options]")
     .Option("-p", 1, "xpack package path")
     .Option("-c", 0, "package read with crc32 check")
+    .Option("-m", 0, "package read with memory mapped stream")
     .Option("-h", 0, "show subcommand help document", torch::Arguments::CallbackFail);
 
     bool ok = app.Parse(argc, argv);
@@ -11,10 +11,11 @@
 #include <assert.h>
 #include <unordered_map>
 #include <sstream>
+#include <atomic>
 
 using namespace torch;
 
-static int s_allocateCounter = 0;
+static std::atomic<int> s_allocateCounter(0);
 
 void *torch::HeapMalloc(size_t size) {
     ++ s_allocateCounter;
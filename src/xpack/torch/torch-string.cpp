@@ -1081,7 +1081,7 @@ std::string String::Format(const char *fmt, ...)
 
 std::string String::FormatVar(const char *fmt, va_list varlist, size_t buffsize)
 {
-    static char sb[FORMAT_BUFFSIZE];
+    static thread_local char sb[FORMAT_BUFFSIZE];
     memset(sb, 0, FORMAT_BUFFSIZE);
 
     char *ptr = sb;
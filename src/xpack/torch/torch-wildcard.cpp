@@ -8,6 +8,8 @@
 
 #include "torch-wildcard.h"
 #include <assert.h>
+#include <string.h>
+#include <vector>
 extern "C" {
 #include "deps/wildcard/wildcard.h"
 }
@@ -23,3 +25,165 @@ const char* WildcardMatcher::FormatError(int error)
 {
     return wc_error(error);
 }
+
+// Same error codes as deps/wildcard
+enum {
+    WILDCARD_TRAILINGBACKSLASH = -1,
+    WILDCARD_UNCLOSEDCLASS     = -2,
+    WILDCARD_INVALIDRANGE      = -3,
+};
+
+struct WildcardToken {
+    size_t begin;      /* position in wildcard */
+    size_t end;
+    int    literal;    /* unescaped character, -1 for '?', '*' and [...] */
+    bool   star;
+};
+
+// Splits wildcard into tokens with the syntax of wc_match, syntax errors are found for any target
+static int Tokenize(const std::string &wildcard, std::vector<WildcardToken> &tokens)
+{
+    size_t n = wildcard.size();
+    size_t i = 0;
+    while (i < n) {
+        WildcardToken token = { i, 0, -1, false };
+        char c = wildcard[i];
+        if (c == '\\') {
+            if (i + 1 >= n) {
+                return WILDCARD_TRAILINGBACKSLASH;
+            }
+            token.literal = (unsigned char)wildcard[i + 1];
+            i += 2;
+        }
+        else if (c == '?') {
+            i++;
+        }
+        else if (c == '*') {
+            token.star = true;
+            i++;
+        }
+        else if (c == '[') {
+            i++;
+            if (i < n && wildcard[i] == '^') {
+                i++;
+            }
+            while (i >= n || wildcard[i] != ']') {
+                if (i < n && wildcard[i] == '\\') {
+                    i++;
+                }
+                if (i >= n) {
+                    return WILDCARD_UNCLOSEDCLASS;
+                }
+                if (i + 1 < n && wildcard[i + 1] == '-') {
+                    i += 2;
+                    if (i < n && wildcard[i] == ']') {
+                        return WILDCARD_INVALIDRANGE;
+                    }
+                    if (i < n && wildcard[i] == '\\') {
+                        i++;
+                    }
+                    if (i >= n) {
+                        return WILDCARD_UNCLOSEDCLASS;
+                    }
+                }
+                i++;
+            }
+            i++; // ']'
+        }
+        else {
+            token.literal = (unsigned char)c;
+            i++;
+        }
+        token.end = i;
+        tokens.push_back(token);
+    }
+    return 0;
+}
+
+WildcardPattern::WildcardPattern()
+:m_literal(false)
+,m_anymiddle(false)
+,m_compiled(false)
+{
+}
+
+int WildcardPattern::Compile(const std::string &wildcard)
+{
+    m_prefix.clear();
+    m_suffix.clear();
+    m_middle.clear();
+    m_literal = false;
+    m_anymiddle = false;
+    m_compiled = false;
+    
+    std::vector<WildcardToken> tokens;
+    int ret = Tokenize(wildcard, tokens);
+    if (ret < 0) {
+        return ret;
+    }
+    
+    size_t first = 0;
+    while (first < tokens.size() && tokens[first].literal >= 0) {
+        m_prefix.push_back((char)tokens[first++].literal);
+    }
+    size_t last = tokens.size();
+    while (last > first && tokens[last - 1].literal >= 0) {
+        last--;
+    }
+    for (size_t i = last; i < tokens.size(); i++) {
+        m_suffix.push_back((char)tokens[i].literal);
+    }
+    
+    m_literal = first == tokens.size();
+    m_anymiddle = !m_literal;
+    for (size_t i = first; i < last; i++) {
+        m_anymiddle &= tokens[i].star;
+    }
+    if (!m_literal) {
+        m_middle = wildcard.substr(tokens[first].begin, tokens[last - 1].end - tokens[first].begin);
+    }
+    m_compiled = true;
+    return 0;
+}
+
+int WildcardPattern::Match(const std::string &target) const
+{
+    if (!m_compiled) {
+        return 0;
+    }
+    if (m_literal) {
+        return target == m_prefix ? 1 : 0;
+    }
+    
+    // Prefix and suffix are rigid, so they have to sit at both ends
+    size_t size = target.size();
+    if (size < m_prefix.size() + m_suffix.size()) {
+        return 0;
+    }
+    if (memcmp(target.c_str(), m_prefix.c_str(), m_prefix.size()) != 0) {
+        return 0;
+    }
+    if (memcmp(target.c_str() + size - m_suffix.size(), m_suffix.c_str(), m_suffix.size()) != 0) {
+        return 0;
+    }
+    if (m_anymiddle) {
+        return 1;
+    }
+    std::string middle = target.substr(m_prefix.size(), size - m_prefix.size() - m_suffix.size());
+    return wc_match(m_middle.c_str(), middle.c_str()) > 0 ? 1 : 0;
+}
+
+const std::string& WildcardPattern::GetPrefix() const
+{
+    return m_prefix;
+}
+
+const std::string& WildcardPattern::GetSuffix() const
+{
+    return m_suffix;
+}
+
+bool WildcardPattern::IsLiteral() const
+{
+    return m_literal;
+}
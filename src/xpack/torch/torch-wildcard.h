@@ -45,6 +45,49 @@ namespace torch {
         static const char* FormatError(int error);
     };
     
+    /*
+     * 预编译的通配符表达式(语法与WildcardMatcher一致)
+     * 说明：
+     *  - 编译时提取开头和结尾的普通字符(前缀/后缀)，匹配时先用memcmp比较，大部分目标串在此被排除
+     *  - 只有中间部分需要逐字符匹配，例如匹配dir目录下扩展名为.ext的表达式，比较前后缀后即可得出结果
+     *  - 目标集合有序时，可以先用GetPrefix()缩小范围，再逐个匹配
+     */
+    class WildcardPattern {
+    public:
+        WildcardPattern();
+        
+        /*
+         * 编译通配符表达式
+         * 返回值：成功返回0，若返回小于0则代表通配符表达式有语法错误(错误码与WildcardMatcher::Match一致)
+         */
+        int Compile(const std::string &wildcard);
+        
+        /*
+         * 匹配目标串
+         * 返回值：若匹配成功则返回1，否则返回0(未编译成功时总是返回0)
+         */
+        int Match(const std::string &target) const;
+        
+        /*
+         * 获得表达式开头/结尾的普通字符(已去除转义)
+         */
+        const std::string& GetPrefix() const;
+        const std::string& GetSuffix() const;
+        
+        /*
+         * 表达式是否不包含任何通配符(只能匹配与前缀相同的目标串)
+         */
+        bool IsLiteral() const;
+        
+    private:
+        std::string m_prefix;
+        std::string m_suffix;
+        std::string m_middle;      /* wildcard between prefix and suffix, original syntax */
+        bool        m_literal;
+        bool        m_anymiddle;   /* middle is made of '*' only */
+        bool        m_compiled;
+    };
+    
 }
 
 #endif /* __TORCH__WILDCARD__ */
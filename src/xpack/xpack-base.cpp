@@ -42,9 +42,14 @@ uint32_t xpack::HashString(const std::string &s, uint8_t seed) {
     return torch::Hash::XXHash32(s.c_str(), s.length(), GetPrimeNumber(seed));
 }
 
+uint64_t xpack::FingerprintString(const std::string &s) {
+    return torch::Hash::x64::Murmur64(s.c_str(), s.length(), 0x58504B46 /* 'XPKF' */);
+}
+
 // LastError
 
-static int __xpack_error_code = 0;
+// Error code is per thread, so concurrent readers do not clobber each other
+static thread_local int __xpack_error_code = 0;
 
 void xpack::SetLastError(int errcode) {
     __xpack_error_code = errcode;
@@ -80,6 +85,10 @@ const char* xpack::GetLastErrorMessage()
             return "file not exists.";
         case (int)xpack::Error::Compress:
             return "compress error.";
+        case (int)xpack::Error::NotSupport:
+            return "operation not support.";
+        case (int)xpack::Error::InvalidHandle:
+            return "entry handle is invalid.";
             
         case (int)xpack::Error::Unknow:
         default:
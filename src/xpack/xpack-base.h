@@ -22,8 +22,17 @@ namespace xpack {
      */
     uint32_t HashString(const std::string &s, uint8_t seed = 0);
 
+    /*
+     * 计算字符串的指纹(64位)
+     * 说明：
+     *  - 与HashString使用不同的算法(Murmur64)，两者相互独立，用于不读取名字的情况下校验存储项
+     */
+    uint64_t FingerprintString(const std::string &s);
+
     /*
      * 设置/获取错误代码
+     * 说明：
+     *  - 错误代码是线程独立的(thread_local)，只能获取到当前线程中发生的错误
      */
     void SetLastError(int errcode);
     void SetLastError(int errcode, const char *where);
@@ -0,0 +1,314 @@
+//
+//  xpack
+//
+//  Created by Luwei.
+//  Copyright (c) 2016 Luwei. All rights reserved.
+//  Github: https://github.com/Luweimy
+//
+
+#include "xpack-batch.h"
+#include "xpack-context.h"
+#include "xpack-stream.h"
+#include "xpack-block.h"
+#include "xpack-hash.h"
+#include "xpack-base.h"
+#include "xpack-def.h"
+#include <string.h>
+#include <algorithm>
+
+#define XPACK_BATCH_WINDOW  (32 * 1024 * 1024)  /* stored bytes held by one window */
+#define XPACK_BATCH_RUNSIZE (4 * 1024 * 1024)   /* upper bound of one merged read */
+#define XPACK_BATCH_GAP     (4 * 1024)          /* read through gaps smaller than this */
+#define XPACK_BATCH_WORKERS 4
+
+using namespace xpack;
+
+BatchReader::BatchReader(Context *ctx, const torch::Data &skey, bool needcrc)
+:m_context(ctx)
+,m_needcrc(needcrc)
+,m_inflight(0)
+,m_stop(false)
+,m_status(true)
+{
+    assert(ctx);
+    m_skey.CopyFrom(skey);
+}
+
+BatchReader::~BatchReader()
+{
+    this->StopWorkers();
+}
+
+bool BatchReader::Read(const std::vector<std::string> &names, Callback callback)
+{
+    Context *ctx = m_context;
+    m_callback = callback;
+    m_status = true;
+
+    // Resolve all names first, items never move after this
+    std::vector<Item> items(names.size());
+    std::vector<Item*> order;
+    bool needdecode = m_needcrc;
+    for (size_t i = 0; i < names.size(); i++) {
+        Item &item = items[i];
+        item.name = names[i];
+        item.size = 0;
+        item.pending = 0;
+        item.status = true;
+        item.error = xpack::Error::NoErr;
+
+        MetaHash *metahash = ctx->hash->QueryByName(names[i]);
+        if (!metahash || metahash->block_index < 0) {
+            m_status = false;
+            XPACK_ERROR(xpack::Error::NotExists);
+            if (!m_callback(item.name, torch::Data::Null, false)) {
+                return false;
+            }
+            continue;
+        }
+        item.metahash = *metahash;
+        needdecode |= (metahash->flags & (int(HashFlags::Compressed) | int(HashFlags::CryptoRC4))) != 0;
+
+        MetaBlock *metablock = ctx->block->GetByIndex(metahash->block_index);
+        item.offset = metablock ? metablock->offset : UINT64_MAX;
+        while (metablock) {
+            item.size += metablock->size;
+            metablock = ctx->block->GetByIndex(metablock->next_index);
+        }
+        order.push_back(&item);
+    }
+
+    // Windows move forward through the stream
+    std::sort(order.begin(), order.end(), [](const Item *l, const Item *r) {
+        return l->offset < r->offset;
+    });
+
+    if (needdecode && order.size() > 1) {
+        size_t concurrency = std::max(1u, std::thread::hardware_concurrency());
+        this->StartWorkers(std::min(order.size(), std::min(concurrency, (size_t)XPACK_BATCH_WORKERS)));
+    }
+
+    bool keep = true;
+    std::vector<Item*> window;
+    for (size_t i = 0; i < order.size() && keep; ) {
+        uint64_t windowsize = 0;
+        window.clear();
+        while (i < order.size() && (window.empty() || windowsize + order[i]->size <= XPACK_BATCH_WINDOW)) {
+            windowsize += order[i]->size;
+            window.push_back(order[i++]);
+        }
+        keep = this->ReadWindow(window);
+    }
+
+    // Drain the decoding items
+    while (keep) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_inflight == 0 && m_done.empty()) {
+                break;
+            }
+        }
+        keep = this->Deliver(true);
+    }
+
+    this->StopWorkers();
+    return keep && m_status;
+}
+
+bool BatchReader::ReadWindow(std::vector<Item*> &window)
+{
+    Context *ctx = m_context;
+    std::vector<Extent> extents;
+
+    for (Item *item : window) {
+        item->data.Alloc(item->size);
+
+        MetaBlock *metablock = ctx->block->GetByIndex(item->metahash.block_index);
+        size_t position = 0;
+        while (metablock) {
+            if (metablock->size > 0) {
+                extents.push_back({ ctx->offset + metablock->offset, metablock->size, item, position });
+                item->pending++;
+            }
+            position += metablock->size;
+            metablock = ctx->block->GetByIndex(metablock->next_index);
+        }
+        if (item->pending == 0) {
+            this->Submit(item);
+        }
+    }
+
+    std::sort(extents.begin(), extents.end(), [](const Extent &l, const Extent &r) {
+        return l.offset < r.offset;
+    });
+
+    // Merge neighbouring extents into one sequential read
+    for (size_t i = 0; i < extents.size(); ) {
+        uint64_t begin = extents[i].offset;
+        uint64_t end   = begin + extents[i].size;
+        size_t j = i + 1;
+        while (j < extents.size() && extents[j].offset <= end + XPACK_BATCH_GAP) {
+            uint64_t nextend = std::max(end, extents[j].offset + extents[j].size);
+            if (nextend - begin > XPACK_BATCH_RUNSIZE) {
+                break;
+            }
+            end = nextend;
+            j++;
+        }
+
+        // A single extent (never capped by XPACK_BATCH_RUNSIZE) goes straight into the item
+        bool ok;
+        bool direct = j == i + 1;
+        if (direct) {
+            Extent &e = extents[i];
+            ok = ctx->stream->GetContent((char *)e.item->data.GetBytes() + e.position, (size_t)e.size, e.offset);
+        }
+        else {
+            m_runbuffer.ReSize(end - begin);
+            ok = ctx->stream->GetContent(m_runbuffer.GetBytes(), end - begin, begin);
+        }
+        for (size_t k = i; k < j; k++) {
+            Extent &e = extents[k];
+            if (ok && !direct) {
+                memcpy((char *)e.item->data.GetBytes() + e.position, (char *)m_runbuffer.GetBytes() + (e.offset - begin), e.size);
+            }
+            else if (!ok) {
+                e.item->status = false;
+                e.item->error = (xpack::Error)xpack::GetLastError();
+            }
+            if (--e.item->pending == 0) {
+                this->Submit(e.item);
+            }
+        }
+        i = j;
+
+        if (!this->Deliver(false)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BatchReader::Submit(Item *item)
+{
+    if (m_workers.empty()) {
+        this->Decode(item);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_done.push_back(item);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_todo.push_back(item);
+        m_inflight++;
+    }
+    m_cvtodo.notify_one();
+}
+
+bool BatchReader::Deliver(bool wait)
+{
+    std::deque<Item*> done;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (wait) {
+            m_cvdone.wait(lock, [this]() { return !m_done.empty() || m_inflight == 0; });
+        }
+        done.swap(m_done);
+    }
+
+    for (Item *item : done) {
+        bool keep = false;
+        if (item->status) {
+            keep = m_callback(item->name, item->data, true);
+        }
+        else {
+            m_status = false;
+            XPACK_ERROR(item->error);
+            keep = m_callback(item->name, torch::Data::Null, false);
+        }
+        item->data.Free();
+        if (!keep) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BatchReader::Decode(Item *item)
+{
+    if (!item->status) {
+        return;
+    }
+
+    // Same as Package::ProcessingAfterReading, runs on worker threads
+    MetaHash &metahash = item->metahash;
+    if (metahash.flags & int(HashFlags::CryptoRC4)) {
+        torch::crypto::RC4 rc4crypto;
+        rc4crypto.SetSecretKey((const unsigned char *)m_skey.GetBytes(), m_skey.GetSize());
+        rc4crypto.CryptoNoCopy(item->data);
+    }
+
+    if (metahash.flags & int(HashFlags::Compressed)) {
+        torch::Data decompressbuffer(metahash.unpacked_size);
+        if (!torch::compress::ZipUtil::Decompress(item->data, decompressbuffer)) {
+            item->status = false;
+            item->error = xpack::Error::Compress;
+            return;
+        }
+        item->data.CopyFrom(decompressbuffer);
+    }
+
+    if (m_needcrc && metahash.crc != torch::crypto::Crc32::Compute(item->data)) {
+        item->status = false;
+        item->error = xpack::Error::CRC;
+    }
+}
+
+void BatchReader::StartWorkers(size_t count)
+{
+    m_stop = false;
+    for (size_t i = 0; i < count; i++) {
+        m_workers.push_back(std::thread(&BatchReader::WorkerLoop, this));
+    }
+}
+
+void BatchReader::StopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cvtodo.notify_all();
+    for (auto &worker : m_workers) {
+        worker.join();
+    }
+    m_workers.clear();
+    m_todo.clear();
+    m_done.clear();
+    m_inflight = 0;
+}
+
+void BatchReader::WorkerLoop()
+{
+    while (true) {
+        Item *item = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cvtodo.wait(lock, [this]() { return m_stop || !m_todo.empty(); });
+            if (m_stop) {
+                return;
+            }
+            item = m_todo.front();
+            m_todo.pop_front();
+        }
+
+        this->Decode(item);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_done.push_back(item);
+            m_inflight--;
+        }
+        m_cvdone.notify_one();
+    }
+}
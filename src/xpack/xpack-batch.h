@@ -0,0 +1,99 @@
+//
+//  xpack
+//
+//  Created by Luwei.
+//  Copyright (c) 2016 Luwei. All rights reserved.
+//  Github: https://github.com/Luweimy
+//
+
+#ifndef __XPACK__BATCH__
+#define __XPACK__BATCH__
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "torch/torch.h"
+#include "xpack-def.h"
+
+namespace xpack {
+
+    class Context;
+
+    /*
+     * 批量读取器(Package::GetEntries的内部实现)
+     * 说明：
+     *  - 先解析所有项名，再将所有block按照在文件中的偏移排序，相邻的block合并为一次顺序读取
+     *  - 合并的读取不超过XPACK_BATCH_RUNSIZE；无法合并的单个block直接读入存储项，不经过中间缓冲区
+     *  - 按窗口(XPACK_BATCH_WINDOW)分批读取，限制同时占用的内存
+     *  - 存储项的内容读取完整后交给后台线程解密/解压/CRC校验，与后续的读取重叠
+     *  - callback只在调用Read()的线程中执行
+     */
+    class BatchReader {
+    public:
+        typedef std::function<bool(const std::string &name, const torch::Data &data, bool status)> Callback;
+
+        BatchReader(Context *ctx, const torch::Data &skey, bool needcrc);
+        ~BatchReader();
+        BatchReader(const BatchReader &) = delete;
+        BatchReader& operator=(const BatchReader &) = delete;
+
+        /*
+         * 读取给定的存储项
+         * 返回值：
+         *  - 全部读取成功返回true，有存储项读取失败或被callback中断返回false
+         */
+        bool Read(const std::vector<std::string> &names, Callback callback);
+
+    private:
+        struct Item {
+            std::string  name;
+            MetaHash     metahash;
+            uint64_t     offset;    /* offset of the first block */
+            uint64_t     size;      /* stored size */
+            torch::Data  data;      /* stored data, decoded in place */
+            size_t       pending;   /* extents not read yet */
+            bool         status;
+            xpack::Error error;
+        };
+        struct Extent {
+            uint64_t     offset;    /* position in stream */
+            uint64_t     size;
+            Item        *item;
+            size_t       position;  /* position in item's stored data */
+        };
+
+        bool ReadWindow(std::vector<Item*> &window);
+        void Submit(Item *item);
+        bool Deliver(bool wait);
+        void Decode(Item *item);
+
+        void StartWorkers(size_t count);
+        void StopWorkers();
+        void WorkerLoop();
+
+    private:
+        Context                 *m_context;
+        torch::Data              m_skey;
+        bool                     m_needcrc;
+        Callback                 m_callback;
+        torch::Data              m_runbuffer;  // Merged reads of several extents, at most XPACK_BATCH_RUNSIZE
+
+        std::vector<std::thread> m_workers;
+        std::mutex               m_mutex;
+        std::condition_variable  m_cvtodo;
+        std::condition_variable  m_cvdone;
+        std::deque<Item*>        m_todo;
+        std::deque<Item*>        m_done;
+        size_t                   m_inflight; /* submitted to workers, not decoded yet */
+        bool                     m_stop;
+        bool                     m_status;
+    };
+
+}
+
+#endif /* __XPACK__BATCH__ */
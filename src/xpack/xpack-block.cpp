@@ -15,11 +15,99 @@
 #include "xpack-base.h"
 #include "xpack-def.h"
 #include <vector>
+#include <algorithm>
+
+#define XPACK_COMPACT_CHUNK (1024 * 1024)   /* bytes copied at a time when moving content */
 
 using namespace xpack;
 
+// 0x0009 format keeps 32-bit blocks on disk
+static void WidenBlocks(MetaBlock *dst, const MetaBlock32 *src, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        dst[i].offset     = src[i].offset;
+        dst[i].size       = src[i].size;
+        dst[i].next_index = src[i].next_index;
+        dst[i].flags      = src[i].flags;
+    }
+}
+
+static bool NarrowBlocks(MetaBlock32 *dst, const MetaBlock *src, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (src[i].offset > UINT32_MAX || src[i].size > UINT32_MAX) {
+            return false;
+        }
+        dst[i].offset     = (uint32_t)src[i].offset;
+        dst[i].size       = (uint32_t)src[i].size;
+        dst[i].next_index = src[i].next_index;
+        dst[i].flags      = src[i].flags;
+    }
+    return true;
+}
+
+void ContentReuser::UpdateEntry(int32_t index, MetaBlock *metablock)
+{
+    assert(index >= 0 && metablock);
+    this->RemoveEntry(index);
+    if ((size_t)index >= m_keys.size()) {
+        m_keys.resize(index + 1, Keys{ 0, 0, false });
+    }
+    m_keys[index] = { metablock->offset, metablock->size, true };
+    m_totalsize += metablock->size;
+    m_orderdByOffset.insert({ metablock->offset, index });
+    m_orderdBySize.insert({ metablock->size, index });
+}
+
+void ContentReuser::RemoveEntry(int32_t index)
+{
+    if (!this->Contains(index)) {
+        return;
+    }
+    Keys &keys = m_keys[index];
+    m_orderdByOffset.erase({ keys.offset, index });
+    m_orderdBySize.erase({ keys.size, index });
+    m_totalsize -= keys.size;
+    keys.used = false;
+}
+
+int32_t ContentReuser::GetEntryStartingAt(uint64_t offset)
+{
+    auto it = m_orderdByOffset.lower_bound({ offset, INT32_MIN });
+    if (it == m_orderdByOffset.end() || it->key != offset) {
+        return -1;
+    }
+    return it->index;
+}
+
+int32_t ContentReuser::GetBestFitEntry(uint64_t size)
+{
+    auto it = m_orderdBySize.lower_bound({ size, INT32_MIN });
+    return it == m_orderdBySize.end() ? -1 : it->index;
+}
+
+int32_t ContentReuser::GetNextOffsetEntry(uint64_t offset)
+{
+    auto it = m_orderdByOffset.lower_bound({ offset, INT32_MIN });
+    return it == m_orderdByOffset.end() ? -1 : it->index;
+}
+
+int32_t ContentReuser::GetEntryEndingAt(uint64_t offset)
+{
+    auto it = m_orderdByOffset.lower_bound({ offset, INT32_MIN });
+    if (it == m_orderdByOffset.begin()) {
+        return -1;
+    }
+    --it;
+    const Keys &keys = m_keys[it->index];
+    return keys.offset + keys.size == offset ? it->index : -1;
+}
+
 BlockSegment::BlockSegment(Context *ctx)
 :m_context(ctx)
+,m_allocpolicy(AllocPolicy::SmallestFirst)
+,m_allocmaxchain(0)
+,m_compactIndexed(false)
 {
     assert(ctx);
     torch::HeapCounterRetain();
@@ -40,17 +128,28 @@ bool BlockSegment::ReadFromStream()
     }
     
     Context *ctx = m_context;
+    m_compactIndexed = false;
     
-    uint32_t blockoffset = ctx->offset + ctx->header->Metadata()->block_offset;
+    uint64_t blockoffset = ctx->offset + ctx->header->Metadata()->block_offset;
     uint32_t blockcount  = ctx->header->Metadata()->block_count;
     
     m_blocks.Alloc(blockcount * sizeof(MetaBlock));
-    if (!ctx->stream->GetBlocks(m_blocks.GetBytes(), blockoffset, blockcount)) {
-        return false;
+    if (ctx->IsVersion32()) {
+        torch::Data rb(blockcount * sizeof(MetaBlock32));
+        if (!ctx->stream->GetBlocks32(rb.GetBytes(), blockoffset, blockcount)) {
+            return false;
+        }
+        ctx->crypto->CryptoNoCopy((unsigned char*)rb.GetBytes(), (int)rb.GetSize());
+        WidenBlocks((MetaBlock *)m_blocks.GetBytes(), (MetaBlock32 *)rb.GetBytes(), blockcount);
+    }
+    else {
+        if (!ctx->stream->GetBlocks(m_blocks.GetBytes(), blockoffset, blockcount)) {
+            return false;
+        }
+        
+        // Decrypt blocks data
+        ctx->crypto->CryptoNoCopy((unsigned char*)m_blocks.GetBytes(), (int)m_blocks.GetSize());
     }
-    
-    // Decrypt blocks data
-    ctx->crypto->CryptoNoCopy((unsigned char*)m_blocks.GetBytes(), (int)m_blocks.GetSize());
     
     // Build reusing pool
     uint32_t count = this->GetBlockNumber();
@@ -72,13 +171,25 @@ bool BlockSegment::WriteToStream()
     Context *ctx = m_context;
     ctx->header->UpdateMetadata();
     
+    uint64_t blockoffset = ctx->offset + ctx->header->Metadata()->block_offset;
+    uint32_t blockcount  = this->GetBlockNumber();
+    
+    if (ctx->IsVersion32()) {
+        torch::Data wb(blockcount * sizeof(MetaBlock32));
+        if (!NarrowBlocks((MetaBlock32 *)wb.GetBytes(), (MetaBlock *)m_blocks.GetBytes(), blockcount)) {
+            XPACK_ERROR(xpack::Error::Format); // Too large for 0x0009 format
+            return false;
+        }
+        ctx->crypto->CryptoNoCopy((unsigned char*)wb.GetBytes(), (int)wb.GetSize());
+        return ctx->stream->PutBlocks32(wb.GetBytes(), blockoffset, blockcount);
+    }
+    
     torch::Data wb = m_blocks;
     
     // Encrypt blocks data
     ctx->crypto->CryptoNoCopy((unsigned char*)wb.GetBytes(), (int)wb.GetSize());
     
-    uint32_t blockoffset = ctx->offset + ctx->header->Metadata()->block_offset;
-    if (!ctx->stream->PutBlocks(wb.GetBytes(), blockoffset, this->GetBlockNumber())) {
+    if (!ctx->stream->PutBlocks(wb.GetBytes(), blockoffset, blockcount)) {
         return false;
     }
     return true;
@@ -93,7 +204,7 @@ bool BlockSegment::IsValid()
         return false;
     }
     
-    size_t headerend = sizeof(MetaSignature) + sizeof(MetaHeader);
+    size_t headerend = sizeof(MetaSignature) + ctx->GetHeaderSize();
     if (metaheader->block_offset < headerend) {
         return false;
     }
@@ -108,6 +219,7 @@ void BlockSegment::RemoveByIndex(int32_t index)
     
     // Must be head of block chain
     assert(metablock && !(metablock->flags & int(BlockFlags::NotStart)));
+    m_compactIndexed = false;
     
     // Reusing the content
     while (metablock) {
@@ -122,7 +234,7 @@ void BlockSegment::RemoveByIndex(int32_t index)
         metablock->flags |= int(BlockFlags::UnusedContent);
         
         if (metablock->size > 0) {
-            m_contentReuser.UpdateEntry(curindex, metablock);
+            this->InternalAddingContentToReuserByIndex(curindex);
         }
         else {
             this->InternalAddingBlockToReuserByIndex(curindex);
@@ -131,29 +243,7 @@ void BlockSegment::RemoveByIndex(int32_t index)
         metablock = this->GetByIndex(nextindex);
     }
     
-    // Remove the unused tail in content section
-    while (m_contentReuser.Size() > 0) {
-        int32_t index = m_contentReuser.GetMaximumOffsetEntry();
-        MetaBlock *metablock = this->GetByIndex(index);
-        assert(metablock->offset + metablock->size <= metaheader->content_offset + metaheader->content_size);
-        if (metablock->offset + metablock->size < metaheader->content_offset + metaheader->content_size) {
-            break;
-        }
-        metaheader->content_size -= metablock->size;
-        this->InternalAddingBlockToReuserByIndex(index);
-    }
-    
-    // Remove the unused tail in block section
-    while (m_blockReuser.Size() > 0) {
-        int32_t index = m_blockReuser.GetMaximumIndexEntry();
-        if (this->GetBlockNumber() != index + 1) {
-            break;
-        }
-        m_blocks.ReSize(m_blocks.GetSize() - sizeof(MetaBlock));
-        m_context->header->Metadata()->block_count = this->GetBlockNumber();
-        m_blockReuser.RemoveEntry(index);
-    }
-    
+    this->InternalTrimTail();
     m_context->header->UpdateMetadata();
 }
 
@@ -165,58 +255,44 @@ MetaBlock* BlockSegment::GetByIndex(int32_t index)
     return ((MetaBlock *)m_blocks.GetBytes()) + index;
 }
 
-int32_t BlockSegment::AllocLinkedBlock(uint32_t size)
+int32_t BlockSegment::AllocLinkedBlock(uint64_t size)
 {
     int32_t     headindex  = -1;
-    uint32_t    totalsize  = 0;
-    MetaBlock  *prevblock  = nullptr;
+    int32_t     previndex  = -1;
+    uint64_t    totalsize  = 0;
+    uint32_t    chainsize  = 0;
     MetaHeader *metaheader = m_context->header->Metadata();
+    m_compactIndexed = false;
     
-    // Find block in content reuser, smaller block size first
+    // Find block in content reuser, in the order of the allocation policy
     while (m_contentReuser.Size() > 0) {
-        int32_t curbindex = m_contentReuser.GetMinimumSizeEntry();
-        
-        MetaBlock *metablock = this->GetByIndex(curbindex);
-        assert(metablock->offset + metablock->size <= metaheader->content_offset + metaheader->content_size);
-        metablock->flags = 0;
-        
-        // Current metablock is too big to reusing
-        if (totalsize + metablock->size > size) {
-            uint32_t needsize = size - totalsize;
-            assert(metablock->size > needsize);
-            
-            // Separate out extra space and recorded in new block
-            int32_t    extraindex = this->InternalGetOrCreate();
-            MetaBlock *extrablock = this->GetByIndex(extraindex);
-            extrablock->offset = metablock->offset + needsize;
-            extrablock->size   = metablock->size - needsize;
-            extrablock->flags |= int(BlockFlags::UnusedContent);
-            m_contentReuser.UpdateEntry(extraindex, extrablock);
-            
-            metablock->size = needsize;
+        int32_t curbindex = this->InternalNextReusingEntry(size - totalsize, chainsize);
+        if (curbindex < 0) {
+            break;
         }
+        MetaBlock *metablock = this->InternalTakeContent(curbindex, size - totalsize);
         
         // Make blocks linked by field `next_index`
         if (headindex < 0) {
             headindex = curbindex;
         }
         else {
-            prevblock->next_index = curbindex;
+            this->GetByIndex(previndex)->next_index = curbindex;
             metablock->flags |= int(BlockFlags::NotStart);
         }
 
-        m_contentReuser.RemoveEntry(curbindex);
         totalsize += metablock->size;
+        chainsize++;
         
         assert(totalsize <= size);
         if (totalsize == size) {
             return headindex;
         }
         
-        prevblock = metablock;
+        previndex = curbindex;
     }
     
-    uint32_t    needsize   = size - totalsize;
+    uint64_t    needsize   = size - totalsize;
     int32_t     finalindex = this->InternalGetOrCreate();
     MetaBlock  *finalblock = this->GetByIndex(finalindex);
     
@@ -224,8 +300,8 @@ int32_t BlockSegment::AllocLinkedBlock(uint32_t size)
     finalblock->size   = needsize;
     metaheader->content_size += needsize;
     
-    if (prevblock) {
-        prevblock->next_index = finalindex;
+    if (previndex >= 0) {
+        this->GetByIndex(previndex)->next_index = finalindex;
         finalblock->flags |= int(BlockFlags::NotStart);
     }
     else {
@@ -236,11 +312,121 @@ int32_t BlockSegment::AllocLinkedBlock(uint32_t size)
     return headindex;
 }
 
+void BlockSegment::SetAllocPolicy(AllocPolicy policy, uint32_t maxchain)
+{
+    m_allocpolicy   = policy;
+    m_allocmaxchain = maxchain;
+}
+
+bool BlockSegment::Compact(uint64_t budget)
+{
+    MetaHeader *metaheader = m_context->header->Metadata();
+    
+    // Blocks holding content by offset, rebuilt only after others changed the blocks
+    if (!m_compactIndexed) {
+        m_compactIndex.clear();
+        uint32_t count = this->GetBlockNumber();
+        for (uint32_t i = 0; i < count; i++) {
+            MetaBlock *metablock = this->GetByIndex(i);
+            if (!(metablock->flags & (int(BlockFlags::UnusedBlock) | int(BlockFlags::UnusedContent))) && metablock->size > 0) {
+                m_compactIndex.insert({ metablock->offset, (int32_t)i });
+            }
+        }
+        m_compactIndexed = true;
+    }
+    
+    uint64_t moved  = 0;
+    bool     status = true;
+    while (budget == 0 || moved < budget) {
+        // Everything after the last block is unused, drop it from the content tail
+        uint64_t tailend = metaheader->content_offset;
+        if (!m_compactIndex.empty()) {
+            MetaBlock *lastblock = this->GetByIndex(m_compactIndex.rbegin()->index);
+            tailend = lastblock->offset + lastblock->size;
+        }
+        for (int32_t index = m_contentReuser.GetNextOffsetEntry(tailend); index >= 0; index = m_contentReuser.GetNextOffsetEntry(tailend)) {
+            this->InternalAddingBlockToReuserByIndex(index);
+        }
+        assert(tailend <= metaheader->content_offset + metaheader->content_size);
+        metaheader->content_size = tailend - metaheader->content_offset;
+        if (m_contentReuser.Size() == 0) {
+            break;
+        }
+        
+        // The first free extent, or the smallest one holding the whole block
+        int32_t    lastindex = m_compactIndex.rbegin()->index;
+        MetaBlock *lastblock = this->GetByIndex(lastindex);
+        int32_t    freeindex = m_contentReuser.GetMinimumOffsetEntry();
+        if (this->GetByIndex(freeindex)->size < lastblock->size) {
+            int32_t fitindex = m_contentReuser.GetBestFitEntry(lastblock->size);
+            freeindex = fitindex >= 0 ? fitindex : freeindex;
+        }
+        MetaBlock *freeblock = this->GetByIndex(freeindex);
+        assert(freeblock->offset + freeblock->size <= lastblock->offset);
+        
+        // Copy the block, or the part of its tail filling the free extent, the source stays intact
+        uint64_t size = std::min(lastblock->size, freeblock->size);
+        if (!this->InternalMoveContent(lastblock->offset + lastblock->size - size, freeblock->offset, size)) {
+            status = false;
+            break;
+        }
+        
+        if (size == lastblock->size) {
+            m_compactIndex.erase({ lastblock->offset, lastindex });
+            lastblock->offset = freeblock->offset;
+            m_compactIndex.insert({ lastblock->offset, lastindex });
+            freeblock->offset += size;
+            freeblock->size   -= size;
+            if (freeblock->size > 0) {
+                m_contentReuser.UpdateEntry(freeindex, freeblock);
+            }
+            else {
+                this->InternalAddingBlockToReuserByIndex(freeindex);
+            }
+        }
+        else {
+            // The free extent turns into the next node of the block chain
+            m_contentReuser.RemoveEntry(freeindex);
+            freeblock->flags      = int(BlockFlags::NotStart);
+            freeblock->next_index = lastblock->next_index;
+            lastblock->next_index = freeindex;
+            lastblock->size      -= size;
+            m_compactIndex.insert({ freeblock->offset, freeindex });
+        }
+        moved += size;
+    }
+    
+    this->InternalTrimTail();
+    m_context->header->UpdateMetadata();
+    return status;
+}
+
+bool BlockSegment::InternalMoveContent(uint64_t from, uint64_t to, uint64_t size)
+{
+    assert(to + size <= from);
+    Stream *stream = m_context->stream;
+    uint64_t base  = m_context->offset;
+    torch::Data buffer(std::min(size, (uint64_t)XPACK_COMPACT_CHUNK));
+    
+    for (uint64_t done = 0; done < size; ) {
+        size_t chunk = (size_t)std::min(size - done, (uint64_t)buffer.GetSize());
+        if (!stream->GetContent(buffer.GetBytes(), chunk, base + from + done)) {
+            return false;
+        }
+        if (!stream->PutContent(buffer.GetBytes(), chunk, base + to + done)) {
+            return false;
+        }
+        done += chunk;
+    }
+    return true;
+}
+
 void BlockSegment::Clear()
 {
     // Clear reuse pool
     m_blockReuser.Clear();
     m_contentReuser.Clear();
+    m_compactIndexed = false;
     
     // Clear blocks memory
     m_blocks.Free();
@@ -272,6 +458,33 @@ BlockReuser* BlockSegment::GetBlockReuser()
     return &m_blockReuser;
 }
 
+int32_t BlockSegment::ConcatLinkedBlock(int32_t tailindex, int32_t headindex)
+{
+    MetaBlock *tailblock = this->GetByIndex(tailindex);
+    MetaBlock *headblock = this->GetByIndex(headindex);
+    assert(tailblock && tailblock->next_index < 0);
+    assert(headblock && !(headblock->flags & int(BlockFlags::NotStart)));
+    m_compactIndexed = false;
+    
+    if (tailblock->offset + tailblock->size == headblock->offset) {
+        // Adjacent in content section, merge into the tail block
+        tailblock->size += headblock->size;
+        tailblock->next_index = headblock->next_index;
+        this->InternalAddingBlockToReuserByIndex(headindex);
+    }
+    else {
+        tailblock->next_index = headindex;
+        headblock->flags |= int(BlockFlags::NotStart);
+    }
+    
+    int32_t lastindex = tailindex;
+    for (MetaBlock *metablock = tailblock; metablock->next_index >= 0; ) {
+        lastindex = metablock->next_index;
+        metablock = this->GetByIndex(lastindex);
+    }
+    return lastindex;
+}
+
 void BlockSegment::InternalAddingBlockToReuserByIndex(int32_t index)
 {
     MetaBlock *metablock = this->GetByIndex(index);
@@ -284,6 +497,101 @@ void BlockSegment::InternalAddingBlockToReuserByIndex(int32_t index)
     m_contentReuser.RemoveEntry(index);
 }
 
+void BlockSegment::InternalTrimTail()
+{
+    MetaHeader *metaheader = m_context->header->Metadata();
+    
+    // Remove the unused tail in content section
+    while (m_contentReuser.Size() > 0) {
+        int32_t index = m_contentReuser.GetMaximumOffsetEntry();
+        MetaBlock *metablock = this->GetByIndex(index);
+        assert(metablock->offset + metablock->size <= metaheader->content_offset + metaheader->content_size);
+        if (metablock->offset + metablock->size < metaheader->content_offset + metaheader->content_size) {
+            break;
+        }
+        metaheader->content_size -= metablock->size;
+        this->InternalAddingBlockToReuserByIndex(index);
+    }
+    
+    // Remove the unused tail in block section
+    while (m_blockReuser.Size() > 0) {
+        int32_t index = m_blockReuser.GetMaximumIndexEntry();
+        if (this->GetBlockNumber() != (uint32_t)index + 1) {
+            break;
+        }
+        m_blocks.ReSize(m_blocks.GetSize() - sizeof(MetaBlock));
+        m_context->header->Metadata()->block_count = this->GetBlockNumber();
+        m_blockReuser.RemoveEntry(index);
+    }
+}
+
+void BlockSegment::InternalAddingContentToReuserByIndex(int32_t index)
+{
+    MetaBlock *metablock = this->GetByIndex(index);
+    assert(metablock && metablock->size > 0);
+    
+    // Take in the free extent right after it
+    int32_t nextindex = m_contentReuser.GetEntryStartingAt(metablock->offset + metablock->size);
+    if (nextindex >= 0) {
+        metablock->size += this->GetByIndex(nextindex)->size;
+        this->InternalAddingBlockToReuserByIndex(nextindex);
+    }
+    
+    // Grow the free extent right before it
+    int32_t previndex = m_contentReuser.GetEntryEndingAt(metablock->offset);
+    if (previndex >= 0) {
+        MetaBlock *prevblock = this->GetByIndex(previndex);
+        prevblock->size += metablock->size;
+        this->InternalAddingBlockToReuserByIndex(index);
+        m_contentReuser.UpdateEntry(previndex, prevblock);
+        return;
+    }
+    m_contentReuser.UpdateEntry(index, metablock);
+}
+
+int32_t BlockSegment::InternalNextReusingEntry(uint64_t needsize, uint32_t chainsize)
+{
+    // Smaller block size first, avoids fragments at the cost of long chains
+    if (m_allocpolicy == AllocPolicy::SmallestFirst) {
+        return m_contentReuser.GetMinimumSizeEntry();
+    }
+    if (needsize == 0) {
+        return -1;
+    }
+    int32_t index = m_contentReuser.GetBestFitEntry(needsize);
+    if (index >= 0 || m_allocpolicy == AllocPolicy::BestFit) {
+        return index;
+    }
+    // Keep the last node of the chain for the content tail
+    if (chainsize + 1 >= std::max(m_allocmaxchain, 1u)) {
+        return -1;
+    }
+    return m_contentReuser.GetMaximumSizeEntry();
+}
+
+MetaBlock* BlockSegment::InternalTakeContent(int32_t index, uint64_t needsize)
+{
+    MetaBlock *metablock = this->GetByIndex(index);
+    assert(metablock->offset + metablock->size <= m_context->header->Metadata()->content_offset + m_context->header->Metadata()->content_size);
+    m_contentReuser.RemoveEntry(index);
+    metablock->flags = 0;
+    
+    // Current metablock is too big to reusing
+    if (metablock->size > needsize) {
+        // Separate out extra space and recorded in new block
+        int32_t    extraindex = this->InternalGetOrCreate();
+        MetaBlock *extrablock = this->GetByIndex(extraindex);
+        metablock = this->GetByIndex(index); // Blocks memory may have moved
+        extrablock->offset = metablock->offset + needsize;
+        extrablock->size   = metablock->size - needsize;
+        extrablock->flags |= int(BlockFlags::UnusedContent);
+        m_contentReuser.UpdateEntry(extraindex, extrablock);
+        
+        metablock->size = needsize;
+    }
+    return metablock;
+}
+
 int32_t BlockSegment::InternalGetOrCreate()
 {
     uint32_t   count     = this->GetBlockNumber();
@@ -12,6 +12,7 @@
 #include <stdio.h>
 #include <vector>
 #include <unordered_set>
+#include <set>
 #include "xpack-def.h"
 #include "torch/torch.h"
 
@@ -22,42 +23,95 @@ namespace xpack {
      * 负责记录block-content可重用的blockindex并且分别按照block的size和block的offset分别排序
      * size排序用于重用决策时，选择合适尺寸的block-content
      * offset排序用于删除块时，将位于文件末尾的无效数据块全部清除
+     * 说明：
+     *  - 排序键为精确的64位offset/size(相同时按blockindex)，超过4GB的包也不会出现并列或错序
+     *  - 按blockindex记录每项的排序键，更新和删除为O(log n)
      */
     class ContentReuser {
     public:
-        void UpdateEntry(int32_t index, MetaBlock *metablock) {
-            m_orderdByOffset.Update(index, metablock->offset); m_orderdBySize.Update(index, metablock->size);
+        ContentReuser() :m_totalsize(0) {}
+        
+        struct Entry {
+            uint64_t key;    /* offset or size */
+            int32_t  index;  /* blockindex */
+            bool operator<(const Entry &o) const { return key < o.key || (key == o.key && index < o.index); }
+        };
+        typedef std::set<Entry> Set;
+        
+        /*
+         * 添加或更新可重用的block-content(以metablock当前的offset和size为准)
+         */
+        void UpdateEntry(int32_t index, MetaBlock *metablock);
+        
+        /*
+         * 删除可重用的block-content，不存在时不发生任何改变
+         */
+        void RemoveEntry(int32_t index);
+        
+        void Clear() {
+            m_orderdByOffset.clear(); m_orderdBySize.clear(); m_keys.clear(); m_totalsize = 0;
         }
-        void RemoveEntry(int32_t index) {
-            m_orderdByOffset.Remove(index); m_orderdBySize.Remove(index);
+        /*
+         * 获得从offset开始/到offset结束的项，用于合并相邻的可重用区域，若不存在则返回-1
+         */
+        int32_t GetEntryStartingAt(uint64_t offset);
+        int32_t GetEntryEndingAt(uint64_t offset);
+        
+        /*
+         * 获得offset不小于给定值的第一项，若不存在则返回-1
+         */
+        int32_t GetNextOffsetEntry(uint64_t offset);
+        
+        /*
+         * 获得所有可重用区域的尺寸之和(单位Byte)
+         */
+        uint64_t GetTotalSize() {
+            return m_totalsize;
         }
-        void Clear() {
-            m_orderdByOffset.Clear(); m_orderdBySize.Clear();
+        /*
+         * 获得size最小/offset最大的项，若为空则返回-1
+         */
+        int32_t GetMinimumOffsetEntry() {
+            return m_orderdByOffset.empty() ? -1 : m_orderdByOffset.begin()->index;
         }
         int32_t GetMinimumSizeEntry() {
-            return m_orderdBySize.GetMinScoreValue();
+            return m_orderdBySize.empty() ? -1 : m_orderdBySize.begin()->index;
+        }
+        int32_t GetMaximumSizeEntry() {
+            return m_orderdBySize.empty() ? -1 : m_orderdBySize.rbegin()->index;
         }
         int32_t GetMaximumOffsetEntry() {
-            return m_orderdByOffset.GetMaxScoreValue();
+            return m_orderdByOffset.empty() ? -1 : m_orderdByOffset.rbegin()->index;
         }
+        /*
+         * 获得size不小于给定值的最小项(best-fit)，若不存在则返回-1
+         */
+        int32_t GetBestFitEntry(uint64_t size);
         size_t Size() {
-            assert(m_orderdBySize.Size() == m_orderdByOffset.Size());
-            return m_orderdByOffset.Size();
+            assert(m_orderdBySize.size() == m_orderdByOffset.size());
+            return m_orderdByOffset.size();
         }
         bool Contains(int32_t index) {
-            return m_orderdBySize.Contains(index);
+            return index >= 0 && (size_t)index < m_keys.size() && m_keys[index].used;
         }
         // iterator
-        torch::collection::OrderedIterator<torch::collection::SortedSet<int32_t>::Set> GetOrderdByOffsetAscendingIterator() {
-            return m_orderdBySize.GetIterator();
+        torch::collection::OrderedIterator<Set> GetOrderdByOffsetAscendingIterator() {
+            return torch::collection::OrderedIterator<Set>(&m_orderdByOffset);
         }
-        torch::collection::OrderedIterator<torch::collection::SortedSet<int32_t>::Set> GetOrderdBySizeAscendingIterator() {
-            return m_orderdBySize.GetIterator();
+        torch::collection::OrderedIterator<Set> GetOrderdBySizeAscendingIterator() {
+            return torch::collection::OrderedIterator<Set>(&m_orderdBySize);
         }
         
     private:
-        torch::collection::SortedSet<int32_t> m_orderdByOffset;
-        torch::collection::SortedSet<int32_t> m_orderdBySize;
+        struct Keys {
+            uint64_t offset;
+            uint64_t size;
+            bool     used;
+        };
+        Set               m_orderdByOffset;
+        Set               m_orderdBySize;
+        std::vector<Keys> m_keys; // Keys in the sets, by blockindex
+        uint64_t          m_totalsize;
     };
     
     class BlockReuser {
@@ -124,6 +178,7 @@ namespace xpack {
          * 删除指定index的Block及其代表的内容
          * 说明：
          *  - 删除内容的节点必须为Block链的起始节点，然后会将整条链都放入Content重用池，以记录内容区域的重用
+         *  - 优化：与Content重用池中首尾相邻的区域合并为一个，被合并的Block记录放入Block重用池
          *  - 优化：将无用的Content区域末尾内容删除，会减小MetaHeader.content_size
          *  - 优化：将记录Content区域过小的Block记录抛弃
          *  - 优化：将无用的Block区域末尾项删除，会减小MetaHeader.block_count
@@ -144,10 +199,46 @@ namespace xpack {
          * 返回：链表头的block_index
          * 说明：
          *  - 其获得的Block可能是一个Block链，Block链上的所有Block代表的区域大小之和等于给定的大小
-         *  - 优先利用Content重用池中的小尺寸块
+         *  - 按分配策略(SetAllocPolicy)利用Content重用池中的块
          *  - 当没有可重用时，才会去创建新Block，此时会影响MetaHeader中的content_size,block_offset,hash_offset
          */
-        int32_t AllocLinkedBlock(uint32_t size);
+        int32_t AllocLinkedBlock(uint64_t size);
+        
+        /*
+         * 设置AllocLinkedBlock的分配策略，默认AllocPolicy::SmallestFirst
+         * 参数：
+         *  - AllocPolicy::SmallestFirst: 优先利用小尺寸块，直到正好够用，磁盘占用最小但Block链可能很长
+         *  - AllocPolicy::BestFit: 使用能容纳的最小的单个块，没有则追加到Content区段末尾，Block链只有一个节点
+         *  - AllocPolicy::BoundedChain: 先尝试BestFit，否则从大到小利用块，Block链最多maxchain个节点(剩余部分追加到末尾)
+         */
+        void SetAllocPolicy(AllocPolicy policy, uint32_t maxchain = 0);
+        
+        /*
+         * 将Block链连接到另一条Block链的末尾
+         * 参数：
+         *  - tailindex: 前一条Block链的末尾节点
+         *  - headindex: 要连接的Block链的起始节点(通常由AllocLinkedBlock申请)
+         * 返回：连接后整条链的末尾节点
+         * 说明：
+         *  - 若两者在Content区域中首尾相邻，则直接合并为一个Block，被合并的Block记录放入重用池
+         */
+        int32_t ConcatLinkedBlock(int32_t tailindex, int32_t headindex);
+        
+        /*
+         * 原地整理Content区段：将末尾的Block内容逐步移入前面的可重用区域，并删除末尾的无效数据
+         * 参数：
+         *  - budget: 本次最多移动的内容字节数(至少移动一个块)，0表示不限制
+         * 返回值：
+         *  - 读写失败时返回false，已完成的移动依然有效
+         * 说明：
+         *  - 每次取offset最大的Block，原样(不解密/解压)复制到offset最小的可重用区域，放不下时优先用能容纳它的区域
+         *  - 都放不下时只移动Block的末尾部分并占满该区域，该区域的记录作为Block链的下一个节点
+         *  - 移走后Content区段末尾的数据被删除，会减小MetaHeader.content_size
+         *  - 只写入可重用区域，且本次移走的原位置不会再被写入，所以写入包信息之前磁盘上记录的Block均完好
+         *  - 调用前需要写入包信息，保证内存中的可重用区域在磁盘上也未被引用
+         *  - 按offset排序的Block索引在两次调用之间保留，Block被其他操作修改后才重建
+         */
+        bool Compact(uint64_t budget);
         
         /*
          * 清空所有内容
@@ -181,6 +272,11 @@ namespace xpack {
 
     private: 
         void InternalAddingBlockToReuserByIndex(int32_t index);
+        void InternalAddingContentToReuserByIndex(int32_t index);
+        void InternalTrimTail();
+        bool InternalMoveContent(uint64_t from, uint64_t to, uint64_t size);
+        int32_t InternalNextReusingEntry(uint64_t needsize, uint32_t chainsize);
+        MetaBlock* InternalTakeContent(int32_t index, uint64_t needsize);
         int32_t InternalGetOrCreate();
 
     private:
@@ -189,6 +285,12 @@ namespace xpack {
         
         ContentReuser m_contentReuser; // Content unused
         BlockReuser   m_blockReuser;   // Metablock unused
+        
+        AllocPolicy   m_allocpolicy;
+        uint32_t      m_allocmaxchain;
+        
+        ContentReuser::Set m_compactIndex;   // Blocks holding content by offset, for Compact
+        bool               m_compactIndexed; // m_compactIndex is up to date
     };
 }
 
@@ -14,6 +14,9 @@
 #include "xpack-block.h"
 #include "xpack-base.h"
 #include "xpack-def.h"
+#include <algorithm>
+
+#define XPACK_CONTENT_COPYSIZE (256 * 1024)
 
 using namespace xpack;
 
@@ -39,7 +42,7 @@ bool ContentSegment::IsValid()
         return false;
     }
     
-    size_t headerend = sizeof(MetaSignature) + sizeof(MetaHeader);
+    size_t headerend = sizeof(MetaSignature) + ctx->GetHeaderSize();
     if (metaheader->content_offset < headerend) {
         return false;
     }
@@ -48,10 +51,15 @@ bool ContentSegment::IsValid()
 }
 
 bool ContentSegment::OverallWrite(const MetaHash *metahash, const torch::Data &data)
+{
+    return this->OverallWrite(metahash->block_index, data.GetBytes(), data.GetSize());
+}
+
+bool ContentSegment::OverallWrite(int32_t bindex, const void *data, size_t size)
 {
     Context   *ctx      = m_context;
-    MetaBlock *blockptr = ctx->block->GetByIndex(metahash->block_index);
-    char *dataptr       = (char*)data.GetBytes();
+    MetaBlock *blockptr = ctx->block->GetByIndex(bindex);
+    char *dataptr       = (char*)data;
     
     size_t wrotesize = 0;
     while (blockptr) {
@@ -68,7 +76,7 @@ bool ContentSegment::OverallWrite(const MetaHash *metahash, const torch::Data &d
     }
 
     // Wrote size != data size
-    assert(wrotesize == data.GetSize()); 
+    assert(wrotesize == size); 
     return true;
 }
 
@@ -98,3 +106,104 @@ bool ContentSegment::OverallRead(const MetaHash *metahash, torch::Data &outdata)
     
     return true;
 }
+
+bool ContentSegment::OverallCopy(Context *srcctx, const MetaHash *srchash, int32_t bindex, std::function<void(unsigned char *buffer, size_t size)> convert)
+{
+    Context   *ctx     = m_context;
+    MetaBlock *srcptr  = srcctx->block->GetByIndex(srchash->block_index);
+    MetaBlock *dstptr  = ctx->block->GetByIndex(bindex);
+    uint64_t   srcpos  = 0; /* position in current source block */
+    uint64_t   dstpos  = 0; /* position in current destination block */
+    torch::Data buffer(XPACK_CONTENT_COPYSIZE);
+    
+    // The chains are split differently, copy the overlap of the current blocks each time
+    while (true) {
+        while (srcptr && srcpos == srcptr->size) {
+            srcptr = srcctx->block->GetByIndex(srcptr->next_index);
+            srcpos = 0;
+        }
+        while (dstptr && dstpos == dstptr->size) {
+            dstptr = ctx->block->GetByIndex(dstptr->next_index);
+            dstpos = 0;
+        }
+        if (!srcptr || !dstptr) {
+            break;
+        }
+        
+        size_t size = (size_t)std::min(std::min(srcptr->size - srcpos, dstptr->size - dstpos), (uint64_t)buffer.GetSize());
+        unsigned char *bufptr = (unsigned char *)buffer.GetBytes();
+        if (!srcctx->stream->GetContent(bufptr, size, srcctx->offset + srcptr->offset + srcpos)) {
+            return false;
+        }
+        if (convert) {
+            convert(bufptr, size);
+        }
+        if (!ctx->stream->PutContent(bufptr, size, ctx->offset + dstptr->offset + dstpos)) {
+            return false;
+        }
+        srcpos += size;
+        dstpos += size;
+    }
+    
+    // Copied size != block chain size
+    assert(!srcptr && !dstptr);
+    return true;
+}
+
+bool ContentSegment::RangeRead(const MetaHash *metahash, uint64_t offset, size_t length, torch::Data &outdata)
+{
+    Context   *ctx      = m_context;
+    MetaBlock *blockptr = ctx->block->GetByIndex(metahash->block_index);
+    
+    outdata.ReSize(length);
+    char *dataptr = (char*)outdata.GetBytes();
+    
+    // Skip blocks before the range
+    while (blockptr && offset >= blockptr->size) {
+        offset -= blockptr->size;
+        blockptr = ctx->block->GetByIndex(blockptr->next_index);
+    }
+    
+    size_t readsize = 0;
+    while (blockptr && readsize < length) {
+        size_t n = (size_t)std::min((uint64_t)(length - readsize), blockptr->size - offset);
+        if (!ctx->stream->GetContent(dataptr + readsize, n, ctx->offset + blockptr->offset + offset)) {
+            return false;
+        }
+        readsize += n;
+        offset = 0;
+        blockptr = ctx->block->GetByIndex(blockptr->next_index);
+    }
+    
+    if (readsize != length) {
+        XPACK_ERROR(xpack::Error::Format); // Range out of content
+        return false;
+    }
+    return true;
+}
+
+bool ContentSegment::OverallView(const MetaHash *metahash, EntryView &outview)
+{
+    Context   *ctx      = m_context;
+    MetaBlock *blockptr = ctx->block->GetByIndex(metahash->block_index);
+    
+    outview.Clear();
+    while (blockptr) {
+        if (blockptr->size > 0) {
+            const void *dataptr = ctx->stream->GetContentPtr(blockptr->size, ctx->offset + blockptr->offset);
+            if (!dataptr) {
+                XPACK_ERROR(xpack::Error::NotSupport);
+                return false;
+            }
+            outview.Append(dataptr, blockptr->size);
+        }
+        if (blockptr->next_index >= 0) {
+            blockptr = ctx->block->GetByIndex(blockptr->next_index);
+        }
+        else {
+            blockptr = nullptr;
+        }
+    }
+    
+    return true;
+}
@@ -10,12 +10,14 @@
 #define __XPACK__CONTENT__
 
 #include <stdio.h>
+#include <functional>
 #include "xpack-def.h"
 #include "torch/torch.h"
 
 namespace xpack {
     
     class Context;
+    class EntryView;
     class ContentSegment {
     public:
         
@@ -34,6 +36,7 @@ namespace xpack {
          * 说明：要写入的数据大小必须和block链代表的content大小之和相等
          */
         bool OverallWrite(const MetaHash *metahash, const torch::Data &data);
+        bool OverallWrite(int32_t bindex, const void *data, size_t size);
         
         /*
          * 根据给定的block读取数据
@@ -42,6 +45,34 @@ namespace xpack {
          */
         bool OverallRead(const MetaHash *metahash, torch::Data &outdata);
         
+        /*
+         * 将另一个包(或本包)中存储项的原始数据复制到给定的block链
+         * 参数：
+         *  - srcctx, srchash: 源包的Context和源存储项
+         *  - bindex: 目标block链，大小之和必须和源存储项的block链相等
+         *  - convert: 每段数据写入前调用(按顺序)，可为null
+         * 说明：通过固定大小的缓冲区(XPACK_CONTENT_COPYSIZE)分段复制，不会将整个存储项读入内存
+         */
+        bool OverallCopy(Context *srcctx, const MetaHash *srchash, int32_t bindex, std::function<void(unsigned char *buffer, size_t size)> convert = nullptr);
+        
+        /*
+         * 根据给定的block读取指定范围的数据
+         * 参数：
+         *  - offset: 相对于存储内容起始的偏移(64位)
+         *  - length: 读取的长度，offset+length不能超出存储内容的大小
+         *  - outdata: 读取的数据，其size会被调整为length
+         * 说明：只读取覆盖该范围的block
+         */
+        bool RangeRead(const MetaHash *metahash, uint64_t offset, size_t length, torch::Data &outdata);
+        
+        /*
+         * 根据给定的block获取数据视图(不拷贝数据)
+         * 参数：
+         *  - outview: 获取的数据视图，每个block对应一个片段
+         * 注意：需要Stream支持GetContentPtr，否则返回false
+         */
+        bool OverallView(const MetaHash *metahash, EntryView &outview);
+        
     private:
         
         Context *m_context;
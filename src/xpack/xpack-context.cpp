@@ -14,6 +14,7 @@
 #include "xpack-block.h"
 #include "xpack-hash.h"
 #include "xpack-name.h"
+#include "xpack-perfecthash.h"
 
 #include <math.h>
 
@@ -60,9 +61,55 @@ Context::~Context()
     if (crypto)     { delete crypto; }
 }
 
-void Context::SetAlignedOffset(uint32_t offset)
+void Context::SetAlignedOffset(uint64_t offset)
 {
     double alignedsize = (double)xpack::SIGNATURE_ALIGNED;
     this->offset = ceil(offset / alignedsize) * alignedsize;
 }
 
+uint16_t Context::GetVersion()
+{
+    return signature->Metadata()->version;
+}
+
+bool Context::IsVersion32()
+{
+    return this->GetVersion() == xpack::VERSION_32;
+}
+
+size_t Context::GetHeaderSize()
+{
+    return this->IsVersion32() ? sizeof(MetaHeader32) : sizeof(MetaHeader);
+}
+
+size_t Context::GetHashRecordSize()
+{
+    return this->IsVersion32() ? sizeof(MetaHash32) : sizeof(MetaHash);
+}
+
+size_t Context::GetBlockRecordSize()
+{
+    return this->IsVersion32() ? sizeof(MetaBlock32) : sizeof(MetaBlock);
+}
+
+size_t Context::GetFingerprintSize()
+{
+    if (this->IsVersion32() || !(header->Metadata()->features & uint32_t(HeaderFeatures::NameFingerprint))) {
+        return 0;
+    }
+    return sizeof(uint64_t);
+}
+
+size_t Context::GetPerfectHashSize()
+{
+    if (this->GetFingerprintSize() == 0 || header->Metadata()->hash_count == 0 || !(header->Metadata()->features & uint32_t(HeaderFeatures::PerfectHash))) {
+        return 0;
+    }
+    return PerfectHash::GetSize(header->Metadata()->hash_count);
+}
+
+uint64_t Context::GetHashSegmentSize()
+{
+    MetaHeader *metaheader = header->Metadata();
+    return (uint64_t)metaheader->hash_count * (this->GetHashRecordSize() + this->GetFingerprintSize()) + this->GetPerfectHashSize();
+}
@@ -37,7 +37,7 @@ namespace xpack {
         HashSegment        *hash;
         NameSegment        *name;
         
-        uint32_t            offset;    /* xpack archive offset */
+        uint64_t            offset;    /* xpack archive offset */
 
         torch::crypto::RC4 *crypto;
 
@@ -50,7 +50,42 @@ namespace xpack {
          * - 内部会将ctx->offset偏移对齐到xpack::SIGNATURE_ALIGNED(512)
          *  - 可以直接设置ctx->offset，其会在内部保障数据存储位置的对齐
          */
-        void SetAlignedOffset(uint32_t offset);
+        void SetAlignedOffset(uint64_t offset);
+        
+        /*
+         * 获得包的格式版本(由签名区域记录)
+         * 说明：
+         *  - xpack::VERSION使用64位偏移与尺寸，xpack::VERSION_32为旧版本的32位格式
+         *  - 包在读写过程中保持原有的格式版本
+         */
+        uint16_t GetVersion();
+        bool     IsVersion32();
+        
+        /*
+         * 获得当前格式版本下元信息在文件中的尺寸
+         */
+        size_t GetHeaderSize();
+        size_t GetHashRecordSize();
+        size_t GetBlockRecordSize();
+        
+        /*
+         * 获得每个Hash记录对应的名字指纹的尺寸(HeaderFeatures::NameFingerprint)，未开启时为0
+         * 说明：
+         *  - 指纹区段位于Hash区段之后，Name区段之前
+         */
+        size_t GetFingerprintSize();
+        
+        /*
+         * 获得完美哈希数据的尺寸(HeaderFeatures::PerfectHash)，未封存时为0
+         * 说明：
+         *  - 完美哈希数据位于指纹区段之后，Name区段之前，尺寸由hash_count决定
+         */
+        size_t GetPerfectHashSize();
+        
+        /*
+         * 获得Hash区段的总尺寸(Hash记录、名字指纹、完美哈希)，Name区段紧随其后
+         */
+        uint64_t GetHashSegmentSize();
     };
 
 }
@@ -14,15 +14,24 @@
 #define XPACK_WHERE torch::String::Format("%s:%s:%d", __FILE__, __FUNCTION__, __LINE__).c_str()
 #define XPACK_ERROR(__errco) xpack::SetLastError(int32_t(__errco), XPACK_WHERE)
 
+#if defined(__GNUC__) || defined(__clang__)
+#define XPACK_PREFETCH(__addr) __builtin_prefetch(__addr)
+#else
+#define XPACK_PREFETCH(__addr)
+#endif
+
 namespace xpack {
     
     typedef int32_t xpack_index_t; 
     typedef uint32_t xpack_hashid_t;
-    typedef uint32_t xpack_size_t;
+    typedef uint64_t xpack_size_t;
     
     enum {
         SIGNATURE   = 0x1A4B434150585E1A,   /* the 0x1A4B434150585E1A ('\x1A^XPACK\x1A') signature */
-        VERSION     = 0x0009,               /* 0x0009 for now */
+        VERSION     = 0x000A,               /* 0x000A for now, 64-bit offsets and sizes */
+        VERSION_32  = 0x0009,               /* 0x0009, 32-bit offsets and sizes, still readable and writable */
+        FEATURES    = 0x0000001F,           /* feature bits (MetaHeader.features) understood by this version */
+        DEFAULT_FEATURES = 0x0000001B,      /* feature bits written by default, all but PerfectHash (Package::SetFeatures) */
         SIGNATURE_ALIGNED = 0x200,          /* signature has to start at an offset aligned to 512 (0x200) bytes. */
     };
     
@@ -37,10 +46,30 @@ namespace xpack {
         AlreadyExists   = -11,
         NotExists       = -12,
         Compress        = -13,
+        NotSupport      = -14,
+        InvalidHandle   = -15,   /* entry handle is null or expired. */
         
         Unknow          = -99
     };
 
+    enum class StreamType {
+        File,                           /* xpack::FileStream */
+        Mmap,                           /* xpack::MmapStream, read only */
+        Fd,                             /* xpack::FdStream, pread/pwrite */
+    };
+
+    enum class LoadMode {
+        Eager,                          /* read block/hash/name segments in Open */
+        Lazy,                           /* read them on first use */
+        Background,                     /* read them in a thread started by Open */
+    };
+
+    enum class AllocPolicy {
+        SmallestFirst,                  /* chain the smallest free extents first, least disk space */
+        BestFit,                        /* smallest single free extent that fits, else append at the content tail */
+        BoundedChain,                   /* best fit, else the largest free extents up to a chain length, rest at the tail */
+    };
+
     enum class HashFlags {
         Unused       = 1 << 0,          /* mark unused item */
         Conflict     = 1 << 1,          /* mark conflict item */
@@ -48,6 +77,14 @@ namespace xpack {
         Compressed   = 1 << 3,
     };
     
+    enum class HeaderFeatures {
+        SortedHash   = 1 << 0,          /* hash segment is sorted by hashid, 0x000A only */
+        NameFingerprint = 1 << 1,       /* 64-bit name fingerprints follow the hash segment, 0x000A only */
+        PerfectHash  = 1 << 2,          /* perfect hash over fingerprints follows them, set by Package::Seal */
+        SortedNames  = 1 << 3,          /* name segment is laid out in byte-wise name order, 0x000A only */
+        FrontCodedNames = 1 << 4,       /* name segment is front coded in buckets, name_offset is the name order, 0x000A only */
+    };
+    
     enum class BlockFlags {
         UnusedContent  = 1 << 0,      /* mark item's content unused */
         UnusedBlock    = 1 << 1,      /* mark unused item */
@@ -65,14 +102,15 @@ namespace xpack {
     
     
     typedef struct {
-        uint32_t	archive_size;	/* size of xpack archive. */
-        uint32_t	content_offset;	/* file position of file content segment. */
-        uint32_t	content_size;   /* size of file content segment. */
-        uint32_t	block_offset;	/* file position of blocks segment. */
+        uint64_t	archive_size;	/* size of xpack archive. */
+        uint64_t	content_offset;	/* file position of file content segment. */
+        uint64_t	content_size;   /* size of file content segment. */
+        uint64_t	block_offset;	/* file position of blocks segment. */
         uint32_t	block_count;	/* number of entries in the block table. */
-        uint32_t	hash_offset;	/* file position of hashs segment. */
+        uint64_t	hash_offset;	/* file position of hashs segment. */
         uint32_t	hash_count;     /* number of entries in hash table. */
         uint32_t	name_size;      /* name size in bytes. */
+        uint32_t	features;       /* feature bits, reader fails on unknown bits. */
         uint8_t     reserved[16];   /* 16 bytes reserved.  */
     } MetaHeader;
     
@@ -81,7 +119,7 @@ namespace xpack {
         uint32_t    hash;           /* hashid */
         uint32_t    crc;
         int32_t     block_index;    /* block chain first index */
-        uint32_t    unpacked_size;  /* original size */
+        uint64_t    unpacked_size;  /* original size */
         uint32_t    name_offset;    /* relative offset in name segment */
         uint16_t    name_size;
         uint8_t     conflict_refc;  /* conflict references counting */
@@ -91,13 +129,51 @@ namespace xpack {
     
     
     typedef struct {
-        uint32_t	offset;
-        uint32_t	size;
+        uint64_t	offset;
+        uint64_t	size;
         int32_t     next_index;     /* block chain next index */
         uint8_t     flags;          /* unused-content, unused-block, not-start */
     } MetaBlock;
     
     
+    /*
+     * 0x0009版本的存储格式(32位偏移与尺寸)
+     * 说明：只在读写旧版本的包时使用，读取后转换为上面的结构，写入前再转换回来
+     */
+    typedef struct {
+        uint32_t	archive_size;
+        uint32_t	content_offset;
+        uint32_t	content_size;
+        uint32_t	block_offset;
+        uint32_t	block_count;
+        uint32_t	hash_offset;
+        uint32_t	hash_count;
+        uint32_t	name_size;
+        uint8_t     reserved[16];
+    } MetaHeader32;
+    
+    
+    typedef struct {
+        uint32_t    hash;
+        uint32_t    crc;
+        int32_t     block_index;
+        uint32_t    unpacked_size;
+        uint32_t    name_offset;
+        uint16_t    name_size;
+        uint8_t     conflict_refc;
+        uint8_t     salt;
+        uint8_t     flags;
+    } MetaHash32;
+    
+    
+    typedef struct {
+        uint32_t	offset;
+        uint32_t	size;
+        int32_t     next_index;
+        uint8_t     flags;
+    } MetaBlock32;
+    
+    
 #pragma pack(pop)
     
     
@@ -0,0 +1,584 @@
+//
+//  xpack
+//
+//  Created by Luwei.
+//  Copyright (c) 2016 Luwei. All rights reserved.
+//  Github: https://github.com/Luweimy
+//
+
+#include "xpack-entry.h"
+#include "xpack-context.h"
+#include "xpack-stream.h"
+#include "xpack-block.h"
+#include "xpack-content.h"
+#include "xpack-header.h"
+#include "xpack-hash.h"
+#include "xpack-name.h"
+#include "xpack.h"
+#include "xpack-base.h"
+#include "xpack-def.h"
+#include "torch/deps/zlib/zlib.h"
+#include <string.h>
+#include <limits.h>
+#include <algorithm>
+
+#define XPACK_ENTRY_BUFFSIZE (16 * 1024)
+#define XPACK_ENTRY_WRITESIZE (256 * 1024)
+#ifdef XPACK_TEST
+#define XPACK_ENTRY_DEFLATESIZE (64 * 1024)            /* small pieces so that tests cross them */
+#else
+#define XPACK_ENTRY_DEFLATESIZE ((size_t)UINT32_MAX)   /* z_stream.avail_in is 32-bit */
+#endif
+
+using namespace xpack;
+
+/// EntryReader
+
+EntryReader::EntryReader()
+:m_context(nullptr)
+,m_blockindex(-1)
+,m_blockoffset(0)
+,m_pos(0)
+,m_zstream(nullptr)
+,m_needcrc(false)
+,m_crcvalid(false)
+{
+    memset(&m_metahash, 0, sizeof(MetaHash));
+}
+
+EntryReader::~EntryReader()
+{
+    this->Close();
+}
+
+bool EntryReader::IsOpen()
+{
+    return m_context != nullptr;
+}
+
+void EntryReader::Close()
+{
+    if (m_zstream) {
+        inflateEnd(m_zstream);
+        delete m_zstream;
+    }
+    m_zstream = nullptr;
+    m_context = nullptr;
+    m_blockindex = -1;
+    m_blockoffset = 0;
+    m_pos = 0;
+}
+
+bool EntryReader::Open(Context *ctx, const MetaHash *metahash, const torch::Data &skey, bool needcrc)
+{
+    assert(ctx && metahash);
+    this->Close();
+    
+    m_metahash = *metahash;
+    m_needcrc = needcrc;
+    m_skey.CopyFrom(skey);
+    
+    if (m_metahash.flags & int(HashFlags::Compressed)) {
+        m_zstream = new z_stream;
+        memset(m_zstream, 0, sizeof(z_stream));
+        if (inflateInit(m_zstream) != Z_OK) {
+            delete m_zstream;
+            m_zstream = nullptr;
+            XPACK_ERROR(xpack::Error::Compress);
+            return false;
+        }
+        m_inbuffer.Alloc(XPACK_ENTRY_BUFFSIZE);
+    }
+    
+    m_context = ctx;
+    return this->Rewind();
+}
+
+int64_t EntryReader::Read(void *buffer, size_t size)
+{
+    if (!this->IsOpen()) {
+        XPACK_ERROR(xpack::Error::IO);
+        return -1;
+    }
+    
+    uint64_t remain = this->GetSize() - m_pos;
+    if (size > remain) {
+        size = (size_t)remain;
+    }
+    if (size == 0) {
+        return 0;
+    }
+    
+    int64_t rsize = 0;
+    if (m_zstream) {
+        rsize = this->ReadInflated(buffer, size);
+    }
+    else {
+        rsize = this->ReadStored(buffer, size);
+    }
+    if (rsize < 0) {
+        return -1;
+    }
+    if (rsize == 0) {
+        XPACK_ERROR(xpack::Error::Format); // Content shorter than unpacked size
+        return -1;
+    }
+    
+    if (m_needcrc && m_crcvalid) {
+        m_crc32.ComputeBlock((const unsigned char *)buffer, (size_t)rsize);
+    }
+    m_pos += rsize;
+    
+    // Crc32 check at last
+    if (m_pos == this->GetSize() && !this->VerifyCrc()) {
+        return -1;
+    }
+    return rsize;
+}
+
+bool EntryReader::Seek(uint64_t pos)
+{
+    if (!this->IsOpen()) {
+        XPACK_ERROR(xpack::Error::IO);
+        return false;
+    }
+    if (pos > this->GetSize()) {
+        XPACK_ERROR(xpack::Error::Format);
+        return false;
+    }
+    if (pos == m_pos) {
+        return true;
+    }
+    
+    if (m_zstream) {
+        // Compressed data can only be walked forward
+        if (pos < m_pos && !this->Rewind()) {
+            return false;
+        }
+        return this->Skip(pos - m_pos);
+    }
+    return this->SeekStored(pos);
+}
+
+uint64_t EntryReader::Tell()
+{
+    return m_pos;
+}
+
+uint64_t EntryReader::GetSize()
+{
+    return m_metahash.unpacked_size;
+}
+
+bool EntryReader::Rewind()
+{
+    m_blockindex  = m_metahash.block_index;
+    m_blockoffset = 0;
+    m_pos         = 0;
+    m_crcvalid    = true;
+    m_crc32       = torch::crypto::Crc32();
+    
+    if (m_metahash.flags & int(HashFlags::CryptoRC4)) {
+        arc4_setup(&m_arc4, (unsigned char *)m_skey.GetBytes(), (int)m_skey.GetSize());
+    }
+    if (m_zstream) {
+        if (inflateReset(m_zstream) != Z_OK) {
+            XPACK_ERROR(xpack::Error::Compress);
+            return false;
+        }
+        m_zstream->next_in  = nullptr;
+        m_zstream->avail_in = 0;
+    }
+    return true;
+}
+
+bool EntryReader::Skip(uint64_t size)
+{
+    unsigned char scratch[XPACK_ENTRY_BUFFSIZE];
+    while (size > 0) {
+        int64_t rsize = this->Read(scratch, (size_t)std::min(size, (uint64_t)sizeof(scratch)));
+        if (rsize <= 0) {
+            return false;
+        }
+        size -= rsize;
+    }
+    return true;
+}
+
+bool EntryReader::SeekStored(uint64_t pos)
+{
+    if (pos == 0) {
+        return this->Rewind();
+    }
+    
+    Context *ctx = m_context;
+    int32_t  bindex = m_metahash.block_index;
+    uint64_t remain = pos;
+    while (bindex >= 0) {
+        MetaBlock *blockptr = ctx->block->GetByIndex(bindex);
+        if (!blockptr) {
+            XPACK_ERROR(xpack::Error::Format);
+            return false;
+        }
+        if (remain < blockptr->size) {
+            break;
+        }
+        remain -= blockptr->size;
+        bindex = blockptr->next_index;
+    }
+    
+    // Stream cipher, the key stream has to be advanced to the new position
+    if (m_metahash.flags & int(HashFlags::CryptoRC4)) {
+        unsigned char scratch[XPACK_ENTRY_BUFFSIZE];
+        arc4_setup(&m_arc4, (unsigned char *)m_skey.GetBytes(), (int)m_skey.GetSize());
+        for (uint64_t skip = pos; skip > 0; ) {
+            size_t n = (size_t)std::min(skip, (uint64_t)sizeof(scratch));
+            arc4_crypt(&m_arc4, scratch, (int)n);
+            skip -= n;
+        }
+    }
+    
+    m_blockindex  = bindex;
+    m_blockoffset = remain;
+    m_pos         = pos;
+    m_crcvalid    = false;
+    return true;
+}
+
+int64_t EntryReader::ReadStored(void *buffer, size_t size)
+{
+    Context *ctx   = m_context;
+    char *dataptr  = (char *)buffer;
+    size_t rsize   = 0;
+    size = std::min(size, (size_t)INT_MAX); // arc4_crypt takes an int length
+    
+    while (rsize < size && m_blockindex >= 0) {
+        MetaBlock *blockptr = ctx->block->GetByIndex(m_blockindex);
+        if (!blockptr) {
+            XPACK_ERROR(xpack::Error::Format);
+            return -1;
+        }
+        if (m_blockoffset >= blockptr->size) {
+            m_blockindex  = blockptr->next_index;
+            m_blockoffset = 0;
+            continue;
+        }
+        
+        size_t n = (size_t)std::min((uint64_t)(size - rsize), blockptr->size - m_blockoffset);
+        if (!ctx->stream->GetContent(dataptr + rsize, n, ctx->offset + blockptr->offset + m_blockoffset)) {
+            return -1;
+        }
+        m_blockoffset += n;
+        rsize += n;
+    }
+    
+    if (m_metahash.flags & int(HashFlags::CryptoRC4)) {
+        arc4_crypt(&m_arc4, (unsigned char *)dataptr, (int)rsize);
+    }
+    return (int64_t)rsize;
+}
+
+int64_t EntryReader::ReadInflated(void *buffer, size_t size)
+{
+    z_stream *zs = m_zstream;
+    size = std::min(size, (size_t)UINT32_MAX);
+    zs->next_out  = (Bytef *)buffer;
+    zs->avail_out = (uInt)size;
+    
+    while (zs->avail_out > 0) {
+        if (zs->avail_in == 0) {
+            int64_t rsize = this->ReadStored(m_inbuffer.GetBytes(), m_inbuffer.GetSize());
+            if (rsize < 0) {
+                return -1;
+            }
+            if (rsize == 0) {
+                break; // No more stored data
+            }
+            zs->next_in  = (Bytef *)m_inbuffer.GetBytes();
+            zs->avail_in = (uInt)rsize;
+        }
+        
+        int ret = inflate(zs, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) {
+            break;
+        }
+        if (ret != Z_OK) {
+            XPACK_ERROR(xpack::Error::Compress);
+            return -1;
+        }
+    }
+    return (int64_t)(size - zs->avail_out);
+}
+
+bool EntryReader::VerifyCrc()
+{
+    if (!m_needcrc || !m_crcvalid) {
+        return true;
+    }
+    m_crcvalid = false; // Check only once
+    if (m_metahash.crc != m_crc32.GetCrc32()) {
+        XPACK_ERROR(xpack::Error::CRC);
+        return false;
+    }
+    return true;
+}
+
+/// EntryWriter
+
+EntryWriter::EntryWriter()
+:m_package(nullptr)
+,m_context(nullptr)
+,m_flags(0)
+,m_headindex(-1)
+,m_tailindex(-1)
+,m_size(0)
+,m_zstream(nullptr)
+,m_outsize(0)
+,m_needcrc(false)
+{
+}
+
+EntryWriter::~EntryWriter()
+{
+    this->Abort();
+}
+
+bool EntryWriter::IsOpen()
+{
+    return m_context != nullptr;
+}
+
+bool EntryWriter::Open(Package *package, Context *ctx, const std::string &name, const torch::Data &skey, bool needcrc, bool crypto, bool compress)
+{
+    assert(package && ctx);
+    this->Abort();
+    
+    m_name    = name;
+    m_flags   = 0;
+    m_needcrc = needcrc;
+    m_crc32   = torch::crypto::Crc32();
+    
+    if (crypto) {
+        m_flags |= int(HashFlags::CryptoRC4);
+        arc4_setup(&m_arc4, (unsigned char *)skey.GetBytes(), (int)skey.GetSize());
+    }
+    if (compress) {
+        m_flags |= int(HashFlags::Compressed);
+        m_zstream = new z_stream;
+        memset(m_zstream, 0, sizeof(z_stream));
+        if (deflateInit(m_zstream, Z_DEFAULT_COMPRESSION) != Z_OK) {
+            delete m_zstream;
+            m_zstream = nullptr;
+            XPACK_ERROR(xpack::Error::Compress);
+            return false;
+        }
+    }
+    if (m_outbuffer.GetSize() != XPACK_ENTRY_WRITESIZE) {
+        m_outbuffer.Alloc(XPACK_ENTRY_WRITESIZE);
+    }
+    
+    m_package = package;
+    m_context = ctx;
+    return true;
+}
+
+bool EntryWriter::Write(const void *buffer, size_t size)
+{
+    if (!this->IsOpen()) {
+        XPACK_ERROR(xpack::Error::IO);
+        return false;
+    }
+    
+    // Sizes are recorded as 32-bit in 0x0009 format
+    if (m_context->IsVersion32() && size > UINT32_MAX - m_size) {
+        XPACK_ERROR(xpack::Error::Format);
+        this->Abort();
+        return false;
+    }
+    
+    if (m_needcrc) {
+        m_crc32.ComputeBlock((const unsigned char *)buffer, size);
+    }
+    m_size += size;
+    
+    bool ok = false;
+    if (m_zstream) {
+        ok = this->Deflate(buffer, size, Z_NO_FLUSH);
+    }
+    else {
+        ok = this->WriteStored(buffer, size);
+    }
+    if (!ok) {
+        this->Abort();
+    }
+    return ok;
+}
+
+bool EntryWriter::Commit()
+{
+    if (!this->IsOpen()) {
+        XPACK_ERROR(xpack::Error::IO);
+        return false;
+    }
+    
+    if (m_zstream && !this->Deflate(nullptr, 0, Z_FINISH)) {
+        this->Abort();
+        return false;
+    }
+    if (!this->FlushStored()) {
+        this->Abort();
+        return false;
+    }
+    
+    Context *ctx = m_context;
+    if (m_headindex < 0) {
+        m_headindex = ctx->block->AllocLinkedBlock(0); // Empty entry
+        assert(m_headindex >= 0);
+    }
+    
+    MetaHash *metahash = ctx->hash->AddNew(m_name);
+    if (!metahash) {
+        this->Abort(); // Duplicate name
+        return false;
+    }
+    
+    metahash->flags |= m_flags;
+    if (m_needcrc) {
+        metahash->crc = m_crc32.GetCrc32();
+    }
+    metahash->block_index = m_headindex;
+    metahash->unpacked_size = m_size;
+    
+    ctx->name->AddName(m_name, metahash);
+    ctx->header->UpdateMetadata();
+    m_package->MarkModified();
+    
+    m_headindex = -1; // Blocks belong to the entry now
+    this->Close();
+    return true;
+}
+
+void EntryWriter::Abort()
+{
+    if (this->IsOpen() && m_headindex >= 0) {
+        m_context->block->RemoveByIndex(m_headindex);
+    }
+    this->Close();
+}
+
+uint64_t EntryWriter::GetSize()
+{
+    return m_size;
+}
+
+bool EntryWriter::Deflate(const void *buffer, size_t size, int flush)
+{
+    z_stream *zs = m_zstream;
+    char *outptr = (char *)m_outbuffer.GetBytes();
+    size_t outcap = m_outbuffer.GetSize();
+    
+    const char *dataptr = (const char *)buffer;
+    
+    // Input larger than avail_in can hold is fed piece by piece, finishing with the last one
+    do {
+        size_t piece = std::min(size, (size_t)XPACK_ENTRY_DEFLATESIZE);
+        int pieceflush = piece == size ? flush : Z_NO_FLUSH;
+        zs->next_in  = (Bytef *)dataptr;
+        zs->avail_in = (uInt)piece;
+        
+        while (true) {
+            zs->next_out  = (Bytef *)(outptr + m_outsize);
+            zs->avail_out = (uInt)(outcap - m_outsize);
+            
+            int ret = deflate(zs, pieceflush);
+            if (ret == Z_STREAM_ERROR) {
+                XPACK_ERROR(xpack::Error::Compress);
+                return false;
+            }
+            m_outsize = outcap - zs->avail_out;
+            if (m_outsize == outcap && !this->FlushStored()) {
+                return false;
+            }
+            
+            if (pieceflush == Z_FINISH) {
+                if (ret == Z_STREAM_END) {
+                    break;
+                }
+            }
+            else if (zs->avail_in == 0 && zs->avail_out > 0) {
+                break; // All input consumed
+            }
+        }
+        dataptr += piece;
+        size    -= piece;
+    } while (size > 0);
+    return true;
+}
+
+bool EntryWriter::WriteStored(const void *buffer, size_t size)
+{
+    const char *dataptr = (const char *)buffer;
+    size_t outcap = m_outbuffer.GetSize();
+    
+    while (size > 0) {
+        size_t n = std::min(size, outcap - m_outsize);
+        memcpy((char *)m_outbuffer.GetBytes() + m_outsize, dataptr, n);
+        m_outsize += n;
+        dataptr += n;
+        size -= n;
+        if (m_outsize == outcap && !this->FlushStored()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool EntryWriter::FlushStored()
+{
+    if (m_outsize == 0) {
+        return true;
+    }
+    
+    Context *ctx = m_context;
+    unsigned char *outptr = (unsigned char *)m_outbuffer.GetBytes();
+    if (m_flags & int(HashFlags::CryptoRC4)) {
+        arc4_crypt(&m_arc4, outptr, (int)m_outsize);
+    }
+    
+    // Blocks are allocated as data arrives, then linked behind the written chain
+    int32_t bindex = ctx->block->AllocLinkedBlock(m_outsize);
+    assert(bindex >= 0);
+    if (!ctx->content->OverallWrite(bindex, outptr, m_outsize)) {
+        ctx->block->RemoveByIndex(bindex);
+        return false;
+    }
+    
+    if (m_headindex < 0) {
+        m_headindex = bindex;
+        m_tailindex = bindex;
+        for (MetaBlock *metablock = ctx->block->GetByIndex(bindex); metablock->next_index >= 0; ) {
+            m_tailindex = metablock->next_index;
+            metablock = ctx->block->GetByIndex(m_tailindex);
+        }
+    }
+    else {
+        m_tailindex = ctx->block->ConcatLinkedBlock(m_tailindex, bindex);
+    }
+    m_outsize = 0;
+    return true;
+}
+
+void EntryWriter::Close()
+{
+    if (m_zstream) {
+        deflateEnd(m_zstream);
+        delete m_zstream;
+    }
+    m_zstream   = nullptr;
+    m_package   = nullptr;
+    m_context   = nullptr;
+    m_headindex = -1;
+    m_tailindex = -1;
+    m_size      = 0;
+    m_outsize   = 0;
+}
@@ -0,0 +1,171 @@
+//
+//  xpack
+//
+//  Created by Luwei.
+//  Copyright (c) 2016 Luwei. All rights reserved.
+//  Github: https://github.com/Luweimy
+//
+
+#ifndef __XPACK__ENTRY__
+#define __XPACK__ENTRY__
+
+#include <stdio.h>
+#include <string>
+#include "torch/torch.h"
+#include "xpack-def.h"
+
+struct z_stream_s;
+
+namespace xpack {
+
+    class Context;
+    class Package;
+
+    /*
+     * 存储项读取器(流式读取)
+     * 说明：
+     *  - 通过Package::OpenEntry()打开，按需沿block链读取，不会一次性将整个存储项读入内存
+     *  - 压缩的存储项使用zlib流式解压，加密的存储项使用RC4流式解密
+     *  - 开启CRC校验时，从头顺序读取到末尾时进行校验，Seek过后不再校验
+     * 注意：
+     *  - 读取器只在包未关闭且未被修改期间有效
+     *  - 读取器本身不是线程安全的，但多个读取器可以在不同线程中同时读取同一个只读包
+     */
+    class EntryReader {
+    public:
+        EntryReader();
+        ~EntryReader();
+        EntryReader(const EntryReader &) = delete;
+        EntryReader& operator=(const EntryReader &) = delete;
+
+        bool IsOpen();
+        void Close();
+
+        /*
+         * 从当前位置读取数据
+         * 返回值：
+         *  - 实际读取的字节数，到达末尾时返回0，发生错误返回-1(错误信息使用xpack::GetLastError()获取)
+         * 说明：
+         *  - 实际读取的字节数可能小于size(单次最多读取INT_MAX字节)，需要循环读取
+         */
+        int64_t Read(void *buffer, size_t size);
+
+        /*
+         * 设置读取位置(解包后的数据位置)
+         * 说明：
+         *  - 未压缩的存储项直接定位到对应的block
+         *  - 压缩的存储项向后Seek时需要从头解压，向前Seek会解压并跳过中间的数据
+         */
+        bool Seek(uint64_t pos);
+        uint64_t Tell();
+
+        /*
+         * 获得存储项解包后的大小
+         */
+        uint64_t GetSize();
+
+    private:
+        friend class Package;
+        bool Open(Context *ctx, const MetaHash *metahash, const torch::Data &skey, bool needcrc);
+
+        bool    Rewind();
+        bool    Skip(uint64_t size);
+        bool    SeekStored(uint64_t pos);
+        int64_t ReadStored(void *buffer, size_t size);
+        int64_t ReadInflated(void *buffer, size_t size);
+        bool    VerifyCrc();
+
+    private:
+        Context      *m_context;
+        MetaHash      m_metahash;
+
+        int32_t       m_blockindex;   /* current block */
+        uint64_t      m_blockoffset;  /* read position in current block */
+        uint64_t      m_pos;          /* read position of unpacked data */
+
+        torch::Data   m_skey;
+        arc4_context  m_arc4;
+
+        z_stream_s   *m_zstream;
+        torch::Data   m_inbuffer;
+
+        bool          m_needcrc;
+        bool          m_crcvalid;     /* read sequentially from the beginning */
+        torch::crypto::Crc32 m_crc32;
+    };
+
+
+    /*
+     * 存储项写入器(流式写入)
+     * 说明：
+     *  - 通过Package::CreateEntry()创建，数据边写入边申请block，不会将整个存储项缓存在内存中
+     *  - 压缩使用zlib流式压缩，加密使用RC4流式加密，CRC随写入累加计算，结果与AddEntry()一致
+     *  - 调用Commit()后存储项才会加入包中，未提交即关闭(Abort或析构)会释放已申请的block
+     * 注意：
+     *  - 写入器只在包未关闭期间有效，同一时间只应有一个写入器
+     *  - 提交前不要调用Flush()，否则已写入的内容会成为无主的block
+     */
+    class EntryWriter {
+    public:
+        EntryWriter();
+        ~EntryWriter();
+        EntryWriter(const EntryWriter &) = delete;
+        EntryWriter& operator=(const EntryWriter &) = delete;
+
+        bool IsOpen();
+
+        /*
+         * 追加写入数据
+         * 注意：
+         *  - 失败后写入器会被关闭，已写入的内容会被丢弃
+         */
+        bool Write(const void *buffer, size_t size);
+
+        /*
+         * 提交存储项，成功后写入器被关闭
+         * 注意：
+         *  - 若包中已存在同名存储项会提交失败，已写入的内容会被丢弃
+         */
+        bool Commit();
+
+        /*
+         * 放弃写入，释放已申请的block
+         */
+        void Abort();
+
+        /*
+         * 获得已写入的大小(解包后的大小)
+         */
+        uint64_t GetSize();
+
+    private:
+        friend class Package;
+        bool Open(Package *package, Context *ctx, const std::string &name, const torch::Data &skey, bool needcrc, bool crypto, bool compress);
+
+        bool    Deflate(const void *buffer, size_t size, int flush);
+        bool    WriteStored(const void *buffer, size_t size);
+        bool    FlushStored();
+        void    Close();
+
+    private:
+        Package      *m_package;
+        Context      *m_context;
+        std::string   m_name;
+        uint8_t       m_flags;
+
+        int32_t       m_headindex;    /* head of written block chain */
+        int32_t       m_tailindex;    /* tail of written block chain */
+        uint64_t      m_size;         /* size of unpacked data */
+
+        arc4_context  m_arc4;
+        z_stream_s   *m_zstream;
+        torch::Data   m_outbuffer;    /* stored data pending to write */
+        size_t        m_outsize;
+
+        bool          m_needcrc;
+        torch::crypto::Crc32 m_crc32;
+    };
+
+}
+
+#endif /* __XPACK__ENTRY__ */
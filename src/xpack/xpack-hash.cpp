@@ -12,13 +12,50 @@
 #include "xpack-context.h"
 #include "xpack-stream.h"
 #include "xpack-util.h"
+#include "xpack-perfecthash.h"
 #include "xpack-base.h"
 #include "xpack-def.h"
 #include <vector>
 #include <unordered_set>
+#include <algorithm>
+
+#define XPACK_HASH_LOOKAHEAD 16   /* names hashed and prefetched ahead in QueryByNames */
 
 using namespace xpack;
 
+// 0x0009 format keeps 32-bit hashs on disk
+static void WidenHashs(MetaHash *dst, const MetaHash32 *src, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        dst[i].hash          = src[i].hash;
+        dst[i].crc           = src[i].crc;
+        dst[i].block_index   = src[i].block_index;
+        dst[i].unpacked_size = src[i].unpacked_size;
+        dst[i].name_offset   = src[i].name_offset;
+        dst[i].name_size     = src[i].name_size;
+        dst[i].conflict_refc = src[i].conflict_refc;
+        dst[i].salt          = src[i].salt;
+        dst[i].flags         = src[i].flags;
+    }
+}
+
+static bool NarrowHash(MetaHash32 *dst, const MetaHash *src)
+{
+    if (src->unpacked_size > UINT32_MAX) {
+        return false;
+    }
+    dst->hash          = src->hash;
+    dst->crc           = src->crc;
+    dst->block_index   = src->block_index;
+    dst->unpacked_size = (uint32_t)src->unpacked_size;
+    dst->name_offset   = src->name_offset;
+    dst->name_size     = src->name_size;
+    dst->conflict_refc = src->conflict_refc;
+    dst->salt          = src->salt;
+    dst->flags         = src->flags;
+    return true;
+}
+
 HashSegment::HashSegment(Context *ctx)
 :m_context(ctx)
 ,m_slatcursor(0)
@@ -33,7 +70,7 @@ HashSegment::~HashSegment()
     m_context = nullptr;
 }
 
-bool HashSegment::ReadFromStream()
+bool HashSegment::ReadFromStream(bool readonly)
 {
     if (!this->IsValid()) {
         return true;
@@ -41,37 +78,223 @@ bool HashSegment::ReadFromStream()
     
     Context *ctx = m_context;
     
-    uint32_t hashoffset = ctx->offset + ctx->header->Metadata()->hash_offset;
+    uint64_t hashoffset = ctx->offset + ctx->header->Metadata()->hash_offset;
     uint32_t hashcount  = ctx->header->Metadata()->hash_count;
     
-    torch::Data rb(hashcount * sizeof(MetaHash));
-    MetaHash *hashptr = (MetaHash *)rb.GetBytes();
+    m_sorted.Alloc(hashcount * sizeof(MetaHash));
+    MetaHash *hashptr = (MetaHash *)m_sorted.GetBytes();
     
-    if (!ctx->stream->GetHashs(hashptr, hashoffset, hashcount)) {
+    if (ctx->IsVersion32()) {
+        torch::Data rb32(hashcount * sizeof(MetaHash32));
+        if (!ctx->stream->GetHashs32(rb32.GetBytes(), hashoffset, hashcount)) {
+            m_sorted.Free();
+            return false;
+        }
+        ctx->crypto->CryptoNoCopy((unsigned char*)rb32.GetBytes(), (int)rb32.GetSize());
+        WidenHashs(hashptr, (MetaHash32 *)rb32.GetBytes(), hashcount);
+    }
+    else {
+        if (!ctx->stream->GetHashs(hashptr, hashoffset, hashcount)) {
+            m_sorted.Free();
+            return false;
+        }
+        
+        // Decrypt hashs data
+        ctx->crypto->CryptoNoCopy((unsigned char*)m_sorted.GetBytes(), (int)m_sorted.GetSize());
+    }
+    
+    if (!this->IsValid()) {
+        m_sorted.Free();
+        XPACK_ERROR(xpack::Error::Format);
         return false;
     }
     
-    // Decrypt hashs data
-    ctx->crypto->CryptoNoCopy((unsigned char*)rb.GetBytes(), (int)rb.GetSize());
+    if (!this->ReadPerfectHash()) {
+        m_sorted.Free();
+        return false;
+    }
     
-    if (!this->IsValid()) {
+    if (ctx->header->Metadata()->features & uint32_t(HeaderFeatures::SortedHash)) {
+        // Strictly ascending, which also rules out duplicated hashids
+        for (uint32_t i = 1; i < hashcount; i++) {
+            if (hashptr[i - 1].hash >= hashptr[i].hash) {
+                m_sorted.Free();
+                m_perfecthash.Free();
+                XPACK_ERROR(xpack::Error::Format);
+                return false;
+            }
+        }
+        // Lookup in place by binary search, no index building
+        if (readonly) {
+            return this->ReadFingerprints();
+        }
+    }
+    
+    if (!this->BuildHashMap()) {
         XPACK_ERROR(xpack::Error::Format);
         return false;
     }
+    return true;
+}
+
+bool HashSegment::ReadFingerprints()
+{
+    Context *ctx = m_context;
+    if (ctx->GetFingerprintSize() == 0) {
+        return true;
+    }
     
-    for (int i = 0; i < hashcount; i++) {
-        MetaHash *metahash = (MetaHash *)m_hashpool.Alloc();
-        memcpy(metahash, hashptr++, sizeof(MetaHash));
-        if (!m_hashmap.Set(metahash->hash, metahash)) {
-            goto error;
+    MetaHeader *metaheader = ctx->header->Metadata();
+    uint64_t offset = ctx->offset + metaheader->hash_offset + metaheader->hash_count * ctx->GetHashRecordSize();
+    
+    m_fingerprints.Alloc(metaheader->hash_count * sizeof(uint64_t));
+    if (!ctx->stream->GetFingerprints((uint64_t *)m_fingerprints.GetBytes(), offset, metaheader->hash_count)) {
+        m_fingerprints.Free();
+        m_sorted.Free();
+        return false;
+    }
+    
+    // Decrypt fingerprints data
+    ctx->crypto->CryptoNoCopy((unsigned char*)m_fingerprints.GetBytes(), (int)m_fingerprints.GetSize());
+    return true;
+}
+
+bool HashSegment::WriteFingerprints(const std::vector<MetaHash*> &metahashs)
+{
+    Context *ctx = m_context;
+    MetaHeader *metaheader = ctx->header->Metadata();
+    uint64_t offset = ctx->offset + metaheader->hash_offset + metaheader->hash_count * ctx->GetHashRecordSize();
+    
+    torch::Data wb(metahashs.size() * sizeof(uint64_t));
+    uint64_t *fingerprints = (uint64_t *)wb.GetBytes();
+    for (size_t i = 0; i < metahashs.size(); i++) {
+        fingerprints[i] = this->GetFingerprint(metahashs[i]);
+    }
+    
+    // Encrypt fingerprints data
+    ctx->crypto->CryptoNoCopy((unsigned char*)wb.GetBytes(), (int)wb.GetSize());
+    return ctx->stream->PutFingerprints(fingerprints, offset, metahashs.size());
+}
+
+uint64_t HashSegment::GetFingerprint(MetaHash *metahash)
+{
+    // Conflict items are never the end of a lookup
+    if (metahash->flags & int(HashFlags::Conflict)) {
+        return 0;
+    }
+    return FingerprintString(m_context->name->GetName(metahash));
+}
+
+bool HashSegment::HasFingerprints()
+{
+    return m_fingerprints.GetSize() > 0;
+}
+
+bool HashSegment::ReadPerfectHash()
+{
+    Context *ctx = m_context;
+    size_t size = ctx->GetPerfectHashSize();
+    if (size == 0) {
+        return true;
+    }
+    
+    MetaHeader *metaheader = ctx->header->Metadata();
+    uint64_t offset = ctx->offset + metaheader->hash_offset + metaheader->hash_count * (ctx->GetHashRecordSize() + ctx->GetFingerprintSize());
+    
+    m_perfecthash.Alloc(size);
+    if (!ctx->stream->GetPerfectHash((uint32_t *)m_perfecthash.GetBytes(), offset, size / sizeof(uint32_t))) {
+        m_perfecthash.Free();
+        return false;
+    }
+    
+    // Decrypt perfect hash data
+    ctx->crypto->CryptoNoCopy((unsigned char*)m_perfecthash.GetBytes(), (int)m_perfecthash.GetSize());
+    
+    if (!PerfectHash::IsValid(m_perfecthash, metaheader->hash_count)) {
+        m_perfecthash.Free();
+        XPACK_ERROR(xpack::Error::Format);
+        return false;
+    }
+    return true;
+}
+
+bool HashSegment::WritePerfectHash()
+{
+    Context *ctx = m_context;
+    assert(m_perfecthash.GetSize() == ctx->GetPerfectHashSize());
+    
+    MetaHeader *metaheader = ctx->header->Metadata();
+    uint64_t offset = ctx->offset + metaheader->hash_offset + metaheader->hash_count * (ctx->GetHashRecordSize() + ctx->GetFingerprintSize());
+    
+    torch::Data wb = m_perfecthash;
+    
+    // Encrypt perfect hash data
+    ctx->crypto->CryptoNoCopy((unsigned char*)wb.GetBytes(), (int)wb.GetSize());
+    return ctx->stream->PutPerfectHash((uint32_t *)wb.GetBytes(), offset, wb.GetSize() / sizeof(uint32_t));
+}
+
+void HashSegment::DropPerfectHash()
+{
+    m_perfecthash.Free();
+    m_context->header->Metadata()->features &= ~uint32_t(HeaderFeatures::PerfectHash);
+}
+
+bool HashSegment::Seal()
+{
+    Context *ctx = m_context;
+    if (ctx->GetFingerprintSize() == 0) {
+        XPACK_ERROR(xpack::Error::NotSupport);
+        return false;
+    }
+    
+    // Slots point at positions of the sorted segment, as it is written
+    std::vector<MetaHash*> metahashs;
+    this->GetSortedMetaHashs(metahashs);
+    if (metahashs.empty()) {
+        XPACK_ERROR(xpack::Error::NotExists);
+        return false;
+    }
+    
+    std::vector<uint64_t> fingerprints(metahashs.size());
+    for (size_t i = 0; i < metahashs.size(); i++) {
+        fingerprints[i] = this->GetFingerprint(metahashs[i]);
+        // 0 marks conflict items, such a name can not be sealed
+        if (fingerprints[i] == 0 && !(metahashs[i]->flags & int(HashFlags::Conflict))) {
+            XPACK_ERROR(xpack::Error::NotSupport);
+            return false;
         }
     }
+    
+    torch::Data perfecthash;
+    if (!PerfectHash::Build(fingerprints, perfecthash)) {
+        return false;
+    }
+    m_perfecthash.CopyFrom(perfecthash);
+    ctx->header->Metadata()->features |= uint32_t(HeaderFeatures::PerfectHash);
+    ctx->header->UpdateMetadata();
     return true;
+}
+
+bool HashSegment::IsSealed()
+{
+    return m_perfecthash.GetSize() > 0;
+}
+
+void HashSegment::GetSortedMetaHashs(std::vector<MetaHash*> &outmetahashs)
+{
+    outmetahashs.clear();
+    outmetahashs.reserve(m_context->header->Metadata()->hash_count);
+    this->ForeachMetaHash([&outmetahashs](MetaHash *metahash) {
+        outmetahashs.push_back(metahash);
+        return true;
+    });
     
-error:
-    m_hashmap.Clear();
-    XPACK_ERROR(xpack::Error::Format);
-    return false;
+    // Sorted by hashid, so readonly opens can search it in place
+    if (!m_context->IsVersion32()) {
+        std::sort(outmetahashs.begin(), outmetahashs.end(), [](const MetaHash *l, const MetaHash *r) {
+            return l->hash < r->hash;
+        });
+    }
 }
 
 bool HashSegment::WriteToStream()
@@ -79,24 +302,47 @@ bool HashSegment::WriteToStream()
     Context *ctx = m_context;
     ctx->header->UpdateMetadata();
     
-    uint32_t hashoffset = ctx->offset + ctx->header->Metadata()->hash_offset;
+    uint64_t hashoffset = ctx->offset + ctx->header->Metadata()->hash_offset;
+    size_t   recordsize = ctx->GetHashRecordSize();
 
+    std::vector<MetaHash*> metahashs;
+    this->GetSortedMetaHashs(metahashs);
+    
     torch::Data wb;
-    wb.Reserve(m_hashmap.Size() * sizeof(MetaHash));
+    wb.Reserve(metahashs.size() * recordsize);
     
-    for (auto it : m_hashmap.GetIterator()) {
-        MetaHash *metahash = it.second;
+    for (auto metahash : metahashs) {
         assert(!(metahash->flags & int(HashFlags::Unused)));
-        wb.Append(metahash, sizeof(MetaHash));
+        if (ctx->IsVersion32()) {
+            MetaHash32 metahash32;
+            if (!NarrowHash(&metahash32, metahash)) {
+                XPACK_ERROR(xpack::Error::Format); // Too large for 0x0009 format
+                return false;
+            }
+            wb.Append(&metahash32, sizeof(MetaHash32));
+        }
+        else {
+            MetaHash stored = *metahash;
+            stored.name_offset = ctx->name->GetStoredOffset(metahash);
+            wb.Append(&stored, sizeof(MetaHash));
+        }
     }
     
     // Encrypt hashs data
     ctx->crypto->CryptoNoCopy((unsigned char*)wb.GetBytes(), (int)wb.GetSize());
 
-    if (!ctx->stream->PutHashs(wb.GetBytes(), hashoffset, wb.GetSize() / sizeof(MetaHash))) {
+    size_t count = wb.GetSize() / recordsize;
+    bool ok = ctx->IsVersion32() ? ctx->stream->PutHashs32(wb.GetBytes(), hashoffset, count) : ctx->stream->PutHashs(wb.GetBytes(), hashoffset, count);
+    if (!ok) {
         return false;
     }
     
+    if (ctx->GetFingerprintSize() > 0 && !this->WriteFingerprints(metahashs)) {
+        return false;
+    }
+    if (ctx->GetPerfectHashSize() > 0 && !this->WritePerfectHash()) {
+        return false;
+    }
     return true;
 }
 
@@ -108,7 +354,7 @@ bool HashSegment::IsValid()
     if (metaheader->hash_offset <= 0 || metaheader->hash_count <= 0) {
         return false;
     }
-    if (metaheader->hash_offset < sizeof(MetaSignature) + sizeof(MetaHeader)) {
+    if (metaheader->hash_offset < sizeof(MetaSignature) + ctx->GetHeaderSize()) {
         return false;
     }
 
@@ -118,7 +364,89 @@ bool HashSegment::IsValid()
 MetaHash* HashSegment::QueryByName(const std::string &name)
 {
     Context  *ctx = m_context;
-    uint32_t hashid = ctx->HashMaker(name, 0);
+    
+    // Sealed: one slot, one fingerprint compare
+    if (this->IsSealed() && this->HasFingerprints()) {
+        uint64_t fingerprint = FingerprintString(name);
+        return this->SealedQuery(fingerprint, PerfectHash::Lookup(m_perfecthash, fingerprint));
+    }
+    return this->InternalQuery(name, ctx->HashMaker(name, 0));
+}
+
+size_t HashSegment::QueryByNames(const std::vector<std::string> &names, std::vector<MetaHash*> &outmetahashs)
+{
+    Context *ctx = m_context;
+    bool sealed = this->IsSealed() && this->HasFingerprints();
+    bool table  = m_sorted.GetSize() == 0;
+    
+    uint64_t keys[XPACK_HASH_LOOKAHEAD];
+    const uint32_t *indexptrs[XPACK_HASH_LOOKAHEAD];
+    
+    size_t found = 0;
+    outmetahashs.assign(names.size(), nullptr);
+    for (size_t begin = 0; begin < names.size(); begin += XPACK_HASH_LOOKAHEAD) {
+        size_t count = std::min(names.size() - begin, (size_t)XPACK_HASH_LOOKAHEAD);
+        
+        // Hash the whole group first and start loading what each lookup touches first
+        for (size_t i = 0; i < count; i++) {
+            if (sealed) {
+                keys[i] = FingerprintString(names[begin + i]);
+                const uint32_t *pilot = PerfectHash::GetPilotPtr(m_perfecthash, keys[i]);
+                if (pilot) {
+                    XPACK_PREFETCH(pilot);
+                }
+            }
+            else {
+                keys[i] = ctx->HashMaker(names[begin + i], 0);
+                if (table) {
+                    m_hashmap.Prefetch((uint32_t)keys[i]);
+                }
+            }
+        }
+        
+        if (sealed) {
+            // Second dependent load of the group, the slots
+            for (size_t i = 0; i < count; i++) {
+                const uint32_t *pilot = PerfectHash::GetPilotPtr(m_perfecthash, keys[i]);
+                indexptrs[i] = pilot ? PerfectHash::GetIndexPtr(m_perfecthash, keys[i], *pilot) : nullptr;
+                if (indexptrs[i]) {
+                    XPACK_PREFETCH(indexptrs[i]);
+                }
+            }
+        }
+        
+        for (size_t i = 0; i < count; i++) {
+            MetaHash *metahash = nullptr;
+            if (sealed) {
+                metahash = this->SealedQuery(keys[i], indexptrs[i] ? *indexptrs[i] : UINT32_MAX);
+            }
+            else {
+                metahash = this->InternalQuery(names[begin + i], (uint32_t)keys[i]);
+            }
+            outmetahashs[begin + i] = metahash;
+            found += metahash ? 1 : 0;
+        }
+    }
+    
+    if (found < names.size()) {
+        XPACK_ERROR(xpack::Error::NotExists);
+    }
+    return found;
+}
+
+MetaHash* HashSegment::SealedQuery(uint64_t fingerprint, uint32_t index)
+{
+    uint64_t *fingerprints = (uint64_t *)m_fingerprints.GetBytes();
+    if (index == UINT32_MAX || fingerprints[index] != fingerprint) {
+        XPACK_ERROR(xpack::Error::NotExists);
+        return nullptr;
+    }
+    return (MetaHash *)m_sorted.GetBytes() + index;
+}
+
+MetaHash* HashSegment::InternalQuery(const std::string &name, uint32_t hashid)
+{
+    Context  *ctx = m_context;
     MetaHash *metahash = this->GetById(hashid);
     
     // Name not exists
@@ -134,6 +462,16 @@ MetaHash* HashSegment::QueryByName(const std::string &name)
         metahash = this->GetById(hashid);
     }
 
+    // Check fingerprint instead of storage name, names are not loaded
+    if (metahash && this->HasFingerprints()) {
+        uint64_t *fingerprints = (uint64_t *)m_fingerprints.GetBytes();
+        if (fingerprints[metahash - (MetaHash *)m_sorted.GetBytes()] != FingerprintString(name)) {
+            XPACK_ERROR(xpack::Error::NotExists);
+            return nullptr;
+        }
+        return metahash;
+    }
+
     // Check storage name
     if (!metahash || name != ctx->name->GetName(metahash)) {
         XPACK_ERROR(xpack::Error::NotExists);
@@ -144,9 +482,51 @@ MetaHash* HashSegment::QueryByName(const std::string &name)
 
 MetaHash* HashSegment::GetById(const uint32_t hashid)
 {
+    if (m_sorted.GetSize() > 0) {
+        return this->SortedGetById(hashid);
+    }
     return m_hashmap.Get(hashid);
 }
 
+MetaHash* HashSegment::SortedGetById(const uint32_t hashid)
+{
+    MetaHash *begin = (MetaHash *)m_sorted.GetBytes();
+    MetaHash *end   = begin + m_sorted.GetSize() / sizeof(MetaHash);
+    MetaHash *found = std::lower_bound(begin, end, hashid, [](const MetaHash &metahash, uint32_t hashid) {
+        return metahash.hash < hashid;
+    });
+    if (found == end || found->hash != hashid) {
+        return nullptr;
+    }
+    return found;
+}
+
+bool HashSegment::BuildHashMap()
+{
+    if (m_sorted.GetSize() == 0) {
+        return true;
+    }
+    
+    MetaHash *hashptr = (MetaHash *)m_sorted.GetBytes();
+    size_t hashcount = m_sorted.GetSize() / sizeof(MetaHash);
+    
+    m_hashmap.Clear();
+    m_hashmap.Reserve(hashcount);
+    for (size_t i = 0; i < hashcount; i++) {
+        MetaHash *metahash = m_hashmap.Set(hashptr->hash);
+        if (!metahash) {
+            m_hashmap.Clear();
+            m_sorted.Free();
+            m_fingerprints.Free();
+            return false;
+        }
+        memcpy(metahash, hashptr++, sizeof(MetaHash));
+    }
+    m_sorted.Free();
+    m_fingerprints.Free();
+    return true;
+}
+
 bool HashSegment::IsHashExist(const std::string &name)
 {
     return this->QueryByName(name) != nullptr;
@@ -154,6 +534,8 @@ bool HashSegment::IsHashExist(const std::string &name)
 
 MetaHash* HashSegment::AddNew(const std::string &name)
 {
+    this->BuildHashMap();
+    this->DropPerfectHash();
     if (this->IsHashExist(name)) {
         XPACK_ERROR(xpack::Error::AlreadyExists);
         return nullptr;
@@ -208,16 +590,13 @@ MetaHash* HashSegment::InternalAddNew(const std::string &name, uint8_t seed)
     }
     
     // Add new metahash
-    MetaHash *metahashnew = (MetaHash*)m_hashpool.Alloc();
-    memset(metahashnew, 0, sizeof(MetaHash));
-
-    if (!m_hashmap.Set(hashid, metahashnew)) {
-        m_hashpool.Free(metahashnew);
+    MetaHash *metahashnew = m_hashmap.Set(hashid);
+    if (!metahashnew) {
         XPACK_ERROR(xpack::Error::AlreadyExists);
         return nullptr;
     }
     
-    metahashnew->hash = hashid;
+
     metahashnew->block_index = -1;
     ctx->header->Metadata()->hash_count++;
     ctx->header->UpdateMetadata();
@@ -227,6 +606,8 @@ MetaHash* HashSegment::InternalAddNew(const std::string &name, uint8_t seed)
 
 void HashSegment::RemoveByName(const std::string &name)
 {
+    this->BuildHashMap();
+    this->DropPerfectHash();
     Context *ctx = m_context;
 
     MetaHash *metahash = this->GetById(ctx->HashMaker(name, 0));
@@ -246,13 +627,8 @@ void HashSegment::RemoveByName(const std::string &name)
     
     for (auto metahash : removehashs) {
         if (metahash->conflict_refc <= 1) {
+            // Storage is marked unused and reused by the table
             m_hashmap.Remove(metahash->hash);
-            
-            memset(metahash, 0, sizeof(MetaHash));
-            metahash->block_index = -1;
-            metahash->flags |= int(HashFlags::Unused);
-            
-            m_hashpool.Free(metahash);
             m_context->header->Metadata()->hash_count--;
         }
         else {
@@ -266,8 +642,10 @@ void HashSegment::Clear()
 {
     m_slatcursor = 0;
     
-    m_hashpool.Clear();
     m_hashmap.Clear();
+    m_sorted.Free();
+    m_fingerprints.Free();
+    this->DropPerfectHash();
 
     // Update header data
     m_context->header->Metadata()->hash_count = 0;
@@ -277,9 +655,30 @@ void HashSegment::Clear()
 
 HashSegment::MetaHashMap* HashSegment::GetMetaHashMap()
 {
+    this->BuildHashMap();
     return &m_hashmap;
 }
 
+bool HashSegment::ForeachMetaHash(std::function<bool(MetaHash *metahash)> callback)
+{
+    if (m_sorted.GetSize() > 0) {
+        MetaHash *hashptr = (MetaHash *)m_sorted.GetBytes();
+        size_t hashcount = m_sorted.GetSize() / sizeof(MetaHash);
+        for (size_t i = 0; i < hashcount; i++) {
+            if (!callback(hashptr + i)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    for (auto x : m_hashmap.GetIterator()) {
+        if (!callback(x.second)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 std::string HashSegment::DumpHash()
 {
     return std::move(DumpUtils::DumpHashs(m_context));
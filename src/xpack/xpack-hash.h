@@ -10,7 +10,10 @@
 #define __XPACK__HASH__
 
 #include <stdio.h>
+#include <functional>
+#include <vector>
 #include "xpack-def.h"
+#include "xpack-hashtable.h"
 #include "torch/torch.h"
 
 namespace xpack {
@@ -18,26 +21,30 @@ namespace xpack {
 class Context;
 class HashSegment {
 public:
-    typedef torch::collection::HashMap<uint32_t, MetaHash*> MetaHashMap;
-    typedef torch::FixedMemoryPool<sizeof(MetaHash)> MetaHashPool;
+    typedef MetaHashTable MetaHashMap;
 
     HashSegment(Context *ctx);
     ~HashSegment();
 
     /*
      * 读取区域数据
+     * 参数：
+     *  - readonly: 只读打开时，若Hash区段已按hashid排序(HeaderFeatures::SortedHash)，则直接在解密后的数据上二分查找，不建立索引表
      * 说明：
      *  - 根据MetaHeader.hash_offset确定位置
      *  - 若不存在或者格式错误，则返回false
      *  - 读取完毕后，会建立索引表以便于查询
+     *  - 使用排序数据时，修改或遍历前会先建立索引表(此后之前查询到的MetaHash指针失效)
      */
-    bool ReadFromStream();
+    bool ReadFromStream(bool readonly = false);
     
     /*
      * 将区域数据写入
      * 说明：
      *  - 根据MetaHeader.hash_offset确定位置
      *  - 不会写入被标记为unused的项
+     *  - 0x000A格式按hashid排序写入(HeaderFeatures::SortedHash)
+     *  - 已封存时在指纹之后写入完美哈希(HeaderFeatures::PerfectHash)
      */
     bool WriteToStream();
     
@@ -54,6 +61,18 @@ public:
      */
     MetaHash* QueryByName(const std::string &name);
     
+    /*
+     * 批量查找names对应的MetaHash
+     * 参数：
+     *  - outmetahashs: 与names一一对应，不存在的为null
+     * 返回值：
+     *  - 找到的数量，有不存在的项时错误代码为Error::NotExists
+     * 说明：
+     *  - 按组(XPACK_HASH_LOOKAHEAD)先计算整组的hashid或指纹并预取索引，再依次查找，
+     *    使各个查询的内存访问相互重叠，结果与逐个调用QueryByName一致
+     */
+    size_t QueryByNames(const std::vector<std::string> &names, std::vector<MetaHash*> &outmetahashs);
+    
     /*
      * 根据hashid获得对应的MetaHash(直接返回hashmap中的存储项)
      * 注意：
@@ -61,6 +80,34 @@ public:
      */
     MetaHash* GetById(const uint32_t hashid);
 
+    /*
+     * 是否使用名字指纹校验查询结果(只读打开且包含HeaderFeatures::NameFingerprint)
+     * 说明：
+     *  - 此时查询不需要Name区段，Name区段可以延迟读取
+     */
+    bool HasFingerprints();
+    
+    /*
+     * 封存：在当前所有名字的指纹上构建完美哈希(HeaderFeatures::PerfectHash)
+     * 说明：
+     *  - 仅0x000A格式支持，写入时存储在指纹区段之后
+     *  - 只读打开封存的包时，查询只计算一次槽位并比较一次指纹，不再计算hashid，也不经过冲突链
+     *  - 之后任何增删都会解除封存(清除特性位)，需要重新封存
+     * 返回值：
+     *  - 存在重复的名字指纹时无法封存，返回false(Error::NotSupport)
+     */
+    bool Seal();
+    
+    /*
+     * 是否已封存(读取到或构建了完美哈希)
+     */
+    bool IsSealed();
+    
+    /*
+     * 解除封存(清除完美哈希和特性位)
+     */
+    void DropPerfectHash();
+    
     /*
      * 是否存在指定名称的项
      */
@@ -91,10 +138,17 @@ public:
     void Clear();
     
     /*
-     * 获取存储MetaHash的Map，请不要修改
+     * 获取存储MetaHash的索引表，请不要修改
      */
     MetaHashMap* GetMetaHashMap();
     
+    /*
+     * 遍历所有的MetaHash(包括冲突中转项)，callback返回false停止遍历
+     * 说明：
+     *  - 使用排序数据时直接遍历，不会建立索引表
+     */
+    bool ForeachMetaHash(std::function<bool(MetaHash *metahash)> callback);
+    
     /*
      * 内部调试接口
      */
@@ -104,14 +158,26 @@ public:
 
 private:
     MetaHash* InternalAddNew(const std::string &name, uint8_t seed = 0);
+    MetaHash* InternalQuery(const std::string &name, uint32_t hashid);
+    MetaHash* SealedQuery(uint64_t fingerprint, uint32_t index);
+    MetaHash* SortedGetById(const uint32_t hashid);
+    bool      BuildHashMap();
+    bool      ReadFingerprints();
+    bool      WriteFingerprints(const std::vector<MetaHash*> &metahashs);
+    bool      ReadPerfectHash();
+    bool      WritePerfectHash();
+    void      GetSortedMetaHashs(std::vector<MetaHash*> &outmetahashs);
+    uint64_t  GetFingerprint(MetaHash *metahash);
 
 private:
     
     Context     *m_context;
     uint8_t      m_slatcursor;
     
-    MetaHashMap   m_hashmap;  // Only used hash entries(hashmap<hashid, hashptr>)
-    MetaHashPool  m_hashpool; // All hash struct entries
+    MetaHashMap   m_hashmap;  // Only used hash entries(hashid -> hashptr), owns the MetaHash storage
+    torch::Data   m_sorted;   // Decrypted sorted hash segment, used in place before m_hashmap is built
+    torch::Data   m_fingerprints; // Name fingerprints parallel to m_sorted, only kept with it
+    torch::Data   m_perfecthash;  // Perfect hash over fingerprints (slot -> sorted index), dropped on any change
 };
     
 }
@@ -0,0 +1,262 @@
+//
+//  xpack
+//
+//  Created by Luwei.
+//  Copyright (c) 2016 Luwei. All rights reserved.
+//  Github: https://github.com/Luweimy
+//
+
+#include "xpack-hashtable.h"
+#include "xpack-def.h"
+#include "torch/torch.h"
+#include <string.h>
+#include <algorithm>
+
+#define XPACK_HASHTABLE_PAGESIZE 1024        /* records per page, power of 2 */
+#define XPACK_HASHTABLE_PAGESHIFT 10
+#define XPACK_HASHTABLE_MINSIZE  16
+#define XPACK_HASHTABLE_EMPTY    UINT32_MAX
+
+using namespace xpack;
+
+MetaHashTable::Iterator::Iterator(MetaHashTable *table, uint32_t index)
+:m_table(table)
+,m_index(index)
+{
+    this->SkipUnused();
+}
+
+MetaHashTable::ValueType MetaHashTable::Iterator::operator*() const
+{
+    MetaHash *metahash = m_table->Record(m_index);
+    return ValueType(metahash->hash, metahash);
+}
+
+MetaHashTable::Iterator& MetaHashTable::Iterator::operator++()
+{
+    m_index++;
+    this->SkipUnused();
+    return *this;
+}
+
+void MetaHashTable::Iterator::SkipUnused()
+{
+    while (m_index < m_table->m_recordcount && (m_table->Record(m_index)->flags & int(HashFlags::Unused))) {
+        m_index++;
+    }
+}
+
+MetaHashTable::MetaHashTable()
+:m_slots(nullptr)
+,m_capacity(0)
+,m_size(0)
+,m_shift(64)
+,m_recordcount(0)
+{
+}
+
+MetaHashTable::~MetaHashTable()
+{
+    this->Clear();
+}
+
+MetaHash* MetaHashTable::Set(uint32_t hashid)
+{
+    if (this->FindSlot(hashid) != m_capacity) {
+        return nullptr;
+    }
+    if ((m_size + 1) * 8 > m_capacity * 7) {
+        this->Rehash(std::max(m_capacity * 2, (size_t)XPACK_HASHTABLE_MINSIZE));
+    }
+
+    uint32_t index = this->AllocRecord();
+    if (index == XPACK_HASHTABLE_EMPTY) {
+        return nullptr;
+    }
+    MetaHash *metahash = this->Record(index);
+    memset(metahash, 0, sizeof(MetaHash));
+    metahash->hash = hashid;
+
+    this->InsertSlot(hashid, index);
+    m_size++;
+    return metahash;
+}
+
+MetaHash* MetaHashTable::Get(uint32_t hashid)
+{
+    size_t pos = this->FindSlot(hashid);
+    if (pos == m_capacity) {
+        return nullptr;
+    }
+    return this->Record(m_slots[pos].index);
+}
+
+void MetaHashTable::Prefetch(uint32_t hashid)
+{
+    if (m_capacity > 0) {
+        XPACK_PREFETCH(m_slots + this->HomeOf(hashid));
+    }
+}
+
+bool MetaHashTable::Remove(uint32_t hashid)
+{
+    size_t pos = this->FindSlot(hashid);
+    if (pos == m_capacity) {
+        return false;
+    }
+
+    uint32_t index = m_slots[pos].index;
+    MetaHash *metahash = this->Record(index);
+    memset(metahash, 0, sizeof(MetaHash));
+    metahash->block_index = -1;
+    metahash->flags |= int(HashFlags::Unused);
+    m_freelist.push_back(index);
+
+    // Backward shift deletion, keeps probe sequences without tombstones
+    size_t mask = m_capacity - 1;
+    size_t next = (pos + 1) & mask;
+    while (m_slots[next].index != XPACK_HASHTABLE_EMPTY && this->HomeOf(m_slots[next].hashid) != next) {
+        m_slots[pos] = m_slots[next];
+        pos  = next;
+        next = (next + 1) & mask;
+    }
+    m_slots[pos].index = XPACK_HASHTABLE_EMPTY;
+    m_size--;
+    return true;
+}
+
+void MetaHashTable::Reserve(size_t count)
+{
+    size_t capacity = XPACK_HASHTABLE_MINSIZE;
+    while (count * 8 > capacity * 7) {
+        capacity *= 2;
+    }
+    if (capacity > m_capacity) {
+        this->Rehash(capacity);
+    }
+}
+
+void MetaHashTable::Clear()
+{
+    for (MetaHash *page : m_pages) {
+        torch::HeapFree(page);
+    }
+    m_pages.clear();
+    m_freelist.clear();
+    m_recordcount = 0;
+
+    if (m_slots) {
+        torch::HeapFree(m_slots);
+    }
+    m_slots = nullptr;
+    m_capacity = 0;
+    m_size = 0;
+    m_shift = 64;
+}
+
+size_t MetaHashTable::Size()
+{
+    return m_size;
+}
+
+size_t MetaHashTable::GetMemoryUsage()
+{
+    return m_capacity * sizeof(Slot) + m_pages.size() * XPACK_HASHTABLE_PAGESIZE * sizeof(MetaHash) + m_freelist.capacity() * sizeof(uint32_t);
+}
+
+MetaHash* MetaHashTable::Record(uint32_t index)
+{
+    return m_pages[index >> XPACK_HASHTABLE_PAGESHIFT] + (index & (XPACK_HASHTABLE_PAGESIZE - 1));
+}
+
+uint32_t MetaHashTable::AllocRecord()
+{
+    if (!m_freelist.empty()) {
+        uint32_t index = m_freelist.back();
+        m_freelist.pop_back();
+        return index;
+    }
+    if (m_recordcount == m_pages.size() * XPACK_HASHTABLE_PAGESIZE) {
+        MetaHash *page = (MetaHash *)torch::HeapMalloc(XPACK_HASHTABLE_PAGESIZE * sizeof(MetaHash));
+        if (!page) {
+            return XPACK_HASHTABLE_EMPTY;
+        }
+        m_pages.push_back(page);
+    }
+    return m_recordcount++;
+}
+
+size_t MetaHashTable::HomeOf(uint32_t hashid)
+{
+    // Fibonacci hashing, spreads hashids made by weak HashMaker
+    return (size_t)(((uint64_t)hashid * 0x9E3779B97F4A7C15ull) >> m_shift);
+}
+
+size_t MetaHashTable::FindSlot(uint32_t hashid)
+{
+    if (m_size == 0) {
+        return m_capacity;
+    }
+    size_t mask = m_capacity - 1;
+    size_t pos  = this->HomeOf(hashid);
+    for (size_t distance = 0; ; distance++) {
+        const Slot &slot = m_slots[pos];
+        if (slot.index == XPACK_HASHTABLE_EMPTY) {
+            return m_capacity;
+        }
+        if (slot.hashid == hashid) {
+            return pos;
+        }
+        // Robin Hood invariant: the key would have displaced this slot
+        if (((pos - this->HomeOf(slot.hashid)) & mask) < distance) {
+            return m_capacity;
+        }
+        pos = (pos + 1) & mask;
+    }
+}
+
+void MetaHashTable::Rehash(size_t capacity)
+{
+    Slot  *slots    = m_slots;
+    size_t oldcapacity = m_capacity;
+
+    m_slots = (Slot *)torch::HeapMalloc(capacity * sizeof(Slot));
+    m_capacity = capacity;
+    m_shift = 64;
+    for (size_t c = capacity; c > 1; c >>= 1) {
+        m_shift--;
+    }
+    for (size_t i = 0; i < capacity; i++) {
+        m_slots[i].index = XPACK_HASHTABLE_EMPTY;
+    }
+
+    for (size_t i = 0; i < oldcapacity; i++) {
+        if (slots[i].index != XPACK_HASHTABLE_EMPTY) {
+            this->InsertSlot(slots[i].hashid, slots[i].index);
+        }
+    }
+    if (slots) {
+        torch::HeapFree(slots);
+    }
+}
+
+void MetaHashTable::InsertSlot(uint32_t hashid, uint32_t index)
+{
+    size_t mask = m_capacity - 1;
+    size_t pos  = this->HomeOf(hashid);
+    Slot   slot = { hashid, index };
+    for (size_t distance = 0; ; distance++) {
+        Slot &cur = m_slots[pos];
+        if (cur.index == XPACK_HASHTABLE_EMPTY) {
+            cur = slot;
+            return;
+        }
+        // Take the slot from the richer one and carry it forward
+        size_t curdistance = (pos - this->HomeOf(cur.hashid)) & mask;
+        if (curdistance < distance) {
+            std::swap(cur, slot);
+            distance = curdistance;
+        }
+        pos = (pos + 1) & mask;
+    }
+}
@@ -0,0 +1,124 @@
+//
+//  xpack
+//
+//  Created by Luwei.
+//  Copyright (c) 2016 Luwei. All rights reserved.
+//  Github: https://github.com/Luweimy
+//
+
+#ifndef __XPACK__HASHTABLE__
+#define __XPACK__HASHTABLE__
+
+#include <stdio.h>
+#include <vector>
+#include <utility>
+#include "xpack-def.h"
+
+namespace xpack {
+
+    /*
+     * MetaHash索引表(HashSegment内部使用)
+     * 说明：
+     *  - MetaHash按页(XPACK_HASHTABLE_PAGESIZE项)连续存储，指针在删除前一直有效
+     *  - 索引使用开放寻址(Robin Hood + 线性探测)，每个槽只保存hashid和存储序号(8字节)
+     *  - 删除时使用后移删除(backward shift)，不产生墓碑
+     *  - 遍历按存储顺序进行，已删除的项会被跳过
+     */
+    class MetaHashTable {
+    public:
+        typedef std::pair<uint32_t, MetaHash*> ValueType;
+
+        class Iterator {
+        public:
+            Iterator(MetaHashTable *table, uint32_t index);
+            ValueType  operator*() const;
+            Iterator&  operator++();
+            bool       operator!=(const Iterator &other) const { return m_index != other.m_index; }
+        private:
+            void SkipUnused();
+            MetaHashTable *m_table;
+            uint32_t       m_index;
+        };
+
+        class Range {
+        public:
+            Range(MetaHashTable *table) :m_table(table) {}
+            Iterator begin() { return Iterator(m_table, 0); }
+            Iterator end()   { return Iterator(m_table, m_table->m_recordcount); }
+        private:
+            MetaHashTable *m_table;
+        };
+
+        MetaHashTable();
+        ~MetaHashTable();
+        MetaHashTable(const MetaHashTable &) = delete;
+        MetaHashTable& operator=(const MetaHashTable &) = delete;
+
+        /*
+         * 新增hashid对应的MetaHash
+         * 说明：
+         *  - 返回的MetaHash已清零，hash字段被设置为hashid
+         *  - 若hashid已存在则返回null
+         */
+        MetaHash* Set(uint32_t hashid);
+
+        /*
+         * 获得hashid对应的MetaHash，不存在则返回null
+         */
+        MetaHash* Get(uint32_t hashid);
+
+        /*
+         * 预取hashid所在的索引槽，用于批量查询时在Get之前隐藏内存延迟
+         */
+        void Prefetch(uint32_t hashid);
+
+        /*
+         * 删除hashid对应的MetaHash，存储会被回收重用(会被标记为HashFlags::Unused)
+         */
+        bool Remove(uint32_t hashid);
+
+        /*
+         * 预留空间，用于批量插入前避免多次扩容
+         */
+        void Reserve(size_t count);
+
+        void   Clear();
+        size_t Size();
+
+        /*
+         * 获得索引和存储占用的内存大小(单位Byte)
+         */
+        size_t GetMemoryUsage();
+
+        /*
+         * 获得迭代器，元素为pair<hashid, MetaHash*>，遍历期间请不要增删
+         */
+        Range GetIterator() { return Range(this); }
+
+    private:
+        struct Slot {
+            uint32_t hashid;
+            uint32_t index;   /* record index, XPACK_HASHTABLE_EMPTY if empty */
+        };
+
+        MetaHash* Record(uint32_t index);
+        uint32_t  AllocRecord();
+        size_t    HomeOf(uint32_t hashid);
+        size_t    FindSlot(uint32_t hashid);
+        void      Rehash(size_t capacity);
+        void      InsertSlot(uint32_t hashid, uint32_t index);
+
+    private:
+        Slot                  *m_slots;
+        size_t                 m_capacity;    /* power of 2 */
+        size_t                 m_size;
+        int                    m_shift;
+
+        std::vector<MetaHash*> m_pages;
+        uint32_t               m_recordcount; /* records handed out, including freed */
+        std::vector<uint32_t>  m_freelist;
+    };
+
+}
+
+#endif /* __XPACK__HASHTABLE__ */
@@ -11,15 +11,48 @@
 #include "xpack-stream.h"
 #include "xpack-base.h"
 #include "xpack-name.h"
+#include "xpack-hash.h"
 #include "xpack-util.h"
 #include "xpack-def.h"
 #include "torch/torch.h"
+#include <string.h>
 
 using namespace xpack;
 
+static void WidenHeader(MetaHeader *dst, const MetaHeader32 *src)
+{
+    memset(dst, 0, sizeof(MetaHeader));
+    dst->archive_size   = src->archive_size;
+    dst->content_offset = src->content_offset;
+    dst->content_size   = src->content_size;
+    dst->block_offset   = src->block_offset;
+    dst->block_count    = src->block_count;
+    dst->hash_offset    = src->hash_offset;
+    dst->hash_count     = src->hash_count;
+    dst->name_size      = src->name_size;
+}
+
+static bool NarrowHeader(MetaHeader32 *dst, const MetaHeader *src)
+{
+    if (src->archive_size > UINT32_MAX || src->features != 0) {
+        return false; // All offsets and sizes are below archive size
+    }
+    memset(dst, 0, sizeof(MetaHeader32));
+    dst->archive_size   = (uint32_t)src->archive_size;
+    dst->content_offset = (uint32_t)src->content_offset;
+    dst->content_size   = (uint32_t)src->content_size;
+    dst->block_offset   = (uint32_t)src->block_offset;
+    dst->block_count    = src->block_count;
+    dst->hash_offset    = (uint32_t)src->hash_offset;
+    dst->hash_count     = src->hash_count;
+    dst->name_size      = src->name_size;
+    return true;
+}
+
 HeaderSegment::HeaderSegment(Context *ctx)
 :m_context(ctx)
 ,m_header({0})
+,m_features(xpack::DEFAULT_FEATURES)
 {
     assert(ctx);
     torch::HeapCounterRetain();
@@ -36,13 +69,41 @@ bool HeaderSegment::ReadFromStream()
     Context *ctx = m_context;
     this->UpdateMetadata();
 
-    size_t headeroffset = ctx->offset + sizeof(MetaSignature);
-    if (!ctx->stream->GetHeader(&m_header, headeroffset)) {
+    uint64_t headeroffset = ctx->offset + sizeof(MetaSignature);
+    if (ctx->IsVersion32()) {
+        MetaHeader32 header32;
+        if (!ctx->stream->GetHeader32(&header32, headeroffset)) {
+            return false;
+        }
+        ctx->crypto->CryptoNoCopy((unsigned char*)&header32, sizeof(MetaHeader32));
+        WidenHeader(&m_header, &header32);
+    }
+    else {
+        if (!ctx->stream->GetHeader(&m_header, headeroffset)) {
+            return false;
+        }
+        
+        // Decrypt header data
+        ctx->crypto->CryptoNoCopy((unsigned char*)&m_header, sizeof(MetaHeader));
+    }
+    
+    // Written by a newer version with features we don't know
+    if (m_header.features & ~uint32_t(xpack::FEATURES)) {
+        XPACK_ERROR(xpack::Error::Version);
         return false;
     }
     
-    // Decrypt header data
-    ctx->crypto->CryptoNoCopy((unsigned char*)&m_header, sizeof(MetaHeader)); 
+    // Perfect hash slots are verified by name fingerprints
+    if ((m_header.features & uint32_t(HeaderFeatures::PerfectHash)) && !(m_header.features & uint32_t(HeaderFeatures::NameFingerprint))) {
+        XPACK_ERROR(xpack::Error::Format);
+        return false;
+    }
+    
+    // Front coded names are stored in name order
+    if ((m_header.features & uint32_t(HeaderFeatures::FrontCodedNames)) && !(m_header.features & uint32_t(HeaderFeatures::SortedNames))) {
+        XPACK_ERROR(xpack::Error::Format);
+        return false;
+    }
     
     if (!this->IsValid()) {
         XPACK_ERROR(xpack::Error::Format);
@@ -55,12 +116,23 @@ bool HeaderSegment::WriteToStream()
 {
     this->UpdateMetadata();
     Context *ctx = m_context;
+    uint64_t headeroffset = ctx->offset + sizeof(MetaSignature);
+    
+    if (ctx->IsVersion32()) {
+        MetaHeader32 header32;
+        if (!NarrowHeader(&header32, &m_header)) {
+            XPACK_ERROR(xpack::Error::Format); // Too large for 0x0009 format
+            return false;
+        }
+        ctx->crypto->CryptoNoCopy((unsigned char*)&header32, sizeof(MetaHeader32));
+        return ctx->stream->PutHeader32(&header32, headeroffset);
+    }
+    
     MetaHeader encryptbuffer = m_header;
 
     // Encrypt header data
     ctx->crypto->CryptoNoCopy((unsigned char*)&encryptbuffer, sizeof(MetaHeader)); 
     
-    size_t headeroffset = ctx->offset + sizeof(MetaSignature);
     if (!ctx->stream->PutHeader(&encryptbuffer, headeroffset)) { 
         return false;
     }
@@ -69,16 +141,18 @@ bool HeaderSegment::WriteToStream()
 
 bool HeaderSegment::IsValid()
 {
+    Context *ctx = m_context;
     MetaHeader &metaheader = m_header;
-    return  (metaheader.archive_size >= sizeof(MetaSignature) + sizeof(MetaHeader)) &&
+    return  (metaheader.archive_size >= sizeof(MetaSignature) + ctx->GetHeaderSize()) &&
             (metaheader.block_offset >= metaheader.content_offset) &&
             (metaheader.hash_offset >= metaheader.block_offset) &&
-            (metaheader.block_count * sizeof(MetaBlock) + metaheader.hash_count * sizeof(MetaHash) + metaheader.content_size + metaheader.name_size) <= metaheader.archive_size;
+            (metaheader.block_count * ctx->GetBlockRecordSize() + ctx->GetHashSegmentSize() + metaheader.content_size + metaheader.name_size) <= metaheader.archive_size;
 }
 
 HeaderSegment* HeaderSegment::Initialize()
 {
-    m_header.archive_size = sizeof(MetaSignature) + sizeof(MetaHeader);
+    m_header = {0};
+    m_header.archive_size = sizeof(MetaSignature) + m_context->GetHeaderSize();
     m_header.content_offset = m_header.archive_size;
     m_header.content_size = 0;
     m_header.block_offset = m_header.archive_size;
@@ -86,19 +160,47 @@ HeaderSegment* HeaderSegment::Initialize()
     m_header.hash_offset = m_header.archive_size;
     m_header.hash_count = 0;
     m_header.name_size = 0;
+    m_header.features = 0;
+    return this->ApplyFeatures();
+}
+
+// Features chosen by SetFeatures, the others (PerfectHash) are kept as they are
+static const uint32_t s_optionalFeatures = uint32_t(HeaderFeatures::SortedHash) | uint32_t(HeaderFeatures::NameFingerprint) | uint32_t(HeaderFeatures::SortedNames) | uint32_t(HeaderFeatures::FrontCodedNames);
+
+void HeaderSegment::SetFeatures(uint32_t features)
+{
+    features &= s_optionalFeatures;
+    if (features & uint32_t(HeaderFeatures::FrontCodedNames)) {
+        features |= uint32_t(HeaderFeatures::SortedNames);
+    }
+    m_features = features;
+}
+
+HeaderSegment* HeaderSegment::ApplyFeatures()
+{
+    // The 0x0009 format has no features
+    if (m_context->IsVersion32()) {
+        return this;
+    }
+    // Perfect hash is set by sealing, its slots are verified by fingerprints
+    if (!(m_features & uint32_t(HeaderFeatures::NameFingerprint)) && (m_header.features & uint32_t(HeaderFeatures::PerfectHash))) {
+        m_context->hash->DropPerfectHash();
+    }
+    m_header.features = (m_header.features & ~s_optionalFeatures) | m_features;
     return this;
 }
 
 HeaderSegment* HeaderSegment::UpdateMetadata()
 {
-    m_header.name_size    = m_context->name->Size();
+    Context *ctx = m_context;
+    m_header.name_size    = ctx->name->Size();
     
-    uint32_t blocksize    = m_header.block_count * sizeof(MetaBlock);
-    uint32_t hashsize     = m_header.hash_count * sizeof(MetaHash);
+    uint64_t blocksize    = m_header.block_count * ctx->GetBlockRecordSize();
+    uint64_t hashsize     = ctx->GetHashSegmentSize();
 
     m_header.block_offset = m_header.content_offset + m_header.content_size;
     m_header.hash_offset  = m_header.block_offset + blocksize;
-    m_header.archive_size = sizeof(MetaSignature) + sizeof(MetaHeader) + m_header.content_size + blocksize + hashsize + m_header.name_size;
+    m_header.archive_size = sizeof(MetaSignature) + ctx->GetHeaderSize() + m_header.content_size + blocksize + hashsize + m_header.name_size;
     
     return this;
 }
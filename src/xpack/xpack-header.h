@@ -44,6 +44,24 @@ public:
      */
     HeaderSegment* Initialize();
     
+    /*
+     * 设置写入时使用的特性位，默认xpack::DEFAULT_FEATURES
+     * 参数：
+     *  - features: HeaderFeatures的组合，可选SortedHash, NameFingerprint, SortedNames, FrontCodedNames，其余位被忽略
+     * 说明：
+     *  - FrontCodedNames需要SortedNames，会自动加上
+     *  - 在下次ApplyFeatures时生效
+     */
+    void SetFeatures(uint32_t features);
+    
+    /*
+     * 将SetFeatures设置的特性位写入MetaHeader，0x0009格式没有特性位
+     * 说明：
+     *  - 特性位会影响区段的位置，需要在写入前(Package::Flush)设置，读取期间不可调用
+     *  - 已封存的包(PerfectHash)在保留NameFingerprint时保持封存，否则解除封存
+     */
+    HeaderSegment* ApplyFeatures();
+    
     /*
      * 更新Header区段元信息
      * 说明：每次使用其他(hash,block,name,content)修改完数据后，都会自动更新，读写时请视情况使用
@@ -64,6 +82,7 @@ private:
     
     MetaHeader m_header;
     Context   *m_context;
+    uint32_t   m_features;
 };
     
 }
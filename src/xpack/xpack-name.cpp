@@ -14,11 +14,67 @@
 #include "xpack-base.h"
 #include "xpack-def.h"
 #include <assert.h>
+#include <string.h>
+#include <algorithm>
 
 using namespace xpack;
 
+#define XPACK_NAME_BUCKETSIZE 16        /* names per front coded bucket, the first one is stored in full */
+
+// Byte-wise order, same as std::string::compare
+static int CompareName(const char *l, size_t lsize, const char *r, size_t rsize)
+{
+    int ret = memcmp(l, r, std::min(lsize, rsize));
+    if (ret != 0) {
+        return ret;
+    }
+    return lsize < rsize ? -1 : (lsize > rsize ? 1 : 0);
+}
+
+static void PutUInt32(torch::Data &data, uint32_t value)
+{
+    unsigned char bytes[4] = { (unsigned char)value, (unsigned char)(value >> 8), (unsigned char)(value >> 16), (unsigned char)(value >> 24) };
+    data.Append(bytes, sizeof(bytes));
+}
+
+static uint32_t GetUInt32(const unsigned char *ptr)
+{
+    return (uint32_t)ptr[0] | ((uint32_t)ptr[1] << 8) | ((uint32_t)ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+static void PutVarint(torch::Data &data, uint32_t value)
+{
+    unsigned char bytes[5];
+    size_t size = 0;
+    while (value >= 0x80) {
+        bytes[size++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    bytes[size++] = (unsigned char)value;
+    data.Append(bytes, size);
+}
+
+static bool GetVarint(const unsigned char *&ptr, const unsigned char *end, uint32_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 35 && ptr < end; shift += 7) {
+        unsigned char byte = *ptr++;
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 NameSegment::NameSegment(Context *ctx)
 :m_context(ctx)
+,m_codedcount(0)
+,m_bucketsize(0)
+,m_keepcoded(false)
+,m_deferred(false)
+,m_sortedlayout(false)
+,m_indexready(false)
 {
     assert(ctx);
     torch::HeapCounterRetain();
@@ -30,7 +86,40 @@ NameSegment::~NameSegment()
     m_context = nullptr;
 }
 
-bool NameSegment::ReadFromStream()
+bool NameSegment::ReadFromStream(bool deferred)
+{
+    this->InvalidateIndex();
+    m_sortedlayout = (m_context->header->Metadata()->features & uint32_t(HeaderFeatures::SortedNames)) != 0;
+    m_coded.Free();
+    m_encoded.Free();
+    m_storedrefs.clear();
+    m_keepcoded = deferred;
+    m_deferred = deferred;
+    if (deferred) {
+        return true;
+    }
+    return this->InternalReadFromStream();
+}
+
+bool NameSegment::LoadDeferred()
+{
+    if (!m_deferred.load(std::memory_order_acquire)) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(m_loadmutex);
+    if (m_deferred.load(std::memory_order_relaxed)) {
+        // Stays deferred on failure, the next use reads again and records its own error
+        if (!this->InternalReadFromStream()) {
+            m_names.Free();
+            m_coded.Free();
+            return false;
+        }
+        m_deferred.store(false, std::memory_order_release);
+    }
+    return true;
+}
+
+bool NameSegment::InternalReadFromStream()
 {
     // No name section
     if (!this->IsValid()) { 
@@ -40,7 +129,7 @@ bool NameSegment::ReadFromStream()
     Context *ctx = m_context;
 
     MetaHeader *metaheader = ctx->header->Metadata();
-    uint32_t offset = ctx->offset + metaheader->hash_offset + metaheader->hash_count * sizeof(MetaHash);
+    uint64_t offset = ctx->offset + metaheader->hash_offset + ctx->GetHashSegmentSize();
     uint32_t size   = ctx->header->Metadata()->name_size;
 
     m_names.Alloc(size);
@@ -55,21 +144,38 @@ bool NameSegment::ReadFromStream()
     // Decrypt names data
     ctx->crypto->CryptoNoCopy((unsigned char*)m_names.GetBytes(), (int)m_names.GetSize()); 
 
+    if (metaheader->features & uint32_t(HeaderFeatures::FrontCodedNames)) {
+        m_coded = m_names;
+        m_names.Free();
+        if (!this->ParseFrontCoded()) {
+            m_coded.Free();
+            XPACK_ERROR(xpack::Error::Format);
+            return false;
+        }
+        // Writable opens work on raw names, MetaHash.name_offset becomes the byte offset again
+        if (!m_keepcoded && !this->DecodeToRaw()) {
+            XPACK_ERROR(xpack::Error::Format);
+            return false;
+        }
+    }
     return true;
 }
 
 bool NameSegment::WriteToStream()
 {
+    if (!this->LoadDeferred()) {
+        return false;
+    }
     Context *ctx = m_context;
     ctx->header->UpdateMetadata();
     MetaHeader *metaheader = ctx->header->Metadata();
-    torch::Data wb = m_names;
+    torch::Data wb = m_encoded.GetSize() > 0 ? m_encoded : m_names;
     
     // Encrypt names data
     ctx->crypto->CryptoNoCopy((unsigned char*)wb.GetBytes(), (int)wb.GetSize()); 
 
-    uint32_t nameoffset = ctx->offset + metaheader->hash_offset + metaheader->hash_count * sizeof(MetaHash);
-    uint32_t size = (uint32_t)m_names.GetSize();
+    uint64_t nameoffset = ctx->offset + metaheader->hash_offset + ctx->GetHashSegmentSize();
+    uint32_t size = (uint32_t)wb.GetSize();
     if (!ctx->stream->PutContent(wb.GetBytes(), size, nameoffset)) {
         return false;
     }
@@ -90,12 +196,25 @@ bool NameSegment::IsValid()
 
 uint32_t NameSegment::Size()
 {
+    if (m_deferred.load(std::memory_order_acquire)) {
+        return m_context->header->Metadata()->name_size; // Keep the header as it is
+    }
+    if (m_coded.GetSize() > 0) {
+        return (uint32_t)m_coded.GetSize();
+    }
+    if (m_encoded.GetSize() > 0) {
+        return (uint32_t)m_encoded.GetSize();
+    }
     return (uint32_t)m_names.GetSize();
 }
 
 const char* NameSegment::GetNamePtr(uint32_t offset, uint16_t size)
 {
-    if (offset + size > m_names.GetSize()) {
+    if (!this->LoadDeferred()) {
+        return nullptr;
+    }
+    // Front coded names have no stored bytes to point at, see GetName
+    if (m_coded.GetSize() > 0 || offset + size > m_names.GetSize()) {
         return nullptr;
     }
     return (char*)m_names.GetBytes() + offset;
@@ -109,6 +228,17 @@ const char* NameSegment::GetNamePtr(MetaHash *metahash)
 
 std::string NameSegment::GetName(uint32_t offset, uint16_t size)
 {
+    if (!this->LoadDeferred()) {
+        return std::string();
+    }
+    if (m_coded.GetSize() > 0) {
+        // offset is the name order, decode through its bucket
+        std::vector<std::string> names;
+        if (offset >= m_codedcount || !this->DecodeBucket(offset / m_bucketsize, names) || names[offset % m_bucketsize].size() != size) {
+            return std::string();
+        }
+        return std::move(names[offset % m_bucketsize]);
+    }
     if (offset + size > m_names.GetSize()) {
         return std::string();
     }
@@ -132,6 +262,11 @@ void NameSegment::AddName(const std::string &name, MetaHash *hs)
 
 uint32_t NameSegment::AddName(const std::string &name)
 {
+    this->MakeRaw();
+    this->InvalidateIndex();
+    m_encoded.Free();
+    m_storedrefs.clear();
+    m_sortedlayout = false;
     uint32_t offset = (uint32_t)m_names.GetSize();
     m_names.Append(name.c_str(), name.size());
     m_context->header->UpdateMetadata();
@@ -140,6 +275,10 @@ uint32_t NameSegment::AddName(const std::string &name)
 
 void NameSegment::RemoveNameSafely(uint32_t offset, uint16_t size)
 {
+    this->MakeRaw();
+    this->InvalidateIndex();
+    m_encoded.Free();
+    m_storedrefs.clear();
     const char fc = 0;
     m_names.Fill(offset, size, fc);
     
@@ -163,24 +302,356 @@ void NameSegment::RemoveNameSafely(MetaHash *metahash)
 
 void NameSegment::CleanupNames()
 {
+    this->MakeRaw();
+    this->InvalidateIndex();
     Context *ctx = m_context;
     
     torch::Data wb;
     wb.Reserve(m_names.GetSize());
     
+    std::vector<MetaHash*> metahashs;
     for (auto it : ctx->hash->GetMetaHashMap()->GetIterator()) {
-        MetaHash *metahash = it.second;
+        metahashs.push_back(it.second);
+    }
+    
+    // Lay names out in name order, the name index is then built without comparing strings
+    m_sortedlayout = (ctx->header->Metadata()->features & uint32_t(HeaderFeatures::SortedNames)) != 0;
+    if (m_sortedlayout) {
+        std::sort(metahashs.begin(), metahashs.end(), [this](MetaHash *l, MetaHash *r) {
+            const char *lptr = this->GetNamePtr(l);
+            const char *rptr = this->GetNamePtr(r);
+            return CompareName(lptr ? lptr : "", lptr ? l->name_size : 0, rptr ? rptr : "", rptr ? r->name_size : 0) < 0;
+        });
+    }
+    
+    for (MetaHash *metahash : metahashs) {
         uint32_t offset = (uint32_t)wb.GetSize();
-        wb.Append(this->GetNamePtr(metahash), metahash->name_size);
+        const char *nameptr = this->GetNamePtr(metahash);
+        if (nameptr) {
+            wb.Append(nameptr, metahash->name_size);
+        }
         metahash->name_offset = offset;
     }
     
     m_names = wb;
+    this->EncodeNames(metahashs);
     m_context->header->UpdateMetadata();
 }
 
+uint32_t NameSegment::GetStoredOffset(MetaHash *metahash)
+{
+    assert(metahash);
+    if (m_encoded.GetSize() == 0) {
+        return metahash->name_offset;
+    }
+    if (metahash->flags & int(HashFlags::Conflict)) {
+        return 0;
+    }
+    NameRef ref = { metahash->name_offset, metahash->name_size };
+    auto it = std::lower_bound(m_storedrefs.begin(), m_storedrefs.end(), ref, [](const NameRef &l, const NameRef &r) {
+        return l.offset < r.offset || (l.offset == r.offset && l.size < r.size);
+    });
+    return (uint32_t)(it - m_storedrefs.begin());
+}
+
+bool NameSegment::IsFrontCoded()
+{
+    return this->LoadDeferred() && m_coded.GetSize() > 0;
+}
+
 const torch::Data& NameSegment::GetRawNames()
 {
+    this->MakeRaw();
     return m_names;
 }
 
+void NameSegment::EncodeNames(const std::vector<MetaHash*> &metahashs)
+{
+    m_encoded.Free();
+    m_storedrefs.clear();
+    if (!(m_context->header->Metadata()->features & uint32_t(HeaderFeatures::FrontCodedNames))) {
+        return;
+    }
+    
+    // metahashs are laid out in name order, conflict items have no name
+    const char *names = (const char *)m_names.GetBytes();
+    for (MetaHash *metahash : metahashs) {
+        if (!(metahash->flags & int(HashFlags::Conflict))) {
+            m_storedrefs.push_back({ metahash->name_offset, metahash->name_size });
+        }
+    }
+    if (m_storedrefs.empty()) {
+        return;
+    }
+    
+    // Each bucket starts with a full name, the others keep only what differs from the previous one
+    torch::Data payload;
+    std::vector<uint32_t> bucketoffsets;
+    payload.Reserve(m_names.GetSize() / 2);
+    for (size_t i = 0; i < m_storedrefs.size(); i++) {
+        const char *nameptr = names + m_storedrefs[i].offset;
+        uint32_t size = m_storedrefs[i].size;
+        if (i % XPACK_NAME_BUCKETSIZE == 0) {
+            bucketoffsets.push_back((uint32_t)payload.GetSize());
+            PutVarint(payload, size);
+            payload.Append(nameptr, size);
+            continue;
+        }
+        const char *prevptr = names + m_storedrefs[i - 1].offset;
+        uint32_t shared = 0, maxshared = std::min(size, (uint32_t)m_storedrefs[i - 1].size);
+        while (shared < maxshared && prevptr[shared] == nameptr[shared]) {
+            shared++;
+        }
+        PutVarint(payload, shared);
+        PutVarint(payload, size - shared);
+        payload.Append(nameptr + shared, size - shared);
+    }
+    
+    m_encoded.Reserve(8 + bucketoffsets.size() * 4 + payload.GetSize());
+    PutUInt32(m_encoded, (uint32_t)m_storedrefs.size());
+    PutUInt32(m_encoded, XPACK_NAME_BUCKETSIZE);
+    for (uint32_t offset : bucketoffsets) {
+        PutUInt32(m_encoded, offset);
+    }
+    m_encoded.Append(payload.GetBytes(), payload.GetSize());
+}
+
+bool NameSegment::ParseFrontCoded()
+{
+    const unsigned char *ptr = (const unsigned char *)m_coded.GetBytes();
+    size_t size = m_coded.GetSize();
+    if (size < 8) {
+        return false;
+    }
+    m_codedcount = GetUInt32(ptr);
+    m_bucketsize = GetUInt32(ptr + 4);
+    if (m_bucketsize == 0) {
+        return false;
+    }
+    size_t bucketcount = ((size_t)m_codedcount + m_bucketsize - 1) / m_bucketsize;
+    if (8 + bucketcount * 4 > size) {
+        return false;
+    }
+    for (size_t b = 0; b < bucketcount; b++) {
+        if (GetUInt32(ptr + 8 + b * 4) > size - 8 - bucketcount * 4) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool NameSegment::DecodeBucket(size_t bucket, std::vector<std::string> &outnames)
+{
+    outnames.clear();
+    const unsigned char *bytes = (const unsigned char *)m_coded.GetBytes();
+    size_t bucketcount = ((size_t)m_codedcount + m_bucketsize - 1) / m_bucketsize;
+    if (bucket >= bucketcount) {
+        return false;
+    }
+    const unsigned char *payload = bytes + 8 + bucketcount * 4;
+    const unsigned char *ptr = payload + GetUInt32(bytes + 8 + bucket * 4);
+    const unsigned char *end = bytes + m_coded.GetSize();
+    size_t count = std::min((size_t)m_bucketsize, (size_t)m_codedcount - bucket * m_bucketsize);
+    
+    outnames.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t shared = 0, size = 0;
+        if (i > 0 && !GetVarint(ptr, end, shared)) {
+            return false;
+        }
+        if (!GetVarint(ptr, end, size) || (i > 0 && shared > outnames[i - 1].size()) || size > (size_t)(end - ptr)) {
+            return false;
+        }
+        if (i > 0) {
+            outnames[i].assign(outnames[i - 1], 0, shared);
+        }
+        outnames[i].append((const char *)ptr, size);
+        ptr += size;
+    }
+    return true;
+}
+
+bool NameSegment::DecodeToRaw()
+{
+    std::vector<NameRef> refs;
+    std::vector<std::string> names;
+    torch::Data wb;
+    wb.Reserve(m_coded.GetSize() * 4);
+    size_t bucketcount = ((size_t)m_codedcount + m_bucketsize - 1) / m_bucketsize;
+    for (size_t b = 0; b < bucketcount; b++) {
+        if (!this->DecodeBucket(b, names)) {
+            return false;
+        }
+        for (auto &name : names) {
+            refs.push_back({ (uint32_t)wb.GetSize(), (uint16_t)name.size() });
+            wb.Append(name.c_str(), name.size());
+        }
+    }
+    
+    m_context->hash->ForeachMetaHash([&refs, &wb](MetaHash *metahash) {
+        if (metahash->flags & int(HashFlags::Conflict)) {
+            metahash->name_offset = 0;
+        }
+        else if (metahash->name_offset < refs.size() && refs[metahash->name_offset].size == metahash->name_size) {
+            metahash->name_offset = refs[metahash->name_offset].offset;
+        }
+        else {
+            metahash->name_offset = (uint32_t)wb.GetSize(); // Broken, reads as an empty name
+        }
+        return true;
+    });
+    
+    m_names = wb;
+    m_coded.Free();
+    m_codedcount = 0;
+    m_sortedlayout = true;
+    return true;
+}
+
+void NameSegment::MakeRaw()
+{
+    if (this->LoadDeferred() && m_coded.GetSize() > 0) {
+        this->InvalidateIndex();
+        if (!this->DecodeToRaw()) {
+            m_coded.Free();
+            m_names.Free();
+        }
+    }
+}
+
+bool NameSegment::ForeachNameWithPrefix(const std::string &prefix, std::function<bool(const std::string &name)> callback)
+{
+    if (!this->BuildIndex()) {
+        return false;
+    }
+    SortedCursor cursor = { SIZE_MAX };
+    for (size_t i = this->LowerBound(0, prefix, cursor); i < this->SortedCount(); i++) {
+        const std::string &name = this->SortedNameAt(i, cursor);
+        if (name.compare(0, prefix.size(), prefix) != 0) {
+            break;
+        }
+        if (!callback(name)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool NameSegment::ForeachChildName(const std::string &dir, std::function<bool(const std::string &name, bool isdir)> callback)
+{
+    std::string prefix = dir;
+    if (!prefix.empty() && prefix.back() != '/') {
+        prefix.push_back('/');
+    }
+    
+    if (!this->BuildIndex()) {
+        return false;
+    }
+    SortedCursor cursor = { SIZE_MAX };
+    size_t i = this->LowerBound(0, prefix, cursor);
+    while (i < this->SortedCount()) {
+        const std::string &name = this->SortedNameAt(i, cursor);
+        if (name.compare(0, prefix.size(), prefix) != 0) {
+            break;
+        }
+        size_t slash = name.find('/', prefix.size());
+        if (slash == std::string::npos) {
+            if (!callback(name, false)) {
+                return false;
+            }
+            i++;
+            continue;
+        }
+        
+        std::string child = name.substr(0, slash + 1);
+        if (!callback(child, true)) {
+            return false;
+        }
+        // Names under child sort before child with its '/' replaced by '0'
+        child.back() = '/' + 1;
+        i = this->LowerBound(i, child, cursor);
+    }
+    return true;
+}
+
+bool NameSegment::BuildIndex()
+{
+    if (m_indexready.load(std::memory_order_acquire)) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(m_indexmutex);
+    if (m_indexready.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    
+    if (!this->LoadDeferred()) {
+        return false;
+    }
+    m_index.clear();
+    if (m_coded.GetSize() > 0) {
+        m_indexready.store(true, std::memory_order_release); // Already in name order
+        return true;
+    }
+    m_context->hash->ForeachMetaHash([this](MetaHash *metahash) {
+        if (!(metahash->flags & int(HashFlags::Conflict)) && metahash->name_offset + metahash->name_size <= m_names.GetSize()) {
+            m_index.push_back({ metahash->name_offset, metahash->name_size });
+        }
+        return true;
+    });
+    
+    if (m_sortedlayout) {
+        std::sort(m_index.begin(), m_index.end(), [](const NameRef &l, const NameRef &r) {
+            return l.offset < r.offset;
+        });
+    }
+    else {
+        const char *names = (const char *)m_names.GetBytes();
+        std::sort(m_index.begin(), m_index.end(), [names](const NameRef &l, const NameRef &r) {
+            return CompareName(names + l.offset, l.size, names + r.offset, r.size) < 0;
+        });
+    }
+    m_indexready.store(true, std::memory_order_release);
+    return true;
+}
+
+void NameSegment::InvalidateIndex()
+{
+    std::lock_guard<std::mutex> lock(m_indexmutex);
+    m_index.clear();
+    m_indexready.store(false, std::memory_order_release);
+}
+
+size_t NameSegment::SortedCount()
+{
+    return m_coded.GetSize() > 0 ? m_codedcount : m_index.size();
+}
+
+const std::string& NameSegment::SortedNameAt(size_t i, SortedCursor &cursor)
+{
+    if (m_coded.GetSize() == 0) {
+        cursor.name.assign((const char *)m_names.GetBytes() + m_index[i].offset, m_index[i].size);
+        return cursor.name;
+    }
+    if (cursor.bucket != i / m_bucketsize) {
+        cursor.bucket = i / m_bucketsize;
+        if (!this->DecodeBucket(cursor.bucket, cursor.names)) {
+            cursor.names.resize(std::min((size_t)m_bucketsize, (size_t)m_codedcount - cursor.bucket * m_bucketsize));
+        }
+    }
+    return cursor.names[i % m_bucketsize];
+}
+
+size_t NameSegment::LowerBound(size_t first, const std::string &name, SortedCursor &cursor)
+{
+    size_t last = this->SortedCount();
+    while (first < last) {
+        size_t middle = first + (last - first) / 2;
+        if (this->SortedNameAt(middle, cursor).compare(name) < 0) {
+            first = middle + 1;
+        }
+        else {
+            last = middle;
+        }
+    }
+    return first;
+}
@@ -10,6 +10,10 @@
 #define __XPACK__NAME__
 
 #include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <functional>
 #include "xpack-def.h"
 #include "torch/torch.h"
 
@@ -24,9 +28,19 @@ namespace xpack {
     
         /*
          * 读取区域数据
+         * 参数：
+         *  - deferred: 延迟到第一次使用名字时再读取(只读且可以通过名字指纹校验存储项时使用)
          * 说明：根据HashSegment确定位置，NameSegment位于其后面
          */
-        bool ReadFromStream();
+        bool ReadFromStream(bool deferred = false);
+        
+        /*
+         * 读取延迟的区域数据，已读取时直接返回true
+         * 说明：
+         *  - 读取失败时记录错误代码并返回false，区域保持未读取状态，下次使用名字时重新读取
+         *  - 读取失败期间GetNamePtr返回nullptr，GetName返回空串，遍历接口返回false
+         */
+        bool LoadDeferred();
         
         /*
          * 将区域数据写入
@@ -50,6 +64,7 @@ namespace xpack {
          *  - offset, size: 偏移量和Name字节数
          *  - metahash: 根据metahash取Name
          * 返回值：不包含'\0'结尾，不可修改，不用释放内存
+         * 注意：直接读取前缀压缩数据时(IsFrontCoded)名字没有连续的存储，返回nullptr，请使用GetName
          */
         const char* GetNamePtr(uint32_t offset, uint16_t size);
         const char* GetNamePtr(MetaHash *metahash);
@@ -87,18 +102,95 @@ namespace xpack {
 
         /*
          * 清理所有的无效名称
-         * 注意：此接口会修改metahash和metaheader，务必在metaheader写入之前调用
+         * 说明：
+         *  - 开启HeaderFeatures::SortedNames时按名字顺序重新排列，读取后建立名字索引时不需要比较字符串
+         *  - 开启HeaderFeatures::FrontCodedNames时同时生成前缀压缩后的写入数据，之后Size()返回压缩后的大小
+         * 注意：此接口会修改metahash和metaheader，务必在HeaderSegment::ApplyFeatures之后、metaheader写入之前调用
          */
         void CleanupNames();
         
+        /*
+         * 获得写入时MetaHash记录的name_offset
+         * 说明：前缀压缩时为名字在名字顺序中的序号，否则为name_offset本身
+         */
+        uint32_t GetStoredOffset(MetaHash *metahash);
+        
+        /*
+         * 是否直接在前缀压缩的数据上读取名字(只读且延迟读取时)
+         * 说明：此时MetaHash.name_offset为名字序号，按名字顺序遍历比按Hash记录逐个取名字快
+         */
+        bool IsFrontCoded();
+        
+        /*
+         * 按名字顺序(逐字节比较)遍历以prefix开头的名字，callback返回false停止遍历
+         * 返回值：
+         *  - callback返回false或名字区域读取失败时返回false
+         * 说明：
+         *  - 第一次调用时建立名字索引，之后每次查询为O(log n + k)
+         *  - 名字增删后索引会在下次查询时重建
+         */
+        bool ForeachNameWithPrefix(const std::string &prefix, std::function<bool(const std::string &name)> callback);
+        
+        /*
+         * 按名字顺序遍历目录dir下的直接子项，callback返回false停止遍历
+         * 参数：
+         *  - dir: 目录名，以'/'分隔，空串表示根目录
+         * 返回值：
+         *  - callback返回false或名字区域读取失败时返回false
+         * 说明：
+         *  - 子目录只回调一次，名字以'/'结尾，并直接跳过其下的所有名字
+         */
+        bool ForeachChildName(const std::string &dir, std::function<bool(const std::string &name, bool isdir)> callback);
+        
         /*
          * 获得Name存储的原始数据
+         * 注意：前缀压缩时会先解码为原始数据并修改MetaHash记录，非线程安全，仅用于调试
          */
         const torch::Data& GetRawNames();
         
+    private:
+        struct NameRef {
+            uint32_t offset;
+            uint16_t size;
+        };
+        struct SortedCursor {
+            size_t                   bucket;  /* decoded front coded bucket, SIZE_MAX if none */
+            std::vector<std::string> names;
+            std::string              name;
+        };
+        
+        bool   InternalReadFromStream();
+        bool   BuildIndex();
+        void   InvalidateIndex();
+        size_t SortedCount();
+        const std::string& SortedNameAt(size_t i, SortedCursor &cursor);
+        size_t LowerBound(size_t first, const std::string &name, SortedCursor &cursor);
+        
+        bool   ParseFrontCoded();
+        bool   DecodeBucket(size_t bucket, std::vector<std::string> &outnames);
+        bool   DecodeToRaw();
+        void   MakeRaw();
+        void   EncodeNames(const std::vector<MetaHash*> &metahashs);
+        
     private:
         torch::Data  m_names;
         Context     *m_context;
+        
+        torch::Data  m_coded;        /* front coded names kept as read (HeaderFeatures::FrontCodedNames) */
+        uint32_t     m_codedcount;
+        uint32_t     m_bucketsize;
+        bool         m_keepcoded;    /* read in place, otherwise decoded to raw names on read */
+        
+        torch::Data          m_encoded;     /* front coded names to write, made by CleanupNames */
+        std::vector<NameRef> m_storedrefs;  /* raw names in m_encoded, in name order */
+        
+        std::atomic<bool> m_deferred;   /* names not read yet */
+        std::mutex        m_loadmutex;
+        
+        bool                 m_sortedlayout; /* offsets follow name order (HeaderFeatures::SortedNames) */
+        std::vector<NameRef> m_index;        /* names in byte-wise order */
+        std::atomic<bool>    m_indexready;
+        std::mutex           m_indexmutex;
     };
     
 }
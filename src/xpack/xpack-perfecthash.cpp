@@ -0,0 +1,188 @@
+//
+//  xpack
+//
+//  Created by Luwei.
+//  Copyright (c) 2016 Luwei. All rights reserved.
+//  Github: https://github.com/Luweimy
+//
+
+#include "xpack-perfecthash.h"
+#include "xpack-base.h"
+#include "xpack-def.h"
+#include <algorithm>
+
+#define XPACK_PERFECTHASH_EMPTY    UINT32_MAX
+#define XPACK_PERFECTHASH_BUCKETS  2            /* average keys per bucket */
+
+using namespace xpack;
+
+// splitmix64 finalizer, a bijection so distinct fingerprints never collide before the range reduction
+static inline uint64_t Mix64(uint64_t x)
+{
+    x ^= x >> 30; x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27; x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return x;
+}
+
+// Maps the high 32 bits onto [0, range) without a division
+static inline uint32_t Reduce(uint64_t x, uint32_t range)
+{
+    return (uint32_t)(((x >> 32) * range) >> 32);
+}
+
+size_t PerfectHash::GetSize(uint32_t slotcount)
+{
+    return (2 + (size_t)GetBucketCount(slotcount) + slotcount) * sizeof(uint32_t);
+}
+
+uint32_t PerfectHash::GetBucketCount(uint32_t slotcount)
+{
+    return (slotcount + XPACK_PERFECTHASH_BUCKETS - 1) / XPACK_PERFECTHASH_BUCKETS;
+}
+
+uint32_t PerfectHash::Bucket(uint64_t fingerprint, uint32_t bucketcount)
+{
+    return Reduce(fingerprint, bucketcount);
+}
+
+uint32_t PerfectHash::Slot(uint64_t fingerprint, uint32_t pilot, uint32_t slotcount)
+{
+    return Reduce(Mix64(fingerprint ^ Mix64(pilot)), slotcount);
+}
+
+bool PerfectHash::Build(const std::vector<uint64_t> &fingerprints, torch::Data &outdata)
+{
+    uint32_t slotcount   = (uint32_t)fingerprints.size();
+    uint32_t bucketcount = GetBucketCount(slotcount);
+
+    outdata.Alloc(GetSize(slotcount));
+    uint32_t *words   = (uint32_t *)outdata.GetBytes();
+    uint32_t *pilots  = words + 2;
+    uint32_t *indices = pilots + bucketcount;
+    words[0] = bucketcount;
+    words[1] = slotcount;
+    std::fill(pilots, pilots + bucketcount, 0);
+    std::fill(indices, indices + slotcount, XPACK_PERFECTHASH_EMPTY);
+
+    // Same fingerprints can never be told apart
+    std::vector<uint64_t> sorted;
+    sorted.reserve(slotcount);
+    for (uint64_t fingerprint : fingerprints) {
+        if (fingerprint != 0) {
+            sorted.push_back(fingerprint);
+        }
+    }
+    std::sort(sorted.begin(), sorted.end());
+    if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) {
+        outdata.Free();
+        XPACK_ERROR(xpack::Error::NotSupport);
+        return false;
+    }
+    if (sorted.empty()) {
+        return true;
+    }
+
+    // Group record indices by bucket (counting sort)
+    std::vector<uint32_t> starts(bucketcount + 1, 0);
+    for (uint64_t fingerprint : fingerprints) {
+        if (fingerprint != 0) {
+            starts[Bucket(fingerprint, bucketcount) + 1]++;
+        }
+    }
+    for (uint32_t b = 0; b < bucketcount; b++) {
+        starts[b + 1] += starts[b];
+    }
+    std::vector<uint32_t> members(sorted.size());
+    std::vector<uint32_t> cursor(starts.begin(), starts.end() - 1);
+    for (uint32_t i = 0; i < slotcount; i++) {
+        if (fingerprints[i] != 0) {
+            members[cursor[Bucket(fingerprints[i], bucketcount)]++] = i;
+        }
+    }
+
+    // Largest buckets first, while most slots are still free
+    std::vector<uint32_t> order;
+    order.reserve(bucketcount);
+    for (uint32_t b = 0; b < bucketcount; b++) {
+        if (starts[b + 1] > starts[b]) {
+            order.push_back(b);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [&starts](uint32_t l, uint32_t r) {
+        return starts[l + 1] - starts[l] > starts[r + 1] - starts[r];
+    });
+
+    std::vector<bool> taken(slotcount, false);
+    std::vector<uint32_t> slots;
+    for (uint32_t b : order) {
+        uint32_t begin = starts[b];
+        uint32_t size  = starts[b + 1] - begin;
+        slots.resize(size);
+
+        for (uint32_t pilot = 0; ; pilot++) {
+            bool fit = true;
+            for (uint32_t k = 0; k < size && fit; k++) {
+                uint32_t slot = Slot(fingerprints[members[begin + k]], pilot, slotcount);
+                fit = !taken[slot] && std::find(slots.begin(), slots.begin() + k, slot) == slots.begin() + k;
+                slots[k] = slot;
+            }
+            if (fit) {
+                for (uint32_t k = 0; k < size; k++) {
+                    taken[slots[k]] = true;
+                    indices[slots[k]] = members[begin + k];
+                }
+                pilots[b] = pilot;
+                break;
+            }
+            if (pilot == UINT32_MAX) {
+                outdata.Free();
+                XPACK_ERROR(xpack::Error::NotSupport);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool PerfectHash::IsValid(const torch::Data &data, uint32_t slotcount)
+{
+    if (data.GetSize() != GetSize(slotcount)) {
+        return false;
+    }
+    const uint32_t *words = (const uint32_t *)data.GetBytes();
+    if (words[0] != GetBucketCount(slotcount) || words[1] != slotcount) {
+        return false;
+    }
+    const uint32_t *indices = words + 2 + words[0];
+    for (uint32_t i = 0; i < slotcount; i++) {
+        if (indices[i] != XPACK_PERFECTHASH_EMPTY && indices[i] >= slotcount) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t PerfectHash::Lookup(const torch::Data &data, uint64_t fingerprint)
+{
+    const uint32_t *pilot = GetPilotPtr(data, fingerprint);
+    if (!pilot) {
+        return XPACK_PERFECTHASH_EMPTY;
+    }
+    return *GetIndexPtr(data, fingerprint, *pilot);
+}
+
+const uint32_t* PerfectHash::GetPilotPtr(const torch::Data &data, uint64_t fingerprint)
+{
+    const uint32_t *words = (const uint32_t *)data.GetBytes();
+    if (words[1] == 0) {
+        return nullptr;
+    }
+    return words + 2 + Bucket(fingerprint, words[0]);
+}
+
+const uint32_t* PerfectHash::GetIndexPtr(const torch::Data &data, uint64_t fingerprint, uint32_t pilot)
+{
+    const uint32_t *words = (const uint32_t *)data.GetBytes();
+    return words + 2 + words[0] + Slot(fingerprint, pilot, words[1]);
+}
@@ -0,0 +1,71 @@
+//
+//  xpack
+//
+//  Created by Luwei.
+//  Copyright (c) 2016 Luwei. All rights reserved.
+//  Github: https://github.com/Luweimy
+//
+
+#ifndef __XPACK__PERFECTHASH__
+#define __XPACK__PERFECTHASH__
+
+#include <stdio.h>
+#include <vector>
+#include "torch/torch.h"
+#include "xpack-def.h"
+
+namespace xpack {
+
+    /*
+     * 名字指纹上的完美哈希(HashSegment内部使用，HeaderFeatures::PerfectHash)
+     * 说明：
+     *  - 采用hash-and-displace(CHD/PTHash)方式构建：指纹先按高32位分桶，桶按大小降序依次放置，
+     *    每个桶找到一个位移值(pilot)使桶内所有指纹落到互不相同的空槽位
+     *  - 槽位数等于Hash记录数，冲突中转项不参与，对应的槽位为空
+     *  - 查询时只需计算一次槽位，读取一个记录序号，再由调用者比较指纹确认
+     *  - 数据为uint32_t数组：bucketcount, slotcount, pilots[bucketcount], indices[slotcount]
+     */
+    class PerfectHash {
+    public:
+        /*
+         * 获得slotcount个槽位时数据的尺寸(单位Byte)
+         */
+        static size_t GetSize(uint32_t slotcount);
+
+        /*
+         * 构建完美哈希
+         * 参数：
+         *  - fingerprints: 按Hash记录序号排列的名字指纹，为0的项不参与
+         *  - outdata: 构建结果
+         * 返回值：
+         *  - 存在重复的指纹时无法构建，返回false(Error::NotSupport)
+         */
+        static bool Build(const std::vector<uint64_t> &fingerprints, torch::Data &outdata);
+
+        /*
+         * 检测读取的数据是否与slotcount一致
+         */
+        static bool IsValid(const torch::Data &data, uint32_t slotcount);
+
+        /*
+         * 查询指纹对应的Hash记录序号，不存在时返回UINT32_MAX
+         * 注意：
+         *  - 不在集合中的指纹也会得到一个序号，调用者需要比较该记录的指纹
+         */
+        static uint32_t Lookup(const torch::Data &data, uint64_t fingerprint);
+
+        /*
+         * 分步查询，用于批量查询时逐步预取：先取桶的位移值，再取槽位的记录序号
+         */
+        static const uint32_t* GetPilotPtr(const torch::Data &data, uint64_t fingerprint);
+        static const uint32_t* GetIndexPtr(const torch::Data &data, uint64_t fingerprint, uint32_t pilot);
+
+    private:
+        static uint32_t GetBucketCount(uint32_t slotcount);
+        static uint32_t Bucket(uint64_t fingerprint, uint32_t bucketcount);
+        static uint32_t Slot(uint64_t fingerprint, uint32_t pilot, uint32_t slotcount);
+    };
+
+}
+
+#endif /* __XPACK__PERFECTHASH__ */
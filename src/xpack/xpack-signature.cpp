@@ -34,8 +34,8 @@ bool SignatureSegment::SearchFromStream()
     Context *ctx = m_context;
     assert(m_context->stream);
     
-    uint32_t partoffset = 0;
-    size_t fsize = ctx->stream->Size();
+    uint64_t partoffset = 0;
+    uint64_t fsize = ctx->stream->Size();
     MetaSignature signaturebuf = {0};
 
     while (partoffset < fsize) {
@@ -85,17 +85,17 @@ bool SignatureSegment::IsValid()
         return false;
     }
     // Version not support
-    if (m_signature.version != xpack::VERSION) { 
+    if (m_signature.version != xpack::VERSION && m_signature.version != xpack::VERSION_32) {
         XPACK_ERROR(xpack::Error::Version);
         return false;
     }
     return true;
 }
 
-SignatureSegment* SignatureSegment::Initialize()
+SignatureSegment* SignatureSegment::Initialize(uint16_t version)
 {
     m_signature.signature = xpack::SIGNATURE;
-    m_signature.version = xpack::VERSION;
+    m_signature.version = version;
     return this;
 }
 
@@ -43,13 +43,16 @@ public:
     
     /*
      * 校验签名的正确性
+     * 说明：支持xpack::VERSION和xpack::VERSION_32两种格式版本
      */
     bool IsValid();
     
     /*
-     * 使用xpack::SIGNATURE和xpack::VERSION来初始化签名标记和版本号信息
+     * 使用xpack::SIGNATURE和版本号来初始化签名标记和版本号信息
+     * 参数：
+     *  - version: 格式版本，xpack::VERSION或xpack::VERSION_32
      */
-    SignatureSegment* Initialize();
+    SignatureSegment* Initialize(uint16_t version = xpack::VERSION);
     
     /*
      * 获得指向MetaSignature结构体的指针
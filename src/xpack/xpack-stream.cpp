@@ -10,9 +10,199 @@
 #include "xpack-def.h"
 #include "xpack-base.h"
 #include <assert.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <limits.h>
+#include <limits>
 
 using namespace xpack;
 
+// Byte order conversion is its own inverse, the same loop serves host->net and
+// net->host. `dst` may be the same buffer as `src`. The templates serve both
+// the current records and the 0x0009 (32-bit) ones, field names are the same.
+static void ConvertHeaderExtra(MetaHeader *dst, const MetaHeader *src)
+{
+    dst->features = torch::Endian::ToNet(src->features);
+}
+
+static void ConvertHeaderExtra(MetaHeader32 *dst, const MetaHeader32 *src)
+{
+}
+
+template <typename T>
+static void ConvertHeader(T *dst, const T *src)
+{
+    *dst = *src;
+    dst->archive_size   = torch::Endian::ToNet(src->archive_size);
+    dst->content_offset = torch::Endian::ToNet(src->content_offset);
+    dst->content_size   = torch::Endian::ToNet(src->content_size);
+    dst->block_offset   = torch::Endian::ToNet(src->block_offset);
+    dst->block_count    = torch::Endian::ToNet(src->block_count);
+    dst->hash_offset    = torch::Endian::ToNet(src->hash_offset);
+    dst->hash_count     = torch::Endian::ToNet(src->hash_count);
+    dst->name_size      = torch::Endian::ToNet(src->name_size);
+    ConvertHeaderExtra(dst, src);
+}
+
+template <typename T>
+static void ConvertHashs(T *dst, const T *src, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        dst[i].hash          = torch::Endian::ToNet(src[i].hash);
+        dst[i].crc           = torch::Endian::ToNet(src[i].crc);
+        dst[i].block_index   = torch::Endian::ToNet(src[i].block_index);
+        dst[i].unpacked_size = torch::Endian::ToNet(src[i].unpacked_size);
+        dst[i].name_offset   = torch::Endian::ToNet(src[i].name_offset);
+        dst[i].name_size     = torch::Endian::ToNet(src[i].name_size);
+        dst[i].conflict_refc = src[i].conflict_refc;
+        dst[i].salt          = src[i].salt;
+        dst[i].flags         = src[i].flags;
+    }
+}
+
+template <typename T>
+static void ConvertBlocks(T *dst, const T *src, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        dst[i].offset     = torch::Endian::ToNet(src[i].offset);
+        dst[i].size       = torch::Endian::ToNet(src[i].size);
+        dst[i].next_index = torch::Endian::ToNet(src[i].next_index);
+        dst[i].flags      = src[i].flags;
+    }
+}
+
+template <typename T>
+static bool GetHeaderRecord(Stream *stm, T *buffer, uint64_t offset)
+{
+    bool ok = stm->GetContent(buffer, sizeof(T), offset);
+    if (ok) {
+        ConvertHeader(buffer, buffer);
+    }
+    return ok;
+}
+
+template <typename T>
+static bool PutHeaderRecord(Stream *stm, T *buffer, uint64_t offset)
+{
+    T tmp;
+    ConvertHeader(&tmp, buffer);
+    return stm->PutContent(&tmp, sizeof(T), offset);
+}
+
+template <typename T>
+static bool GetHashRecords(Stream *stm, void *buffer, uint64_t offset, size_t count)
+{
+    bool ok = stm->GetContent(buffer, sizeof(T) * count, offset);
+    if (ok) {
+        ConvertHashs((T *)buffer, (T *)buffer, count);
+    }
+    return ok;
+}
+
+template <typename T>
+static bool PutHashRecords(Stream *stm, void *buffer, uint64_t offset, size_t count)
+{
+    if (count == 0) {
+        return true;
+    }
+    
+    // Convert into one contiguous buffer and write it with a single call
+    torch::Data wb(sizeof(T) * count);
+    ConvertHashs((T *)wb.GetBytes(), (T *)buffer, count);
+    bool ok = stm->PutContent(wb.GetBytes(), wb.GetSize(), offset);
+    if (!ok) {
+        XPACK_ERROR(xpack::Error::IO);
+        return false;
+    }
+    return true;
+}
+
+template <typename T>
+static bool GetBlockRecords(Stream *stm, void *buffer, uint64_t offset, size_t count)
+{
+    bool ok = stm->GetContent(buffer, sizeof(T) * count, offset);
+    if (ok) {
+        ConvertBlocks((T *)buffer, (T *)buffer, count);
+    }
+    return ok;
+}
+
+template <typename T>
+static bool PutBlockRecords(Stream *stm, void *buffer, uint64_t offset, size_t count)
+{
+    if (count == 0) {
+        return true;
+    }
+    
+    // Convert into one contiguous buffer and write it with a single call
+    torch::Data wb(sizeof(T) * count);
+    ConvertBlocks((T *)wb.GetBytes(), (T *)buffer, count);
+    bool ok = stm->PutContent(wb.GetBytes(), wb.GetSize(), offset);
+    if (!ok) {
+        XPACK_ERROR(xpack::Error::IO);
+        return false;
+    }
+    return true;
+}
+
+// Offsets are 64-bit everywhere above the backends, they are narrowed to off_t
+// (or long for stdio) only here, and rejected if the target can not hold them
+static bool IsFileOffset(uint64_t offset, size_t size)
+{
+    uint64_t maximum = (uint64_t)std::numeric_limits<off_t>::max();
+    return offset <= maximum && size <= maximum - offset;
+}
+
+static bool PositionalRead(int fd, void *buffer, size_t size, uint64_t offset)
+{
+    if (!IsFileOffset(offset, size)) {
+        XPACK_ERROR(Error::IO);
+        return false;
+    }
+    size_t rsize = 0;
+    while (rsize < size) {
+        ssize_t n = pread(fd, (char *)buffer + rsize, size - rsize, (off_t)(offset + rsize));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            XPACK_ERROR(Error::IO);
+            return false;
+        }
+        if (n == 0) {
+            XPACK_ERROR(Error::Format); // Unexpected end of file
+            return false;
+        }
+        rsize += n;
+    }
+    return true;
+}
+
+static bool PositionalWrite(int fd, const void *buffer, size_t size, uint64_t offset)
+{
+    if (!IsFileOffset(offset, size)) {
+        XPACK_ERROR(Error::IO);
+        return false;
+    }
+    size_t wsize = 0;
+    while (wsize < size) {
+        ssize_t n = pwrite(fd, (const char *)buffer + wsize, size - wsize, (off_t)(offset + wsize));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            XPACK_ERROR(Error::IO);
+            return false;
+        }
+        wsize += n;
+    }
+    return true;
+}
+
 /// Stream
 
 Stream::Stream()
@@ -25,12 +215,17 @@ Stream::~Stream()
     torch::HeapCounterRelease();
 }
 
-bool Stream::GetContent(torch::Data &content, size_t offset)
+bool Stream::GetContent(torch::Data &content, uint64_t offset)
 {
     return this->GetContent(content.GetBytes(), content.GetSize(), offset);
 }
 
-bool Stream::GetSignature(MetaSignature *buffer, size_t offset)
+const void* Stream::GetContentPtr(size_t size, uint64_t offset)
+{
+    return nullptr;
+}
+
+bool Stream::GetSignature(MetaSignature *buffer, uint64_t offset)
 {
     bool ok = this->GetContent(buffer, sizeof(MetaSignature), offset);
     if (ok) {
@@ -40,7 +235,7 @@ bool Stream::GetSignature(MetaSignature *buffer, size_t offset)
     return ok;
 }
 
-bool Stream::PutSignature(MetaSignature *buffer, size_t offset)
+bool Stream::PutSignature(MetaSignature *buffer, uint64_t offset)
 {
     MetaSignature convdate = *buffer;
     convdate.signature = torch::Endian::ToNet(buffer->signature);
@@ -48,119 +243,126 @@ bool Stream::PutSignature(MetaSignature *buffer, size_t offset)
     return this->PutContent(&convdate, sizeof(MetaSignature),  offset);
 }
 
-bool Stream::GetHeader(MetaHeader *buffer, size_t offset)
+bool Stream::GetHeader(MetaHeader *buffer, uint64_t offset)
 {
-    bool ok = this->GetContent(buffer, sizeof(MetaHeader), offset);
-    if (ok) {
-        buffer->archive_size = torch::Endian::ToHost(buffer->archive_size);
-        buffer->content_offset = torch::Endian::ToHost(buffer->content_offset);
-        buffer->content_size = torch::Endian::ToHost(buffer->content_size);
-        buffer->block_offset = torch::Endian::ToHost(buffer->block_offset);
-        buffer->block_count  = torch::Endian::ToHost(buffer->block_count);
-        buffer->hash_offset  = torch::Endian::ToHost(buffer->hash_offset);
-        buffer->hash_count   = torch::Endian::ToHost(buffer->hash_count);
-        buffer->name_size    = torch::Endian::ToHost(buffer->name_size);
-    }
-    return ok;
+    return GetHeaderRecord(this, buffer, offset);
+}
+
+bool Stream::PutHeader(MetaHeader *buffer, uint64_t offset)
+{
+    return PutHeaderRecord(this, buffer, offset);
+}
+
+bool Stream::GetHashs(void *buffer, uint64_t offset, size_t count)
+{
+    return GetHashRecords<MetaHash>(this, buffer, offset, count);
 }
 
-bool Stream::PutHeader(MetaHeader *buffer, size_t offset)
+bool Stream::PutHashs(void *buffer, uint64_t offset, size_t count)
 {
-    MetaHeader tmp = *buffer;
-    tmp.archive_size = torch::Endian::ToNet(buffer->archive_size);
-    tmp.content_offset = torch::Endian::ToNet(buffer->content_offset);
-    tmp.content_size = torch::Endian::ToNet(buffer->content_size);
-    tmp.block_offset = torch::Endian::ToNet(buffer->block_offset);
-    tmp.block_count  = torch::Endian::ToNet(buffer->block_count);
-    tmp.hash_offset  = torch::Endian::ToNet(buffer->hash_offset);
-    tmp.hash_count   = torch::Endian::ToNet(buffer->hash_count);
-    tmp.name_size    = torch::Endian::ToNet(buffer->name_size);
-    return this->PutContent(&tmp, sizeof(MetaHeader),  offset);
+    return PutHashRecords<MetaHash>(this, buffer, offset, count);
 }
 
-bool Stream::GetHashs(void *buffer, size_t offset, size_t count)
+bool Stream::GetBlocks(void *buffer, uint64_t offset, size_t count)
 {
-    bool ok = this->GetContent(buffer, sizeof(MetaHash) * count, offset);
+    return GetBlockRecords<MetaBlock>(this, buffer, offset, count);
+}
+
+bool Stream::PutBlocks(void *buffer, uint64_t offset, size_t count)
+{
+    return PutBlockRecords<MetaBlock>(this, buffer, offset, count);
+}
+
+bool Stream::GetFingerprints(uint64_t *buffer, uint64_t offset, size_t count)
+{
+    bool ok = this->GetContent(buffer, sizeof(uint64_t) * count, offset);
     if (ok) {
-        MetaHash *p = (MetaHash *)buffer;
-        for (int i = 0; i < count; i++) {
-            p->hash        = torch::Endian::ToHost(p->hash);
-            p->crc         = torch::Endian::ToHost(p->crc);
-            p->block_index = torch::Endian::ToHost(p->block_index);
-            p->unpacked_size = torch::Endian::ToHost(p->unpacked_size);
-            p->name_offset = torch::Endian::ToHost(p->name_offset);
-            p->name_size   = torch::Endian::ToHost(p->name_size);
-            p->conflict_refc = torch::Endian::ToHost(p->conflict_refc);
-            p->salt        = torch::Endian::ToHost(p->salt);
-            p->flags       = torch::Endian::ToHost(p->flags);
-            p++; // Move to next hash item
+        for (size_t i = 0; i < count; i++) {
+            buffer[i] = torch::Endian::ToHost(buffer[i]);
         }
     }
     return ok;
 }
 
-bool Stream::PutHashs(void *buffer, size_t offset, size_t count)
-{
-    MetaHash tmp = {0};
-    MetaHash *p = (MetaHash *)buffer;
-    for (int i = 0; i < count; i++) {
-        tmp.hash        = torch::Endian::ToNet(p->hash);
-        tmp.crc         = torch::Endian::ToNet(p->crc);
-        tmp.block_index = torch::Endian::ToNet(p->block_index);
-        tmp.unpacked_size = torch::Endian::ToNet(p->unpacked_size);
-        tmp.name_offset = torch::Endian::ToNet(p->name_offset);
-        tmp.name_size   = torch::Endian::ToNet(p->name_size);
-        tmp.conflict_refc = torch::Endian::ToNet(p->conflict_refc);
-        tmp.salt        = torch::Endian::ToNet(p->salt);
-        tmp.flags       = torch::Endian::ToNet(p->flags);
-        bool ok = this->PutContent(&tmp, sizeof(MetaHash), offset + sizeof(MetaHash) * i);
-        if (!ok) {
-            XPACK_ERROR(xpack::Error::IO);
-            return false;
-        }
-        p++;
+bool Stream::PutFingerprints(uint64_t *buffer, uint64_t offset, size_t count)
+{
+    if (count == 0) {
+        return true;
+    }
+    torch::Data wb(sizeof(uint64_t) * count);
+    uint64_t *wptr = (uint64_t *)wb.GetBytes();
+    for (size_t i = 0; i < count; i++) {
+        wptr[i] = torch::Endian::ToNet(buffer[i]);
+    }
+    if (!this->PutContent(wb.GetBytes(), wb.GetSize(), offset)) {
+        XPACK_ERROR(xpack::Error::IO);
+        return false;
     }
     return true;
 }
 
-bool Stream::GetBlocks(void *buffer, size_t offset, size_t count)
+bool Stream::GetPerfectHash(uint32_t *buffer, uint64_t offset, size_t count)
 {
-    bool ok = this->GetContent(buffer, sizeof(MetaBlock) * count, offset);
+    bool ok = this->GetContent(buffer, sizeof(uint32_t) * count, offset);
     if (ok) {
-        MetaBlock *p = (MetaBlock *)buffer;
-        for (int i = 0; i < count; i++) {
-            p->offset        = torch::Endian::ToHost(p->offset);
-            p->size          = torch::Endian::ToHost(p->size);
-            p->next_index    = torch::Endian::ToHost(p->next_index);
-            p->flags         = torch::Endian::ToHost(p->flags);
-            p++; // move to next hash item
+        for (size_t i = 0; i < count; i++) {
+            buffer[i] = torch::Endian::ToHost(buffer[i]);
         }
     }
     return ok;
 }
 
-bool Stream::PutBlocks(void *buffer, size_t offset, size_t count)
+bool Stream::PutPerfectHash(uint32_t *buffer, uint64_t offset, size_t count)
 {
-    MetaBlock tmp = {0};
-    MetaBlock *p = (MetaBlock *)buffer;
-    for (int i = 0; i < count; i++) {
-        tmp.offset        = torch::Endian::ToNet(p->offset);
-        tmp.size          = torch::Endian::ToNet(p->size);
-        tmp.next_index    = torch::Endian::ToNet(p->next_index);
-        tmp.flags         = torch::Endian::ToNet(p->flags);
-        bool ok = this->PutContent(&tmp, sizeof(MetaBlock), offset + sizeof(MetaBlock) * i);
-        if (!ok) {
-            XPACK_ERROR(xpack::Error::IO);
-            return false;
-        }
-        p++;
+    if (count == 0) {
+        return true;
+    }
+    torch::Data wb(sizeof(uint32_t) * count);
+    uint32_t *wptr = (uint32_t *)wb.GetBytes();
+    for (size_t i = 0; i < count; i++) {
+        wptr[i] = torch::Endian::ToNet(buffer[i]);
+    }
+    if (!this->PutContent(wb.GetBytes(), wb.GetSize(), offset)) {
+        XPACK_ERROR(xpack::Error::IO);
+        return false;
     }
     return true;
 }
 
+bool Stream::GetHeader32(MetaHeader32 *buffer, uint64_t offset)
+{
+    return GetHeaderRecord(this, buffer, offset);
+}
+
+bool Stream::PutHeader32(MetaHeader32 *buffer, uint64_t offset)
+{
+    return PutHeaderRecord(this, buffer, offset);
+}
+
+bool Stream::GetHashs32(void *buffer, uint64_t offset, size_t count)
+{
+    return GetHashRecords<MetaHash32>(this, buffer, offset, count);
+}
+
+bool Stream::PutHashs32(void *buffer, uint64_t offset, size_t count)
+{
+    return PutHashRecords<MetaHash32>(this, buffer, offset, count);
+}
+
+bool Stream::GetBlocks32(void *buffer, uint64_t offset, size_t count)
+{
+    return GetBlockRecords<MetaBlock32>(this, buffer, offset, count);
+}
+
+bool Stream::PutBlocks32(void *buffer, uint64_t offset, size_t count)
+{
+    return PutBlockRecords<MetaBlock32>(this, buffer, offset, count);
+}
+
 /// FileStream
 
 FileStream::FileStream()
+:m_readonly(true)
 {
 }
 
@@ -185,6 +387,7 @@ bool FileStream::Open(const std::string &path, bool readonly)
         XPACK_ERROR(Error::IO);
         return false;
     }
+    m_readonly = readonly;
     return true;
 }
 
@@ -198,19 +401,35 @@ bool FileStream::Flush()
     return m_fstream.Flush();
 }
 
-size_t FileStream::Size()
+uint64_t FileStream::Size()
 {
-    return m_fstream.GetSize();
+    // fstat instead of ftell, which is limited to long
+    struct stat st;
+    if (!m_fstream.IsOpen() || !m_fstream.Flush() || fstat(m_fstream.GetFileDescriptor(), &st) != 0) {
+        return 0;
+    }
+    return (uint64_t)st.st_size;
 }
 
-bool FileStream::ReSize(size_t size)
+bool FileStream::ReSize(uint64_t size)
 {
-    return m_fstream.ReSize(size);
+    if (!IsFileOffset(size, 0) || !m_fstream.Flush()) {
+        XPACK_ERROR(Error::IO);
+        return false;
+    }
+    return ftruncate(m_fstream.GetFileDescriptor(), (off_t)size) == 0;
 }
 
-bool FileStream::GetContent(void *buffer, size_t size, size_t offset)
+bool FileStream::GetContent(void *buffer, size_t size, uint64_t offset)
 {
-    bool ok = m_fstream.SeekSet(offset);
+    // Positional read does not touch the shared file position, so readonly
+    // streams can be read from several threads at once. Writable streams keep
+    // stdio to stay coherent with the buffered writes.
+    if (m_readonly) {
+        return PositionalRead(m_fstream.GetFileDescriptor(), buffer, size, offset);
+    }
+    
+    bool ok = offset <= (uint64_t)LONG_MAX && m_fstream.SeekSet((long)offset);
     if (!ok) {
         XPACK_ERROR(Error::IO);
         return false;
@@ -225,9 +444,9 @@ bool FileStream::GetContent(void *buffer, size_t size, size_t offset)
     return true;
 }
 
-bool FileStream::PutContent(void *buffer, size_t size, size_t offset)
+bool FileStream::PutContent(void *buffer, size_t size, uint64_t offset)
 {
-    bool ok = m_fstream.SeekSet(offset);
+    bool ok = offset <= (uint64_t)LONG_MAX && m_fstream.SeekSet((long)offset);
     if (!ok) {
         XPACK_ERROR(Error::IO);
         return false;
@@ -243,3 +462,207 @@ bool FileStream::PutContent(void *buffer, size_t size, size_t offset)
 }
 
 
+
+/// FdStream
+
+FdStream::FdStream()
+:m_fd(-1)
+,m_size(0)
+{
+}
+
+FdStream::~FdStream()
+{
+    this->Close();
+}
+
+bool FdStream::Open(const std::string &path, bool readonly)
+{
+    this->Close();
+    
+    int flags = readonly ? O_RDONLY : O_RDWR;
+#ifdef O_CLOEXEC
+    flags |= O_CLOEXEC;
+#endif
+    m_fd = open(path.c_str(), flags);
+    if (m_fd < 0) {
+        XPACK_ERROR(Error::IO);
+        return false;
+    }
+    
+    struct stat st;
+    if (fstat(m_fd, &st) != 0) {
+        this->Close();
+        XPACK_ERROR(Error::IO);
+        return false;
+    }
+    m_size = (uint64_t)st.st_size;
+    return true;
+}
+
+void FdStream::Close()
+{
+    if (m_fd >= 0) {
+        if (close(m_fd) != 0) {
+            XPACK_ERROR(Error::IO);
+        }
+    }
+    m_fd = -1;
+    m_size = 0;
+}
+
+bool FdStream::IsEnd()
+{
+    return false;
+}
+
+bool FdStream::Flush()
+{
+    // pwrite goes straight to the kernel, nothing is buffered here
+    return m_fd >= 0;
+}
+
+uint64_t FdStream::Size()
+{
+    return m_size;
+}
+
+bool FdStream::ReSize(uint64_t size)
+{
+    if (!IsFileOffset(size, 0) || ftruncate(m_fd, (off_t)size) != 0) {
+        XPACK_ERROR(Error::IO);
+        return false;
+    }
+    m_size = size;
+    return true;
+}
+
+bool FdStream::GetContent(void *buffer, size_t size, uint64_t offset)
+{
+    return PositionalRead(m_fd, buffer, size, offset);
+}
+
+bool FdStream::PutContent(void *buffer, size_t size, uint64_t offset)
+{
+    if (!PositionalWrite(m_fd, buffer, size, offset)) {
+        return false;
+    }
+    if (offset + size > m_size) {
+        m_size = offset + size;
+    }
+    return true;
+}
+
+/// MmapStream
+
+MmapStream::MmapStream()
+:m_mapped(nullptr)
+,m_size(0)
+{
+}
+
+MmapStream::~MmapStream()
+{
+    this->Unmap();
+}
+
+bool MmapStream::Open(const std::string &path, bool readonly)
+{
+    this->Unmap();
+    
+    if (!readonly) {
+        XPACK_ERROR(Error::IO); // Read only stream
+        return false;
+    }
+    
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        XPACK_ERROR(Error::IO);
+        return false;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        XPACK_ERROR(Error::IO);
+        return false;
+    }
+    
+    // The whole file has to fit in the address space
+    if ((uint64_t)st.st_size > (uint64_t)SIZE_MAX) {
+        close(fd);
+        XPACK_ERROR(Error::IO);
+        return false;
+    }
+    m_size = (size_t)st.st_size;
+    if (m_size > 0) {
+        void *mapped = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            close(fd);
+            m_size = 0;
+            XPACK_ERROR(Error::IO);
+            return false;
+        }
+        m_mapped = (unsigned char *)mapped;
+    }
+    
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+    return true;
+}
+
+void MmapStream::Unmap()
+{
+    if (m_mapped) {
+        munmap(m_mapped, m_size);
+    }
+    m_mapped = nullptr;
+    m_size = 0;
+}
+
+bool MmapStream::IsEnd()
+{
+    return true;
+}
+
+bool MmapStream::Flush()
+{
+    return true;
+}
+
+uint64_t MmapStream::Size()
+{
+    return m_size;
+}
+
+bool MmapStream::ReSize(uint64_t size)
+{
+    XPACK_ERROR(Error::IO); // Read only stream
+    return false;
+}
+
+bool MmapStream::GetContent(void *buffer, size_t size, uint64_t offset)
+{
+    if (offset > m_size || size > m_size - offset) {
+        XPACK_ERROR(Error::Format);
+        return false;
+    }
+    if (size > 0) {
+        memcpy(buffer, m_mapped + offset, size);
+    }
+    return true;
+}
+
+bool MmapStream::PutContent(void *buffer, size_t size, uint64_t offset)
+{
+    XPACK_ERROR(Error::IO); // Read only stream
+    return false;
+}
+
+const void* MmapStream::GetContentPtr(size_t size, uint64_t offset)
+{
+    if (!m_mapped || offset > m_size || size > m_size - offset) {
+        return nullptr;
+    }
+    return m_mapped + offset;
+}
@@ -25,23 +25,44 @@ namespace xpack {
         virtual bool IsEnd() = 0;
         virtual bool Flush() = 0;
         
-        virtual size_t Size() = 0;
-        virtual bool ReSize(size_t size) = 0;
+        virtual uint64_t Size() = 0;
+        virtual bool ReSize(uint64_t size) = 0;
 
-        virtual bool GetContent(void *buffer, size_t size, size_t offset) = 0;
-        virtual bool PutContent(void *buffer, size_t size, size_t offset) = 0;
+        virtual bool GetContent(void *buffer, size_t size, uint64_t offset) = 0;
+        virtual bool PutContent(void *buffer, size_t size, uint64_t offset) = 0;
         
-        virtual bool GetContent(torch::Data &content, size_t offset);
+        virtual bool GetContent(torch::Data &content, uint64_t offset);
         
-        virtual bool GetSignature(MetaSignature *buffer, size_t offset);
-        virtual bool PutSignature(MetaSignature *buffer, size_t offset);
-        virtual bool GetHeader(MetaHeader *buffer, size_t offset);
-        virtual bool PutHeader(MetaHeader *buffer, size_t offset);
+        /*
+         * 获取指向流内部数据的只读指针(零拷贝)
+         * 返回值：
+         *  - 不支持直接访问或越界时返回nullptr，默认实现不支持
+         */
+        virtual const void* GetContentPtr(size_t size, uint64_t offset);
         
-        virtual bool GetHashs(void *buffer, size_t offset, size_t count);
-        virtual bool PutHashs(void *buffer, size_t offset, size_t count);
-        virtual bool GetBlocks(void *buffer, size_t offset, size_t count);
-        virtual bool PutBlocks(void *buffer, size_t offset, size_t count);
+        virtual bool GetSignature(MetaSignature *buffer, uint64_t offset);
+        virtual bool PutSignature(MetaSignature *buffer, uint64_t offset);
+        virtual bool GetHeader(MetaHeader *buffer, uint64_t offset);
+        virtual bool PutHeader(MetaHeader *buffer, uint64_t offset);
+        
+        virtual bool GetHashs(void *buffer, uint64_t offset, size_t count);
+        virtual bool PutHashs(void *buffer, uint64_t offset, size_t count);
+        virtual bool GetBlocks(void *buffer, uint64_t offset, size_t count);
+        virtual bool PutBlocks(void *buffer, uint64_t offset, size_t count);
+        virtual bool GetFingerprints(uint64_t *buffer, uint64_t offset, size_t count);
+        virtual bool PutFingerprints(uint64_t *buffer, uint64_t offset, size_t count);
+        virtual bool GetPerfectHash(uint32_t *buffer, uint64_t offset, size_t count);
+        virtual bool PutPerfectHash(uint32_t *buffer, uint64_t offset, size_t count);
+        
+        /*
+         * 读写0x0009版本(32位)的元信息
+         */
+        virtual bool GetHeader32(MetaHeader32 *buffer, uint64_t offset);
+        virtual bool PutHeader32(MetaHeader32 *buffer, uint64_t offset);
+        virtual bool GetHashs32(void *buffer, uint64_t offset, size_t count);
+        virtual bool PutHashs32(void *buffer, uint64_t offset, size_t count);
+        virtual bool GetBlocks32(void *buffer, uint64_t offset, size_t count);
+        virtual bool PutBlocks32(void *buffer, uint64_t offset, size_t count);
 
     };
     
@@ -55,14 +76,81 @@ namespace xpack {
         bool IsEnd();
         bool Flush();
         
-        size_t Size();
-        bool ReSize(size_t size);
+        uint64_t Size();
+        bool ReSize(uint64_t size);
         
-        bool GetContent(void *buffer, size_t size, size_t offset);
-        bool PutContent(void *buffer, size_t size, size_t offset);
+        bool GetContent(void *buffer, size_t size, uint64_t offset);
+        bool PutContent(void *buffer, size_t size, uint64_t offset);
         
     private:
         torch::File m_fstream;
+        bool        m_readonly;
+    };
+    
+    /*
+     * 基于文件描述符的流(pread/pwrite)
+     * 说明：
+     *  - 使用位置读写(pread/pwrite)，不依赖文件读写位置，每次读写只有一次系统调用
+     *  - 不经过stdio缓冲，大块数据读取时不会产生额外的内存拷贝
+     *  - 文件大小在打开时获取并缓存，后续随写入和ReSize更新
+     *  - 读取接口可在多个线程中同时调用
+     */
+    class FdStream : public Stream {
+    public:
+        FdStream();
+        ~FdStream();
+        
+        bool Open(const std::string &path, bool readonly = true);
+        
+        bool IsEnd();
+        bool Flush();
+        
+        uint64_t Size();
+        bool ReSize(uint64_t size);
+        
+        bool GetContent(void *buffer, size_t size, uint64_t offset);
+        bool PutContent(void *buffer, size_t size, uint64_t offset);
+        
+    private:
+        void Close();
+        
+    private:
+        int      m_fd;
+        uint64_t m_size;
+    };
+    
+    /*
+     * 内存映射流(只读)
+     * 说明：
+     *  - 打开时将整个文件映射到内存，之后的读取直接从映射内存中拷贝，不再有seek+fread的系统调用开销
+     *  - 适用于只读场景下频繁读取大量小文件的情况
+     * 注意：
+     *  - 只支持只读模式打开，写入相关接口(PutContent/ReSize)均会失败
+     */
+    class MmapStream : public Stream {
+    public:
+        MmapStream();
+        ~MmapStream();
+        
+        bool Open(const std::string &path, bool readonly = true);
+        
+        bool IsEnd();
+        bool Flush();
+        
+        uint64_t Size();
+        bool ReSize(uint64_t size);
+        
+        bool GetContent(void *buffer, size_t size, uint64_t offset);
+        bool PutContent(void *buffer, size_t size, uint64_t offset);
+        
+        const void* GetContentPtr(size_t size, uint64_t offset);
+        
+    private:
+        void Unmap();
+        
+    private:
+        unsigned char *m_mapped;
+        size_t         m_size;
     };
     
 }
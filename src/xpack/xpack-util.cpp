@@ -144,7 +144,7 @@ std::string DumpUtils::DumpAllHashIDChain(Context *ctx)
     return display;
 }
 
-std::string DumpUtils::DumpData(Context *ctx, uint32_t offset, uint32_t size)
+std::string DumpUtils::DumpData(Context *ctx, uint64_t offset, uint64_t size)
 {
     assert(ctx);
     torch::Data d;
@@ -163,8 +163,8 @@ std::string DumpUtils::DumpData(Context *ctx)
 std::string DumpUtils::DumpBlock(Context *ctx, MetaBlock *metablock)
 {
     assert(ctx && metablock);
-    uint32_t offset = metablock->offset;
-    uint32_t size = metablock->size;
+    uint64_t offset = metablock->offset;
+    uint64_t size = metablock->size;
     int32_t  next_index = metablock->next_index;
     uint8_t  flags = metablock->flags;
     std::string stringflags;
@@ -183,8 +183,8 @@ std::string DumpUtils::DumpBlock(Context *ctx, MetaBlock *metablock)
     std::string display;
     std::vector<std::string> keys = {"offset", "size", "next_index", "flags"};
     std::vector<std::string> vals = {
-        torch::String::Format("%u", offset),
-        torch::String::Format("%u(%s)", size, torch::ByteToHumanReadableString(size).c_str()),
+        torch::String::Format("%llu", (unsigned long long)offset),
+        torch::String::Format("%llu(%s)", (unsigned long long)size, torch::ByteToHumanReadableString(size).c_str()),
         torch::String::Format("%d(index:%d, name:%s)", next_index, blockindex, blockname.c_str()),
         torch::String::Format("%d(%s)[%s]", flags, torch::ToBinary<uint8_t>(flags).c_str(), stringflags.c_str()),
     };
@@ -226,7 +226,7 @@ std::string DumpUtils::DumpHash(Context *ctx, MetaHash *metahash)
     uint32_t hash = metahash->hash;
     uint32_t crc = metahash->crc;
     int32_t  block_index = metahash->block_index;
-    int32_t  unpacked_size = metahash->unpacked_size;
+    uint64_t unpacked_size = metahash->unpacked_size;
     uint32_t name_offset = metahash->name_offset;
     uint16_t name_size = metahash->name_size;
     uint8_t  conflict_refc = metahash->conflict_refc;
@@ -250,7 +250,7 @@ std::string DumpUtils::DumpHash(Context *ctx, MetaHash *metahash)
         torch::String::Format("%u(0x%s)", hash, torch::ToHexHumanReadable<uint32_t>(hash).c_str()),
         torch::String::Format("%u(0x%s)", crc, torch::ToHexHumanReadable<uint32_t>(crc).c_str()),
         torch::String::Format("%d", block_index),
-        torch::String::Format("%u(%s)", unpacked_size, torch::ByteToHumanReadableString(unpacked_size).c_str()),
+        torch::String::Format("%llu(%s)", (unsigned long long)unpacked_size, torch::ByteToHumanReadableString(unpacked_size).c_str()),
         torch::String::Format("%u(name:%s)", name_offset, ctx->name->GetName(metahash).c_str()),
         torch::String::Format("%u", name_size),
         torch::String::Format("%d", conflict_refc),
@@ -299,15 +299,18 @@ std::string DumpUtils::DumpHeader(Context *ctx)
 {
     assert(ctx);
     xpack::HeaderSegment *object = ctx->header;
-    uint32_t archive_size = object->Metadata()->archive_size;
-    uint32_t content_offset = object->Metadata()->content_offset;
-    uint32_t content_size = object->Metadata()->content_size;
-    uint32_t block_offset = object->Metadata()->block_offset;
+    unsigned long long archive_size = object->Metadata()->archive_size;
+    unsigned long long content_offset = object->Metadata()->content_offset;
+    unsigned long long content_size = object->Metadata()->content_size;
+    unsigned long long block_offset = object->Metadata()->block_offset;
     uint32_t block_count = object->Metadata()->block_count;
-    uint32_t hash_offset = object->Metadata()->hash_offset;
+    unsigned long long hash_offset = object->Metadata()->hash_offset;
     uint32_t hash_count = object->Metadata()->hash_count;
     uint32_t name_size = object->Metadata()->name_size;
-    size_t name_offset = hash_offset + hash_count * sizeof(MetaHash);
+    uint32_t features = object->Metadata()->features;
+    unsigned long long blocksize = ctx->GetBlockRecordSize();
+    unsigned long long hashsize = ctx->GetHashRecordSize();
+    unsigned long long name_offset = hash_offset + ctx->GetHashSegmentSize();
     
     std::string display;
     std::vector<std::string> keys = {
@@ -318,17 +321,19 @@ std::string DumpUtils::DumpHeader(Context *ctx)
         "block_count",
         "hash_offset",
         "hash_count",
-        "name_size"
+        "name_size",
+        "features"
     };
     std::vector<std::string> vals = {
-        torch::String::Format("%u(%s)", archive_size, torch::ByteToHumanReadableString(archive_size).c_str()),
-        torch::String::Format("%u", content_offset),
-        torch::String::Format("%u(%s)", content_size, torch::ByteToHumanReadableString(content_size).c_str()),
-        torch::String::Format("%u", block_offset),
-        torch::String::Format("%u(%u*%u=%u)", block_count, block_count, sizeof(MetaBlock), block_count * sizeof(MetaBlock)),
-        torch::String::Format("%u", hash_offset),
-        torch::String::Format("%u(%u*%u=%u)", hash_count, hash_count, sizeof(MetaHash), hash_count * sizeof(MetaHash)),
-        torch::String::Format("%u(offset=%u)", name_size, name_offset),
+        torch::String::Format("%llu(%s)", archive_size, torch::ByteToHumanReadableString(archive_size).c_str()),
+        torch::String::Format("%llu", content_offset),
+        torch::String::Format("%llu(%s)", content_size, torch::ByteToHumanReadableString(content_size).c_str()),
+        torch::String::Format("%llu", block_offset),
+        torch::String::Format("%u(%u*%llu=%llu)", block_count, block_count, blocksize, block_count * blocksize),
+        torch::String::Format("%llu", hash_offset),
+        torch::String::Format("%u(%u*%llu=%llu)", hash_count, hash_count, hashsize, hash_count * hashsize),
+        torch::String::Format("%u(offset=%llu)", name_size, name_offset),
+        torch::String::Format("0x%08x", features),
     };
     for (int i = 0; i < keys.size(); i++) {
         display += torch::String::RightPad(keys[i], KEY_LENGTH, ' ') + ": " + vals[i] + '\n';
@@ -369,7 +374,7 @@ std::string DumpUtils::DumpBlockContentUnused(Context *ctx)
     std::string display;
     auto contentUnusedPool = ctx->block->GetContentReuser();
     for (auto x : contentUnusedPool->GetOrderdByOffsetAscendingIterator()) {
-        display += DumpUtils::DumpBlock(ctx, x.value) + '\n';
+        display += DumpUtils::DumpBlock(ctx, x.index) + '\n';
     }
     return display;
 }
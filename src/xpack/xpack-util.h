@@ -64,7 +64,7 @@ namespace xpack {
         static std::string DumpAllHashIDMarkedConflict(Context *ctx);
         static std::string DumpAllHashIDChain(Context *ctx);
 
-        static std::string DumpData(Context *ctx, uint32_t offset, uint32_t size);
+        static std::string DumpData(Context *ctx, uint64_t offset, uint64_t size);
         static std::string DumpData(Context *ctx);
 
         static std::string DumpBlock(Context *ctx, MetaBlock *metablock);
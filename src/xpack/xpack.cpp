@@ -14,11 +14,103 @@
 #include "xpack-block.h"
 #include "xpack-signature.h"
 #include "xpack-content.h"
+#include "xpack-entry.h"
+#include "xpack-batch.h"
 #include "xpack-util.h"
 #include "torch/torch.h"
+#include <algorithm>
 
 using namespace xpack;
 
+// EntryView
+
+EntryView::EntryView()
+:m_size(0)
+{
+}
+
+bool EntryView::IsNull() const
+{
+    return m_spans.empty();
+}
+
+bool EntryView::IsContiguous() const
+{
+    return m_spans.size() == 1;
+}
+
+const void* EntryView::GetBytes() const
+{
+    if (m_spans.empty()) {
+        return nullptr;
+    }
+    return m_spans.front().data;
+}
+
+size_t EntryView::GetSize() const
+{
+    return m_size;
+}
+
+const std::vector<EntryView::Span>& EntryView::GetSpans() const
+{
+    return m_spans;
+}
+
+void EntryView::Append(const void *data, size_t size)
+{
+    Span span = { data, size };
+    m_spans.push_back(span);
+    m_size += size;
+}
+
+void EntryView::Clear()
+{
+    m_spans.clear();
+    m_size = 0;
+}
+
+// EntryHandle
+
+EntryHandle::EntryHandle()
+:m_package(nullptr)
+,m_generation(0)
+,m_size(0)
+{
+    memset(&m_metahash, 0, sizeof(MetaHash));
+    m_metahash.block_index = -1;
+}
+
+bool EntryHandle::IsNull() const
+{
+    return m_package == nullptr;
+}
+
+uint32_t EntryHandle::GetHashId() const
+{
+    return m_metahash.hash;
+}
+
+uint64_t EntryHandle::GetSize() const
+{
+    return m_size;
+}
+
+uint64_t EntryHandle::GetUnpackedSize() const
+{
+    return m_metahash.unpacked_size;
+}
+
+bool EntryHandle::IsCompressed() const
+{
+    return (m_metahash.flags & int(HashFlags::Compressed)) != 0;
+}
+
+bool EntryHandle::IsCrypto() const
+{
+    return (m_metahash.flags & int(HashFlags::CryptoRC4)) != 0;
+}
+
 // Package
 
 Package::Package()
@@ -28,6 +120,15 @@ Package::Package()
 ,m_modify(false)
 ,m_needcrc(true)
 ,m_needshrink(true)
+,m_readonly(true)
+,m_generation(0)
+,m_allocpolicy(AllocPolicy::SmallestFirst)
+,m_allocmaxchain(0)
+,m_features(xpack::DEFAULT_FEATURES)
+,m_loadmode(LoadMode::Eager)
+,m_loaded(false)
+,m_loadok(false)
+,m_loaderror(xpack::Error::NoErr)
 {
     m_rc4crypto =  new torch::crypto::RC4();
     
@@ -46,20 +147,31 @@ Package::~Package()
     }
 }
 
-bool Package::Open(const std::string &path, bool readonly)
+bool Package::Open(const std::string &path, bool readonly, StreamType type)
 {
-    return this->OpenWithStream(new FileStream, path, readonly);
+    if (type == StreamType::Mmap) {
+        return this->OpenWithStream(new MmapStream, path, readonly);
+    }
+    if (type == StreamType::File) {
+        return this->OpenWithStream(new FileStream, path, readonly);
+    }
+    return this->OpenWithStream(new FdStream, path, readonly);
 }
 
-bool Package::OpenNew(const std::string &path)
+bool Package::OpenNew(const std::string &path, uint16_t version)
 {
     this->Close();
     
+    if (version != xpack::VERSION && version != xpack::VERSION_32) {
+        XPACK_ERROR(xpack::Error::Version);
+        return false;
+    }
+    
     if (!torch::FileSystem::IsPathExist(path)) {
         torch::FileSystem::MakeFile(path);
     }
 
-    m_stream = new xpack::FileStream;
+    m_stream = new xpack::FdStream;
     if (!m_stream || !m_stream->Open(path, false /* r+w */)) {
         return false;
     }
@@ -68,17 +180,22 @@ bool Package::OpenNew(const std::string &path)
     if (!m_context) {
         return false;
     }
+    m_context->block->SetAllocPolicy(m_allocpolicy, m_allocmaxchain);
+    m_context->header->SetFeatures(m_features);
     
-    m_context->SetAlignedOffset((uint32_t)m_stream->Size());
+    m_context->SetAlignedOffset(m_stream->Size());
     
-    if (!m_context->signature->Initialize()->WriteToStream()) {
+    if (!m_context->signature->Initialize(version)->WriteToStream()) {
         return false;
     }
     if (!m_context->header->Initialize()->WriteToStream()) {
         return false;
     }
     
-    m_modify = true;
+    m_readonly = false;
+    m_loadok = true;
+    m_loaded = true;
+    this->MarkModified();
     return true;
 }
 
@@ -98,24 +215,61 @@ bool Package::OpenWithStream(Stream *stm, const std::string &path, bool readonly
     if (!m_context) {
         return false;
     }
+    m_context->block->SetAllocPolicy(m_allocpolicy, m_allocmaxchain);
+    m_context->header->SetFeatures(m_features);
     
-    if (!m_context->signature->SearchFromStream() && !m_context->signature->IsValid()) {// search signature
+    if (!m_context->signature->SearchFromStream() || !m_context->signature->IsValid()) {// search signature, check version
         return false;
     }
     
-    if (!m_context->header->ReadFromStream() && !m_context->header->IsValid()) {
+    if (!m_context->header->ReadFromStream() || !m_context->header->IsValid()) {
         return false;
     }
     
+    m_readonly = readonly;
+    if (m_loadmode == LoadMode::Lazy) {
+        return true;
+    }
+    if (m_loadmode == LoadMode::Background) {
+        m_loader = std::thread(&Package::LoadSegments, this);
+        return true;
+    }
+    return this->LoadSegments();
+}
+
+bool Package::LoadSegments()
+{
+    if (m_loaded.load(std::memory_order_acquire)) {
+        if (!m_loadok) {
+            XPACK_ERROR(m_loaderror);
+        }
+        return m_loadok;
+    }
+    
+    std::lock_guard<std::mutex> lock(m_loadmutex);
+    if (!m_loaded.load(std::memory_order_relaxed)) {
+        m_loadok = this->InternalLoadSegments();
+        m_loaderror = m_loadok ? xpack::Error::NoErr : (xpack::Error)xpack::GetLastError();
+        m_loaded.store(true, std::memory_order_release);
+    }
+    else if (!m_loadok) {
+        XPACK_ERROR(m_loaderror); // Loaded by another thread
+    }
+    return m_loadok;
+}
+
+bool Package::InternalLoadSegments()
+{
     if (!m_context->block->ReadFromStream()) {
         return false;
     }
     
-    if (!m_context->hash->ReadFromStream()) {
+    if (!m_context->hash->ReadFromStream(m_readonly)) {
         return false;
     }
     
-    if (!m_context->name->ReadFromStream()) {
+    // Names are only needed for enumeration when lookups verify fingerprints
+    if (!m_context->name->ReadFromStream(m_context->hash->HasFingerprints())) {
         return false;
     }
     
@@ -124,6 +278,9 @@ bool Package::OpenWithStream(Stream *stm, const std::string &path, bool readonly
 
 void Package::Close()
 {
+    if (m_loader.joinable()) {
+        m_loader.join();
+    }
     if (m_modify && m_stream && m_context) {
         this->Flush();
     }
@@ -136,6 +293,9 @@ void Package::Close()
     
     m_context = nullptr;
     m_stream = nullptr;
+    m_generation++;
+    m_loaded = false;
+    m_loadok = false;
 }
 
 bool Package::IsValid()
@@ -149,6 +309,28 @@ void Package::SetNeedCrcVerify(bool need)
     m_needcrc = need;
 }
 
+void Package::SetLoadMode(LoadMode mode)
+{
+    m_loadmode = mode;
+}
+
+void Package::SetAllocPolicy(AllocPolicy policy, uint32_t maxchain)
+{
+    m_allocpolicy   = policy;
+    m_allocmaxchain = maxchain;
+    if (m_context) {
+        m_context->block->SetAllocPolicy(policy, maxchain);
+    }
+}
+
+void Package::SetFeatures(uint32_t features)
+{
+    m_features = features;
+    if (m_context) {
+        m_context->header->SetFeatures(features);
+    }
+}
+
 void Package::SetMetadataSecretKey(const unsigned char *skey, size_t length)
 {
     m_context->crypto->SetSecretKey(skey, length);
@@ -156,6 +338,7 @@ void Package::SetMetadataSecretKey(const unsigned char *skey, size_t length)
 
 void Package::SetSecretKey(const unsigned char *skey, size_t length)
 {
+    m_secretkey.CopyFrom(skey, length);
     m_rc4crypto->SetSecretKey(skey, length);
 }
 
@@ -163,6 +346,9 @@ bool Package::AddEntry(const std::string &name, const torch::Data &data, bool cr
 {
     // get hash -> get block -> write content -> write name
     assert(m_context);
+    if (!this->LoadSegments()) {
+        return false;
+    }
     
     MetaHash *metahash = m_context->hash->AddNew(name);
     if (!metahash) {
@@ -175,12 +361,12 @@ bool Package::AddEntry(const std::string &name, const torch::Data &data, bool cr
         return false;
     }
     
-    int32_t bindex = m_context->block->AllocLinkedBlock((uint32_t)(*processeddata).GetSize());
+    int32_t bindex = m_context->block->AllocLinkedBlock((*processeddata).GetSize());
     assert(bindex >= 0);
     
     // Must before overall-write
     metahash->block_index = bindex; 
-    metahash->unpacked_size = (uint32_t)data.GetSize();
+    metahash->unpacked_size = data.GetSize();
 
     if (!m_context->content->OverallWrite(metahash, *processeddata)) {
         m_context->hash->RemoveByName(name);
@@ -190,15 +376,122 @@ bool Package::AddEntry(const std::string &name, const torch::Data &data, bool cr
     
     m_context->name->AddName(name, metahash);
     m_context->header->UpdateMetadata();
-    m_modify = true;
+    this->MarkModified();
+
+    return true;
+}
 
+bool Package::CopyEntryFrom(Package &other, const std::string &name)
+{
+    assert(m_context && other.m_context);
+    if (!this->LoadSegments() || !other.LoadSegments()) {
+        return false;
+    }
+    
+    MetaHash *source = other.m_context->hash->QueryByName(name);
+    if (!source || source->block_index < 0) {
+        XPACK_ERROR(xpack::Error::NotExists);
+        return false;
+    }
+    // Copied before AddNew, other may be this package
+    MetaHash stored = *source;
+    uint64_t storedsize = 0;
+    for (MetaBlock *metablock = other.m_context->block->GetByIndex(stored.block_index); metablock; ) {
+        storedsize += metablock->size;
+        metablock = other.m_context->block->GetByIndex(metablock->next_index);
+    }
+    
+    MetaHash *metahash = m_context->hash->AddNew(name);
+    if (!metahash) {
+        return false; // Duplicate name
+    }
+    
+    int32_t bindex = m_context->block->AllocLinkedBlock(storedsize);
+    assert(bindex >= 0);
+    
+    metahash->block_index   = bindex;
+    metahash->unpacked_size = stored.unpacked_size;
+    metahash->crc           = stored.crc;
+    metahash->flags        |= stored.flags & (int(HashFlags::CryptoRC4) | int(HashFlags::Compressed));
+    
+    // Encrypted with another key, the stored bytes are decrypted and encrypted again on the way,
+    // rc4 is a stream cipher so the compressed data and crc are kept as they are
+    std::function<void(unsigned char *buffer, size_t size)> convert;
+    arc4_context srcarc4, dstarc4;
+    if ((stored.flags & int(HashFlags::CryptoRC4)) && !m_secretkey.IsEqualDeep(other.m_secretkey)) {
+        arc4_setup(&srcarc4, (unsigned char *)other.m_secretkey.GetBytes(), (int)other.m_secretkey.GetSize());
+        arc4_setup(&dstarc4, (unsigned char *)m_secretkey.GetBytes(), (int)m_secretkey.GetSize());
+        convert = [&srcarc4, &dstarc4](unsigned char *buffer, size_t size) {
+            arc4_crypt(&srcarc4, buffer, (int)size);
+            arc4_crypt(&dstarc4, buffer, (int)size);
+        };
+    }
+    
+    if (!m_context->content->OverallCopy(other.m_context, &stored, bindex, convert)) {
+        m_context->hash->RemoveByName(name);
+        m_context->block->RemoveByIndex(bindex);
+        return false;
+    }
+    
+    m_context->name->AddName(name, metahash);
+    m_context->header->UpdateMetadata();
+    this->MarkModified();
+    
     return true;
 }
 
+bool Package::CreateEntry(const std::string &name, EntryWriter &writer, bool crypto, bool compress)
+{
+    assert(m_context);
+    if (!this->LoadSegments()) {
+        return false;
+    }
+    writer.Abort();
+    if (m_context->hash->IsHashExist(name)) {
+        XPACK_ERROR(xpack::Error::AlreadyExists);
+        return false; // Duplicate name
+    }
+    return writer.Open(this, m_context, name, m_secretkey, m_needcrc, crypto, compress);
+}
+
+bool Package::AddEntryFromFile(const std::string &name, const std::string &path, bool crypto, bool compress)
+{
+    assert(m_context);
+    torch::File f;
+    if (!f.Open(path, "rb")) {
+        XPACK_ERROR(xpack::Error::IO);
+        return false;
+    }
+    
+    EntryWriter writer;
+    if (!this->CreateEntry(name, writer, crypto, compress)) {
+        return false;
+    }
+    
+    torch::Data buffer(64 * 1024);
+    while (true) {
+        size_t rsize = f.Read(buffer.GetBytes(), buffer.GetSize());
+        if (rsize == 0) {
+            break;
+        }
+        if (!writer.Write(buffer.GetBytes(), rsize)) {
+            return false;
+        }
+    }
+    if (!f.IsEOF()) {
+        XPACK_ERROR(xpack::Error::IO);
+        return false; // Reading failed, writer discards the content
+    }
+    return writer.Commit();
+}
+
 bool Package::RemoveEntry(const std::string &name)
 {
     // remove block -> remove hash -> remove name
     assert(m_context);
+    if (!this->LoadSegments()) {
+        return false;
+    }
     
     MetaHash *metahash = m_context->hash->QueryByName(name);
     if (!metahash) {
@@ -209,16 +502,20 @@ bool Package::RemoveEntry(const std::string &name)
     m_context->name->RemoveNameSafely(metahash);
     m_context->hash->RemoveByName(name);
     m_context->header->UpdateMetadata();
-    m_modify = true;
+    this->MarkModified();
     return true;
 }
 
 bool Package::Flush()
 {
     assert(m_context);
+    if (!this->LoadSegments()) {
+        return false;
+    }
     m_context->header->UpdateMetadata();
 
-    // Use before `header`, metaheader & metahashs will be modified
+    // Names are laid out by the features, use before `header`, metaheader & metahashs will be modified
+    m_context->header->ApplyFeatures();
     m_context->name->CleanupNames();
 
     if (!m_context->header->WriteToStream()) {
@@ -243,9 +540,78 @@ bool Package::Flush()
     return true;
 }
 
-uint32_t Package::GetEntrySizeByName(const std::string &name)
+bool Package::Compact(uint64_t budget)
+{
+    assert(m_context);
+    if (!this->LoadSegments()) {
+        return false;
+    }
+    if (m_readonly) {
+        XPACK_ERROR(xpack::Error::NotSupport);
+        return false;
+    }
+    if (m_context->block->GetContentReuser()->Size() == 0) {
+        return true;
+    }
+    // Free extents not written yet are still referenced on disk, moving content into them is unsafe
+    if (m_modify && !this->Flush()) {
+        return false;
+    }
+    
+    // Block offsets change, handles have to be expired
+    bool ok = m_context->block->Compact(budget);
+    this->MarkModified();
+    if (!ok) {
+        return false;
+    }
+    return this->Flush();
+}
+
+uint64_t Package::GetUnusedContentSize()
+{
+    assert(m_context);
+    if (!this->LoadSegments()) {
+        return 0;
+    }
+    return m_context->block->GetContentReuser()->GetTotalSize();
+}
+
+bool Package::Seal()
+{
+    assert(m_context);
+    if (!this->LoadSegments()) {
+        return false;
+    }
+    if (m_readonly || m_context->IsVersion32() || !(m_features & uint32_t(HeaderFeatures::NameFingerprint))) {
+        XPACK_ERROR(xpack::Error::NotSupport);
+        return false;
+    }
+    // A package written without fingerprints gets them now, as the seal is verified by them
+    m_context->header->ApplyFeatures();
+    if (!m_context->hash->Seal()) {
+        return false;
+    }
+    
+    // Entries are unchanged, handles stay valid
+    m_modify = true;
+    return true;
+}
+
+bool Package::IsSealed()
 {
     assert(m_context);
+    if (!this->LoadSegments()) {
+        return false;
+    }
+    return m_context->hash->IsSealed();
+}
+
+uint64_t Package::GetEntrySizeByName(const std::string &name)
+{
+    assert(m_context);
+    if (!this->LoadSegments()) {
+        return 0;
+    }
 
     MetaHash *metahash = m_context->hash->QueryByName(name);
     if (!metahash || metahash->block_index<0) {
@@ -253,17 +619,20 @@ uint32_t Package::GetEntrySizeByName(const std::string &name)
     }
 
     MetaBlock *metablock = m_context->block->GetByIndex(metahash->block_index);
-    size_t size = 0;
+    uint64_t size = 0;
     while (metablock) {
         size += metablock->size;
         metablock = m_context->block->GetByIndex(metablock->next_index);
     }
-    return (uint32_t)size;
+    return size;
 }
 
-uint32_t Package::GetUnpackedEntrySizeByName(const std::string &name)
+uint64_t Package::GetUnpackedEntrySizeByName(const std::string &name)
 {
     assert(m_context);
+    if (!this->LoadSegments()) {
+        return 0;
+    }
     
     MetaHash *metahash = m_context->hash->QueryByName(name);
     if (!metahash || metahash->block_index<0) {
@@ -276,6 +645,9 @@ uint32_t Package::GetUnpackedEntrySizeByName(const std::string &name)
 std::string Package::GetEntryStringByName(const std::string &name)
 {
     assert(m_context);
+    if (!this->LoadSegments()) {
+        return std::string();
+    }
     torch::Data buf;
     MetaHash *metahash = m_context->hash->QueryByName(name);
     if (!metahash || metahash->block_index<0) {
@@ -293,6 +665,9 @@ std::string Package::GetEntryStringByName(const std::string &name)
 torch::Data Package::GetEntryDataByName(const std::string &name)
 {
     assert(m_context);
+    if (!this->LoadSegments()) {
+        return torch::Data::Null;
+    }
     torch::Data rdata;
     MetaHash *metahash = m_context->hash->QueryByName(name);
     if (!metahash || metahash->block_index<0) {
@@ -310,6 +685,9 @@ torch::Data Package::GetEntryDataByName(const std::string &name)
 bool Package::GetEntryDataByName(const std::string &name, torch::Data &outdata)
 {
     assert(m_context);
+    if (!this->LoadSegments()) {
+        return false;
+    }
     MetaHash *metahash = m_context->hash->QueryByName(name);
     if (!metahash || metahash->block_index<0) {
         return false;
@@ -320,42 +698,312 @@ bool Package::GetEntryDataByName(const std::string &name, torch::Data &outdata)
     return this->ProcessingAfterReading(metahash, outdata);
 }
 
+bool Package::GetEntryView(const std::string &name, EntryView &outview)
+{
+    assert(m_context);
+    if (!this->LoadSegments()) {
+        return false;
+    }
+    outview.Clear();
+    MetaHash *metahash = m_context->hash->QueryByName(name);
+    if (!metahash || metahash->block_index<0) {
+        return false;
+    }
+    if (metahash->flags & (int(HashFlags::Compressed) | int(HashFlags::CryptoRC4))) {
+        XPACK_ERROR(xpack::Error::NotSupport);
+        return false;
+    }
+    if (!m_context->content->OverallView(metahash, outview)) {
+        outview.Clear();
+        return false;
+    }
+    
+    // Crc32 check without copy
+    if (m_needcrc) {
+        torch::crypto::Crc32 crc32;
+        for (auto &span : outview.GetSpans()) {
+            crc32.ComputeBlock((const unsigned char*)span.data, span.size);
+        }
+        if (metahash->crc != crc32.GetCrc32()) {
+            XPACK_ERROR(xpack::Error::CRC);
+            outview.Clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+EntryView Package::GetEntryView(const std::string &name)
+{
+    EntryView view;
+    this->GetEntryView(name, view);
+    return view;
+}
+
+bool Package::GetEntryRange(const std::string &name, uint64_t offset, size_t length, torch::Data &outdata)
+{
+    assert(m_context);
+    if (!this->LoadSegments()) {
+        return false;
+    }
+    MetaHash *metahash = m_context->hash->QueryByName(name);
+    if (!metahash || metahash->block_index<0) {
+        return false;
+    }
+    if (offset > metahash->unpacked_size) {
+        XPACK_ERROR(xpack::Error::Format);
+        return false;
+    }
+    length = (size_t)std::min((uint64_t)length, metahash->unpacked_size - offset);
+    
+    if (!(metahash->flags & (int(HashFlags::Compressed) | int(HashFlags::CryptoRC4)))) {
+        return m_context->content->RangeRead(metahash, offset, length, outdata);
+    }
+    
+    // Not seekable in place, fall back to the streaming reader
+    EntryReader reader;
+    if (!reader.Open(m_context, metahash, m_secretkey, false) || !reader.Seek(offset)) {
+        return false;
+    }
+    outdata.ReSize(length);
+    size_t readsize = 0;
+    while (readsize < length) {
+        int64_t rsize = reader.Read((char *)outdata.GetBytes() + readsize, length - readsize);
+        if (rsize <= 0) {
+            return false;
+        }
+        readsize += rsize;
+    }
+    return true;
+}
+
+bool Package::GetEntries(const std::vector<std::string> &names, EntryCallback callback)
+{
+    assert(m_context);
+    if (!this->LoadSegments()) {
+        return false;
+    }
+    BatchReader reader(m_context, m_secretkey, m_needcrc);
+    return reader.Read(names, callback);
+}
+
+bool Package::Resolve(const std::string &name, EntryHandle &outhandle)
+{
+    assert(m_context);
+    outhandle = EntryHandle();
+    if (!this->LoadSegments()) {
+        return false;
+    }
+    MetaHash *metahash = m_context->hash->QueryByName(name);
+    if (!metahash || metahash->block_index<0) {
+        return false;
+    }
+    this->MakeHandle(metahash, outhandle);
+    return true;
+}
+
+EntryHandle Package::Resolve(const std::string &name)
+{
+    EntryHandle handle;
+    this->Resolve(name, handle);
+    return handle;
+}
+
+bool Package::Resolve(const std::vector<std::string> &names, std::vector<EntryHandle> &outhandles)
+{
+    assert(m_context);
+    outhandles.assign(names.size(), EntryHandle());
+    if (!this->LoadSegments()) {
+        return false;
+    }
+    
+    std::vector<MetaHash*> metahashs;
+    bool ok = m_context->hash->QueryByNames(names, metahashs) == names.size();
+    for (size_t i = 0; i < names.size(); i++) {
+        MetaHash *metahash = metahashs[i];
+        if (!metahash || metahash->block_index<0) {
+            XPACK_ERROR(xpack::Error::NotExists);
+            ok = false;
+            continue;
+        }
+        this->MakeHandle(metahash, outhandles[i]);
+    }
+    return ok;
+}
+
+void Package::MakeHandle(const MetaHash *metahash, EntryHandle &outhandle)
+{
+    uint64_t size = 0;
+    MetaBlock *metablock = m_context->block->GetByIndex(metahash->block_index);
+    while (metablock) {
+        size += metablock->size;
+        metablock = m_context->block->GetByIndex(metablock->next_index);
+    }
+    
+    outhandle.m_package    = this;
+    outhandle.m_generation = m_generation;
+    outhandle.m_metahash   = *metahash;
+    outhandle.m_size       = size;
+}
+
+bool Package::IsHandleValid(const EntryHandle &handle)
+{
+    return m_context && handle.m_package == this && handle.m_generation == m_generation;
+}
+
+uint64_t Package::GetEntrySizeByHandle(const EntryHandle &handle)
+{
+    if (!this->IsHandleValid(handle)) {
+        XPACK_ERROR(xpack::Error::InvalidHandle);
+        return 0;
+    }
+    return handle.m_size;
+}
+
+uint64_t Package::GetUnpackedEntrySizeByHandle(const EntryHandle &handle)
+{
+    if (!this->IsHandleValid(handle)) {
+        XPACK_ERROR(xpack::Error::InvalidHandle);
+        return 0;
+    }
+    return handle.m_metahash.unpacked_size;
+}
+
+bool Package::GetEntryDataByHandle(const EntryHandle &handle, torch::Data &outdata)
+{
+    if (!this->IsHandleValid(handle)) {
+        XPACK_ERROR(xpack::Error::InvalidHandle);
+        return false;
+    }
+    MetaHash metahash = handle.m_metahash;
+    if (!m_context->content->OverallRead(&metahash, outdata)) {
+        return false;
+    }
+    return this->ProcessingAfterReading(&metahash, outdata);
+}
+
+bool Package::OpenEntryByHandle(const EntryHandle &handle, EntryReader &reader)
+{
+    reader.Close();
+    if (!this->IsHandleValid(handle)) {
+        XPACK_ERROR(xpack::Error::InvalidHandle);
+        return false;
+    }
+    return reader.Open(m_context, &handle.m_metahash, m_secretkey, m_needcrc);
+}
+
+bool Package::OpenEntry(const std::string &name, EntryReader &reader)
+{
+    assert(m_context);
+    if (!this->LoadSegments()) {
+        return false;
+    }
+    reader.Close();
+    MetaHash *metahash = m_context->hash->QueryByName(name);
+    if (!metahash || metahash->block_index<0) {
+        return false;
+    }
+    return reader.Open(m_context, metahash, m_secretkey, m_needcrc);
+}
+
 bool Package::IsEntryExist(const std::string &name)
 {
     assert(m_context);
+    if (!this->LoadSegments()) {
+        return false;
+    }
     return m_context->hash->IsHashExist(name);
 }
 
+size_t Package::AreEntriesExist(const std::vector<std::string> &names, std::vector<bool> &outexists)
+{
+    assert(m_context);
+    outexists.assign(names.size(), false);
+    if (!this->LoadSegments()) {
+        return 0;
+    }
+    
+    std::vector<MetaHash*> metahashs;
+    size_t found = m_context->hash->QueryByNames(names, metahashs);
+    for (size_t i = 0; i < names.size(); i++) {
+        outexists[i] = metahashs[i] != nullptr;
+    }
+    return found;
+}
+
+bool Package::ListPrefix(const std::string &prefix, std::function<bool(const std::string &name)> callback)
+{
+    assert(m_context);
+    if (!this->LoadSegments()) {
+        return false;
+    }
+    return m_context->name->ForeachNameWithPrefix(prefix, callback);
+}
+
+std::vector<std::string> Package::ListPrefix(const std::string &prefix)
+{
+    std::vector<std::string> names;
+    this->ListPrefix(prefix, [&names](const std::string &name) {
+        names.push_back(name);
+        return true;
+    });
+    return names;
+}
+
+std::vector<std::string> Package::ListDirectory(const std::string &dir)
+{
+    std::vector<std::string> names;
+    assert(m_context);
+    if (!this->LoadSegments()) {
+        return names;
+    }
+    m_context->name->ForeachChildName(dir, [&names](const std::string &name, bool isdir) {
+        names.push_back(name);
+        return true;
+    });
+    return names;
+}
+
 bool Package::ForeachEntryNames(std::function<bool(const std::string &name)> callback)
 {
     assert(m_context);
-    HashSegment::MetaHashMap *hashmap = m_context->hash->GetMetaHashMap();
-    for (auto x : hashmap->GetIterator()) {
-        MetaHash *metahash = x.second;
+    if (!this->LoadSegments() || !m_context->name->LoadDeferred()) {
+        return false;
+    }
+    // Decoding names one by one would decode a whole bucket each time
+    if (m_context->name->IsFrontCoded()) {
+        return m_context->name->ForeachNameWithPrefix("", callback);
+    }
+    return m_context->hash->ForeachMetaHash([this, &callback](MetaHash *metahash) {
         assert(!(metahash->flags & int(HashFlags::Unused)));
         if (metahash->flags & int(HashFlags::Conflict)) {
-            continue;
+            return true;
         }
-        if (!callback(m_context->name->GetName(metahash))) {
-            return false;
-        }
-    }
-    return true;
+        return callback(m_context->name->GetName(metahash));
+    });
 }
 
 std::vector<std::string> Package::GetEntryNames()
 {
     assert(m_context);
     std::vector<std::string> names;
-    HashSegment::MetaHashMap *hashmap = m_context->hash->GetMetaHashMap();
-    for (auto x : hashmap->GetIterator()) {
-        MetaHash *metahash = x.second;
+    if (!this->LoadSegments() || !m_context->name->LoadDeferred()) {
+        return names;
+    }
+    if (m_context->name->IsFrontCoded()) {
+        m_context->name->ForeachNameWithPrefix("", [&names](const std::string &name) {
+            names.push_back(name);
+            return true;
+        });
+        return names;
+    }
+    m_context->hash->ForeachMetaHash([this, &names](MetaHash *metahash) {
         assert(!(metahash->flags & int(HashFlags::Unused)));
-        if (metahash->flags & int(HashFlags::Conflict)) {
-            continue;
+        if (!(metahash->flags & int(HashFlags::Conflict))) {
+            names.push_back(m_context->name->GetName(metahash));
         }
-        names.push_back(m_context->name->GetName(metahash));
-    }
+        return true;
+    });
     return names;
 }
 
@@ -367,6 +1015,9 @@ size_t Package::GetPackageSize()
 
 Context* Package::GetContxt()
 {
+    if (m_context) {
+        this->LoadSegments(); // Callers use the segments directly
+    }
     return m_context;
 }
 
@@ -375,6 +1026,12 @@ Stream* Package::GetStream()
     return m_stream;
 }
 
+uint16_t Package::GetFormatVersion()
+{
+    assert(m_context);
+    return m_context->GetVersion();
+}
+
 std::string Package::GetVersion()
 {
     return torch::String::Format("%d.%d", (xpack::VERSION >> 8) & 0x00ff, xpack::VERSION & 0x00ff);
@@ -407,16 +1064,19 @@ const torch::Data* Package::ProcessingBeforeWriting(MetaHash *metahash, const to
 
 bool Package::ProcessingAfterReading(MetaHash *metahash, torch::Data &data)
 {
+    // Reading may run on several threads at once, so nothing here touches
+    // the members: the rc4 context is copied, the scratch buffer is per call
     if (metahash->flags & (int)HashFlags::CryptoRC4) {
-        m_rc4crypto->CryptoNoCopy(data);
+        torch::crypto::RC4 rc4crypto = *m_rc4crypto;
+        rc4crypto.CryptoNoCopy(data);
     }
 
     if (metahash->flags & (int)HashFlags::Compressed) {
-        m_compressbuffer.ReSize(metahash->unpacked_size);
-        if (!torch::compress::ZipUtil::Decompress(data, m_compressbuffer)) {
+        torch::Data decompressbuffer(metahash->unpacked_size);
+        if (!torch::compress::ZipUtil::Decompress(data, decompressbuffer)) {
             XPACK_ERROR(xpack::Error::Compress); return false;
         }
-        data.CopyFrom(m_compressbuffer);
+        data.CopyFrom(decompressbuffer);
     }
     
     // Crc32 check at last
@@ -429,6 +1089,12 @@ bool Package::ProcessingAfterReading(MetaHash *metahash, torch::Data &data)
     return true;
 }
 
+void Package::MarkModified()
+{
+    m_modify = true;
+    m_generation++;
+}
+
 // PackageHelper
 
 bool PackageHelper::MakeNew(const std::string &path)
@@ -454,7 +1120,7 @@ bool PackageHelper::AddTo(Package &package, const std::string &path, const std::
     if (force) {
         package.RemoveEntry(key);
     }
-    return package.AddEntry(key, torch::File::GetBytes(path));
+    return package.AddEntryFromFile(key, path);
 }
 
 bool PackageHelper::ExtractTo(const std::string &package, const std::string &pathto, bool force, StatusCallback callback)
@@ -470,10 +1136,11 @@ bool PackageHelper::ExtractTo(Package &package, const std::string &pathto, bool
 {
     bool ok = true;
     torch::FileSystem::MakeDeepDirectory(pathto);
+    torch::Data buffer(64 * 1024);
 
     package.ForeachEntryNames([&](const std::string &name)->bool {
         torch::File f;
-        torch::Data d;
+        EntryReader reader;
         torch::Path p = torch::Path(pathto).Append(name);
         ok = true;
 
@@ -485,8 +1152,16 @@ bool PackageHelper::ExtractTo(Package &package, const std::string &pathto, bool
         }
 
         ok = ok ? f.Open(p.GetPath(), "wb") : ok;
-        ok = ok ? package.GetEntryDataByName(name, d) : ok;
-        ok = ok ? f.Write(d) == d.GetSize() : ok;
+        ok = ok ? package.OpenEntry(name, reader) : ok;
+        // Stream the entry, large entries are never held in memory as a whole
+        while (ok) {
+            int64_t rsize = reader.Read(buffer.GetBytes(), buffer.GetSize());
+            if (rsize <= 0) {
+                ok = rsize == 0;
+                break;
+            }
+            ok = f.Write(buffer.GetBytes(), (size_t)rsize) == (size_t)rsize;
+        }
         if (callback) {
             if (!callback(name, ok)) {
                 return false;
@@ -513,13 +1188,11 @@ bool PackageHelper::Merge(const std::string &main, const std::string &other, boo
 bool PackageHelper::Merge(Package &main, Package &other, bool force, StatusCallback callback)
 {
     bool ok = true;
-    torch::Data buffer;
     other.ForeachEntryNames([&](const std::string &name){
         if (force && main.IsEntryExist(name)) {
             main.RemoveEntry(name);
         }
-        other.GetEntryDataByName(name, buffer.Free());
-        ok = main.AddEntry(name, buffer);
+        ok = main.CopyEntryFrom(other, name);
         if (callback) {
             if (!callback(name, ok)) {
                 return false;
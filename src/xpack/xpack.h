@@ -12,10 +12,14 @@
 #include <stdio.h>
 #include <string>
 #include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
 #include "torch/torch.h"
 #include "xpack-def.h"
 #include "xpack-base.h"
 #include "xpack-context.h"
+#include "xpack-entry.h"
 
 namespace xpack {
     class SignatureSegment;
@@ -26,6 +30,98 @@ namespace xpack {
     class Stream;
     class Context;
     
+    /*
+     * 存储项的只读视图(零拷贝)
+     * 说明：
+     *  - 数据直接指向流内部(如内存映射)，不产生任何拷贝
+     *  - 存储项只有一个block时只有一个片段，分块存储时按顺序包含多个片段
+     * 注意：
+     *  - 视图只在包未关闭且未被修改期间有效
+     */
+    class EntryView {
+    public:
+        typedef struct {
+            const void *data;
+            size_t      size;
+        } Span;
+        
+        EntryView();
+        
+        bool IsNull() const;
+        
+        /*
+         * 是否是连续的数据(只有一个片段)，连续时可直接使用GetBytes()
+         */
+        bool IsContiguous() const;
+        
+        /*
+         * 获得第一个片段的数据指针，若为空则返回nullptr
+         */
+        const void* GetBytes() const;
+        
+        /*
+         * 获得所有片段的总大小
+         */
+        size_t GetSize() const;
+        
+        const std::vector<Span>& GetSpans() const;
+        
+        void Append(const void *data, size_t size);
+        void Clear();
+        
+    private:
+        std::vector<Span> m_spans;
+        size_t            m_size;
+    };
+    
+    class Package;
+    
+    /*
+     * 存储项句柄(通过Package::Resolve获得)
+     * 说明：
+     *  - 保存解析后的存储项信息(hashid、block链头、标记、尺寸)，通过句柄读取时不再计算hash，也不再比较名字
+     *  - 适用于需要反复读取同一批存储项的情况，加载时解析一次，之后一直使用句柄
+     * 注意：
+     *  - 句柄只在包未关闭且未被修改期间有效，失效后使用句柄会返回Error::InvalidHandle
+     */
+    class EntryHandle {
+    public:
+        EntryHandle();
+        
+        bool IsNull() const;
+        
+        uint32_t GetHashId() const;
+        
+        /*
+         * 获得存储项在包内的大小，以及解包后的大小(解析时记录)
+         */
+        uint64_t GetSize() const;
+        uint64_t GetUnpackedSize() const;
+        
+        bool IsCompressed() const;
+        bool IsCrypto() const;
+        
+    private:
+        friend class Package;
+        const Package *m_package;
+        uint32_t       m_generation;
+        MetaHash       m_metahash;
+        uint64_t       m_size;
+    };
+    
+    /*
+     * 资源包
+     * 说明：
+     *  - 以只读模式打开的包支持多线程并发读取，以下接口可以在多个线程中同时调用：
+     *    IsEntryExist, GetEntrySizeByName, GetUnpackedEntrySizeByName,
+     *    GetEntryDataByName, GetEntryStringByName, GetEntryView, GetEntryRange, GetEntries,
+     *    Resolve, GetEntryDataByHandle, GetEntrySizeByHandle, GetUnpackedEntrySizeByHandle, AreEntriesExist,
+     *    ListPrefix, ListDirectory
+     * 注意：
+     *  - 并发读取期间不可调用修改包的接口(AddEntry/RemoveEntry/Flush等)以及密钥设置接口
+     *  - 自定义的Stream需要保证GetContent可以并发调用(FdStream/FileStream/MmapStream均已支持)
+     *  - 错误代码是线程独立的，在发生错误的线程中通过xpack::GetLastError()获取
+     */
     class Package {
     public:
         
@@ -35,23 +131,29 @@ namespace xpack {
         Package& operator=(const Package &) = delete;
 
         /*
-         * 打开包文件(使用xpack::FileStream)
+         * 打开包文件(默认使用xpack::FdStream)
          * 参数：
          *  - path: 包的路径
          *  - readonly: 是否以只读模式打开包，若以只读方式打开则所有修改操作全部无效
+         *  - type: 使用的流类型
+         *    StreamType::Fd使用位置读写流(xpack::FdStream)
+         *    StreamType::File使用stdio文件流(xpack::FileStream)
+         *    StreamType::Mmap使用内存映射流(xpack::MmapStream)，只能以只读模式打开
          * 注意：包必须存在，而且必须是合法的包，若想构建一个新包请使用OpenNew()
          */
-        bool Open(const std::string &path, bool readonly = true);
+        bool Open(const std::string &path, bool readonly = true, StreamType type = StreamType::Fd);
         
         /*
-         * 创建并打开一个新的包(使用xpack::FileStream)
+         * 创建并打开一个新的包(使用xpack::FdStream)
          * 参数：
          *  - path: 包的路径
+         *  - version: 包的格式版本，默认为xpack::VERSION(64位)，需要兼容旧版本时可使用xpack::VERSION_32
          * 注意：
          *  - 若文件存在且非空，则会在文件内部添加寄生包，否则创建一个空的包
          *  - 目录必须存在(文件可不存在)，否则会创建失败
+         *  - xpack::VERSION_32格式的包及其中的存储项不能超过4GB，超出时写入会失败
          */
-        bool OpenNew(const std::string &path);
+        bool OpenNew(const std::string &path, uint16_t version = xpack::VERSION);
 
         /*
          * 打开包(自定义输入输出流)
@@ -60,7 +162,7 @@ namespace xpack {
          *  - path: 包的路径
          *  - readonly: 是否以只读模式打开包，若以只读方式打开则所有修改操作全部无效
          * 注意：
-         *  - 谨慎使用自定义输入输出流，参考FileStream实现
+         *  - 谨慎使用自定义输入输出流，参考FdStream实现
          *  - 包必须存在，而且必须是合法的包，若想构建一个新包请使用OpenNew()
          */
         bool OpenWithStream(Stream *stm, const std::string &path, bool readonly = true);
@@ -89,6 +191,45 @@ namespace xpack {
          *  - 禁用后，对包的实际内容不会产生影响，只是不会减少包占用磁盘的体积大小(文件末尾会存在无效数据)
          */
         void SetNeedAutoShrink(bool need);
+        
+        /*
+         * 设置打开包时元数据(Block/Hash/Name区段)的加载方式，默认LoadMode::Eager
+         * 参数：
+         *  - LoadMode::Eager: Open时读取全部元数据
+         *  - LoadMode::Lazy: Open时只校验签名和头部，第一次访问存储项时再读取
+         *  - LoadMode::Background: Open时只校验签名和头部，同时启动后台线程读取，访问存储项时会等待读取完成
+         * 说明：
+         *  - 需要在Open之前设置，适用于启动时需要打开多个包的情况
+         *  - 延迟加载失败时(如格式错误)，访问存储项的接口均返回失败，错误代码与Eager模式下Open返回的一致
+         */
+        void SetLoadMode(LoadMode mode);
+
+        /*
+         * 设置写入时Content区域的分配策略，默认AllocPolicy::SmallestFirst
+         * 参数：
+         *  - AllocPolicy::SmallestFirst: 优先拼接小尺寸的可重用区域，磁盘占用最小，但大文件可能分散为很多块
+         *  - AllocPolicy::BestFit: 只使用能容纳整个内容的单个可重用区域，没有则追加到末尾，每个存储项连续存储
+         *  - AllocPolicy::BoundedChain: 先尝试BestFit，否则从大到小拼接可重用区域，每个存储项最多maxchain块
+         * 说明：
+         *  - 对读取延迟敏感(如机械硬盘)时使用BestFit/BoundedChain，会以少量磁盘空间换取更少的寻道
+         *  - 可以在Open前后设置，只影响之后的写入
+         */
+        void SetAllocPolicy(AllocPolicy policy, uint32_t maxchain = 4);
+        
+        /*
+         * 设置写入0x000A格式时使用的可选特性位，默认xpack::DEFAULT_FEATURES(全部开启)
+         * 参数：
+         *  - features: HeaderFeatures的组合，如uint32_t(HeaderFeatures::SortedHash) | uint32_t(HeaderFeatures::NameFingerprint)
+         *    - SortedHash: Hash区段有序，只读打开时原地二分查找
+         *    - NameFingerprint: 写入名字指纹，只读打开时延迟读取Name区段，Seal需要此特性
+         *    - SortedNames: Name区段按名字顺序排列，建立名字索引时不需要比较字符串
+         *    - FrontCodedNames: Name区段前缀压缩，体积更小，但只读查询名字时需要按桶解码(会自动加上SortedNames)
+         * 说明：
+         *  - 可以在Open前后设置，在下次写入(Flush)时生效，已有的包也会按新的设置重写
+         *  - 关闭NameFingerprint时会解除封存，Seal返回false(Error::NotSupport)
+         *  - 0x0009格式没有特性位，不受影响
+         */
+        void SetFeatures(uint32_t features);
 
         /*
          * 设置元数据加密密钥(若不设置也有默认的密钥)
@@ -121,6 +262,43 @@ namespace xpack {
          */
         bool AddEntry(const std::string &name, const torch::Data &data, bool crypto = false, bool compress = false);
 
+        /*
+         * 从另一个包中复制存储项
+         * 参数：
+         *  - other: 源包，不会被改变
+         *  - name: 存储项名，复制后名字不变
+         * 返回值：
+         *  - 源包中不存在(Error::NotExists)或本包中已存在同名项(Error::AlreadyExists)时返回false
+         * 说明：
+         *  - 直接复制存储的原始数据以及crc、unpacked_size和压缩/加密标记，不解密/解压
+         *  - 按block分段复制，内存占用固定，与存储项的大小无关
+         *  - 两个包的内容密钥(SetSecretKey)不同时，加密的存储项在复制过程中换用本包的密钥重新加密，压缩数据保持不变
+         */
+        bool CopyEntryFrom(Package &other, const std::string &name);
+
+        /*
+         * 创建存储项，进行流式写入
+         * 参数：
+         *  - name: 存储在包内的项名
+         *  - writer: 存储项写入器，通过Write追加数据，Commit后存储项才会加入包中
+         *  - crypto: 是否对文件内容加密
+         *  - compress: 是否压缩
+         * 说明：
+         *  - 适用于大文件，数据边写入边申请block，内存占用与文件大小无关
+         * 注意：
+         *  - 若存在同名文件会创建失败
+         *  - 写入器提交前不要调用Flush()，也不要同时使用多个写入器
+         */
+        bool CreateEntry(const std::string &name, EntryWriter &writer, bool crypto = false, bool compress = false);
+
+        /*
+         * 将文件内容流式写入包内(基于CreateEntry实现)
+         * 参数：
+         *  - name: 存储在包内的项名
+         *  - path: 要写入的文件路径
+         */
+        bool AddEntryFromFile(const std::string &name, const std::string &path, bool crypto = false, bool compress = false);
+
         /*
          * 从包内删除数据项
          * 参数：
@@ -137,6 +315,42 @@ namespace xpack {
          * 注意：此方法性能不高，不要频繁调用
          */
         bool Flush();
+        
+        /*
+         * 原地整理包：逐步将末尾的内容移入前面的可重用区域，删除末尾的无效数据，最后写入并减小包的体积
+         * 参数：
+         *  - budget: 本次最多移动的内容字节数(至少移动一个块)，0表示整理完为止
+         * 返回值：
+         *  - bool:是否成功，只读打开时返回false
+         * 说明：
+         *  - 存储项的内容原样移动(不解密/解压/重新计算CRC)，不需要临时文件，适合在空闲时分多次调用
+         *  - 有未写入的修改时先写入包信息，内容只会移入磁盘上未被引用的区域，写入包信息之前中断也不会损坏原有内容
+         *  - 每次调用结束时写入包信息(Flush)，之前获得的EntryHandle失效
+         *  - 末尾的内容放不下时会拆分到多个可重用区域，存储项的Block链可能变长
+         *  - GetUnusedContentSize()为0时整理完成
+         */
+        bool Compact(uint64_t budget = 0);
+        
+        /*
+         * 获得Content区段中可重用的无效数据大小(单位Byte)
+         */
+        uint64_t GetUnusedContentSize();
+        
+        /*
+         * 封存包：在所有存储项名上构建完美哈希并随包写入(HeaderFeatures::PerfectHash)
+         * 返回值：
+         *  - bool:是否成功，只读打开、0x0009格式或空包时返回false
+         * 说明：
+         *  - 适用于构建后不再修改的发布包，之后只读打开时每次查询只需一次探测，不再经过hashid冲突链
+         *  - 与AddEntry等一致，在Flush或关闭包时写入
+         *  - 之后再增删存储项会自动解除封存，需要重新调用Seal()
+         */
+        bool Seal();
+        
+        /*
+         * 包是否已封存
+         */
+        bool IsSealed();
 
         /*
          * 获得包内存储项的尺寸大小(单位:Byte)
@@ -145,7 +359,7 @@ namespace xpack {
          * 返回值：
          *  - 若未找到则返回0
          */
-        uint32_t GetEntrySizeByName(const std::string &name);
+        uint64_t GetEntrySizeByName(const std::string &name);
         
         /*
          * 获得文件的解包后的尺寸(即原文件尺寸大小)
@@ -156,7 +370,7 @@ namespace xpack {
          * 说明：
          *  - 压缩会造成包内文件大小的改变
          */
-        uint32_t GetUnpackedEntrySizeByName(const std::string &name);
+        uint64_t GetUnpackedEntrySizeByName(const std::string &name);
 
         /*
          * 从包内读取文件内容转为字符串
@@ -180,6 +394,110 @@ namespace xpack {
         bool GetEntryDataByName(const std::string &name, torch::Data &outdata);
         torch::Data GetEntryDataByName(const std::string &name);
         
+        /*
+         * 获得存储项内容的只读视图(零拷贝)
+         * 参数：
+         *  - name: 存储在包内的项名
+         *  - outview: 获取的数据视图，分块存储的存储项会包含多个片段
+         * 返回值：
+         *  - bool:是否成功，错误信息使用xpack::GetLastError()获取
+         * 注意：
+         *  - 只支持未压缩且未加密的存储项，否则返回Error::NotSupport
+         *  - 流需要支持直接访问数据(如StreamType::Mmap)，否则返回Error::NotSupport
+         *  - 开启CRC校验时会遍历一次数据进行校验，但不会拷贝数据
+         *  - 视图只在包未关闭且未被修改期间有效
+         */
+        bool GetEntryView(const std::string &name, EntryView &outview);
+        EntryView GetEntryView(const std::string &name);
+        
+        /*
+         * 从包内读取存储项指定范围的内容
+         * 参数：
+         *  - name: 存储在包内的项名
+         *  - offset: 起始位置(解包后的数据位置，64位，32位平台上也可以定位到4GB之后)
+         *  - length: 读取长度，超出存储项末尾的部分会被截断
+         *  - outdata: 获取的内容，其size会被调整为实际读取的长度
+         * 返回值：
+         *  - offset超出存储项大小时返回false
+         * 说明：
+         *  - 未压缩未加密的存储项只读取覆盖该范围的block
+         *  - 加密的存储项需要推进RC4密钥流，压缩的存储项需要从头解压，代价与offset成正比
+         *  - 只读取了部分内容，不进行CRC校验
+         */
+        bool GetEntryRange(const std::string &name, uint64_t offset, size_t length, torch::Data &outdata);
+        
+        /*
+         * 批量读取存储项内容
+         * 参数：
+         *  - names: 存储在包内的项名列表
+         *  - callback: 每个存储项调用一次(在调用线程中执行)，status表示是否读取成功，失败时data为空，返回false则中断读取
+         * 返回值：
+         *  - 全部读取成功返回true，有存储项读取失败或被callback中断返回false
+         * 说明：
+         *  - 先解析所有项名，再按block在文件中的偏移排序，相邻的block合并为一次顺序读取
+         *  - 解密/解压/CRC校验在后台线程中进行，与读取重叠
+         *  - callback的调用顺序为读取完成的顺序，与names的顺序无关
+         */
+        typedef std::function<bool(const std::string &name, const torch::Data &data, bool status)> EntryCallback;
+        bool GetEntries(const std::vector<std::string> &names, EntryCallback callback);
+        
+        /*
+         * 解析存储项，获得句柄
+         * 参数：
+         *  - name: 存储在包内的项名
+         *  - outhandle: 获得的句柄，失败时为空句柄
+         * 返回值：
+         *  - bool:是否成功，存储项不存在时返回false(Error::NotExists)
+         */
+        bool Resolve(const std::string &name, EntryHandle &outhandle);
+        EntryHandle Resolve(const std::string &name);
+        
+        /*
+         * 批量解析存储项
+         * 参数：
+         *  - names: 存储在包内的项名
+         *  - outhandles: 与names一一对应，不存在的项为空句柄
+         * 返回值：
+         *  - bool:是否全部解析成功，有不存在的项时返回false(Error::NotExists)
+         * 说明：
+         *  - 按组计算hashid(或名字指纹)并预取索引后再查找，大量查询时比逐个调用Resolve快
+         */
+        bool Resolve(const std::vector<std::string> &names, std::vector<EntryHandle> &outhandles);
+        
+        /*
+         * 句柄是否有效(由此包解析，且之后包未被修改、关闭)
+         */
+        bool IsHandleValid(const EntryHandle &handle);
+        
+        /*
+         * 通过句柄获得存储项的大小，句柄无效时返回0
+         */
+        uint64_t GetEntrySizeByHandle(const EntryHandle &handle);
+        uint64_t GetUnpackedEntrySizeByHandle(const EntryHandle &handle);
+        
+        /*
+         * 通过句柄读取存储项内容，与GetEntryDataByName一致
+         * 返回值：
+         *  - bool:读取是否成功，句柄无效时返回false(Error::InvalidHandle)
+         */
+        bool GetEntryDataByHandle(const EntryHandle &handle, torch::Data &outdata);
+        
+        /*
+         * 通过句柄打开存储项进行流式读取，与OpenEntry一致
+         */
+        bool OpenEntryByHandle(const EntryHandle &handle, EntryReader &reader);
+        
+        /*
+         * 打开存储项，进行流式读取
+         * 参数：
+         *  - name: 存储在包内的项名
+         *  - reader: 存储项读取器，可通过Read/Seek/Tell按需读取
+         * 说明：
+         *  - 适用于大文件，不会一次性将整个存储项读入内存
+         *  - 读取器只在包未关闭且未被修改期间有效
+         */
+        bool OpenEntry(const std::string &name, EntryReader &reader);
+        
         /*
          * 判断包内是否存在指定的存储项
          * 参数：
@@ -187,12 +505,25 @@ namespace xpack {
          */
         bool IsEntryExist(const std::string &name);
         
+        /*
+         * 批量判断包内是否存在指定的存储项
+         * 参数：
+         *  - names: 存储在包内的项名
+         *  - outexists: 与names一一对应
+         * 返回值：
+         *  - 存在的存储项数量
+         * 说明：
+         *  - 与Resolve(names, outhandles)相同的批量查找方式，适合大量的依赖检查
+         */
+        size_t AreEntriesExist(const std::vector<std::string> &names, std::vector<bool> &outexists);
+        
         /*
          * 遍历存储项名
          * 参数：
          *  - callback: 每个存储项调用一次，若返回false，则会中断遍历
          * 返回值：
          *  - 若遍历过程中callback返回false，则本接口也会返回false，否则返回true
+         *  - 名字区域读取失败时返回false(xpack::GetLastError()获取错误代码)
          * 注意：
          *  - 不可以在遍历过程中中删除进行操作
          */
@@ -200,9 +531,32 @@ namespace xpack {
         
         /*
          * 获得所有存储项名
+         * 说明：名字区域读取失败时返回空数组(xpack::GetLastError()获取错误代码)
          */
         std::vector<std::string> GetEntryNames();
         
+        /*
+         * 按名字顺序遍历以prefix开头的存储项名
+         * 参数：
+         *  - prefix: 名字前缀，如"textures/ui/"，空串表示所有存储项
+         *  - callback: 每个存储项调用一次，若返回false，则会中断遍历
+         * 说明：
+         *  - 使用名字索引(第一次调用时建立)，复杂度为O(log n + k)，不会扫描所有存储项
+         *  - 名字按字节顺序比较
+         *  - 名字区域读取失败时返回false(xpack::GetLastError()获取错误代码)
+         */
+        bool ListPrefix(const std::string &prefix, std::function<bool(const std::string &name)> callback);
+        std::vector<std::string> ListPrefix(const std::string &prefix);
+        
+        /*
+         * 列出目录下的直接子项
+         * 参数：
+         *  - dir: 以'/'分隔的目录名，空串表示根目录
+         * 返回值：
+         *  - 按名字顺序排列的子项，子目录以'/'结尾(如"textures/ui/")，存储项为完整的项名
+         */
+        std::vector<std::string> ListDirectory(const std::string &dir);
+        
         /*
          * 获得包整体的大小
          * 注意：
@@ -217,13 +571,25 @@ namespace xpack {
         Stream*  GetStream();
 
         /*
-         * 获得版本号信息，如: "0.9"
+         * 获得包的格式版本(xpack::VERSION或xpack::VERSION_32)
+         * 说明：
+         *  - 旧版本的包在读写过程中保持原有格式
+         */
+        uint16_t GetFormatVersion();
+
+        /*
+         * 获得版本号信息，如: "0.10"
          */
         static std::string GetVersion();
 
     private:
+        friend class EntryWriter;
         const torch::Data* ProcessingBeforeWriting(MetaHash *sct, const torch::Data &data, bool crypto, bool compress);
         bool ProcessingAfterReading(MetaHash *sct, torch::Data &data);
+        bool LoadSegments();
+        bool InternalLoadSegments();
+        void MarkModified();
+        void MakeHandle(const MetaHash *metahash, EntryHandle &outhandle);
 
     private:
         Stream  *m_stream;
@@ -232,9 +598,22 @@ namespace xpack {
         bool     m_modify;
         bool     m_needcrc;
         bool     m_needshrink;
+        bool     m_readonly;
+        uint32_t m_generation;   /* changed by every modification, expires entry handles */
+        
+        AllocPolicy         m_allocpolicy;
+        uint32_t            m_allocmaxchain;
+        uint32_t            m_features;
+        LoadMode            m_loadmode;
+        std::atomic<bool>   m_loaded;
+        bool                m_loadok;
+        xpack::Error        m_loaderror;
+        std::mutex          m_loadmutex;
+        std::thread         m_loader;
         
         torch::Data         m_compressbuffer;
         torch::Data         m_cryptobuffer;
+        torch::Data         m_secretkey;
         torch::crypto::RC4 *m_rc4crypto;
     };
     
@@ -280,6 +659,7 @@ namespace xpack {
          *  - 是否成功执行，若通过callback返回false终端执行，则本方法也会返回false
          * 说明：
          *  - 将other中的存储项合并到main中，other不会被改变
+         *  - 通过CopyEntryFrom复制存储的原始数据，保持原有的压缩/加密方式
          */
         static bool Merge(const std::string &main, const std::string &other, bool force = false, StatusCallback callback = nullptr);
         static bool Merge(Package &main, Package &other, bool force = false, StatusCallback callback = nullptr);
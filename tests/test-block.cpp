@@ -148,10 +148,10 @@ int TestBlockMain() {
         TEST_TRUE(pack.GetContxt()->block->GetBlockReuser()->Size() == 0);
         TEST_TRUE(pack.GetContxt()->block->GetContentReuser()->Size() == 1);
 
-        ok &= pack.RemoveEntry(names[1]);
+        ok &= pack.RemoveEntry(names[1]); // Adjacent to names[0], merged into one free extent
         TEST_TRUE(pack.GetContxt()->block->GetBlockNumber() == 3);
-        TEST_TRUE(pack.GetContxt()->block->GetBlockReuser()->Size() == 0);
-        TEST_TRUE(pack.GetContxt()->block->GetContentReuser()->Size() == 2);
+        TEST_TRUE(pack.GetContxt()->block->GetBlockReuser()->Size() == 1);
+        TEST_TRUE(pack.GetContxt()->block->GetContentReuser()->Size() == 1);
 
         ok &= pack.RemoveEntry(names[2]);
         TEST_TRUE(pack.GetContxt()->block->GetBlockNumber() == 0);
@@ -330,6 +330,127 @@ int TestBlockMain() {
         TEST_TRUE(block2->offset+block2->size == block1->offset);
     }
 
+    { // 测试删除时合并相邻的可重用区域，被合并的Block记录放入Block重用池，之后可以整块重用
+        xpack::Package pack;
+        LoadNextPackage(pack);
+        
+        std::vector<std::string> names;
+        size_t totalsize = 0;
+        for (int i = 0; i < 6; i++) {
+            names.push_back(torch::String::Format("entry%d", i));
+            totalsize += names.back().size();
+            TEST_TRUE(pack.AddEntry(names.back(), torch::Data(names.back().c_str())));
+        }
+        TEST_TRUE(pack.AddEntry("keeper", torch::Data("keeper")));
+        
+        for (int i : { 1, 3, 0, 2, 5, 4 }) {
+            TEST_TRUE(pack.RemoveEntry(names[i]));
+        }
+        xpack::ContentReuser *reuser = pack.GetContxt()->block->GetContentReuser();
+        TEST_TRUE(reuser->Size() == 1);
+        TEST_TRUE(pack.GetContxt()->block->GetByIndex(reuser->GetMinimumSizeEntry())->size == totalsize);
+        TEST_TRUE(pack.GetContxt()->block->GetBlockReuser()->Size() == 5);
+        
+        std::string content(totalsize, 'x');
+        TEST_TRUE(pack.AddEntry("merged", torch::Data(content.c_str())));
+        MetaHash *metahash = pack.GetContxt()->hash->QueryByName("merged");
+        TEST_TRUE(pack.GetContxt()->block->GetByIndex(metahash->block_index)->next_index == -1);
+        TEST_TRUE(reuser->Size() == 0);
+        TEST_TRUE(pack.GetEntryStringByName("merged") == content);
+        TEST_TRUE(pack.GetEntryStringByName("keeper") == "keeper");
+    }
+    
+    { // 测试分配策略：BestFit使用能容纳的最小单块或追加到末尾，BoundedChain限制链长，SmallestFirst从小到大拼接
+        xpack::Package pack;
+        LoadNextPackage(pack);
+        pack.SetAllocPolicy(AllocPolicy::BestFit);
+        
+        auto chainof = [&pack](const std::string &name) {
+            MetaHash *metahash = pack.GetContxt()->hash->QueryByName(name);
+            MetaBlock *metablock = pack.GetContxt()->block->GetByIndex(metahash->block_index);
+            return xpack::Utils::GetBlockIndexChainByMetablock(pack.GetContxt(), metablock);
+        };
+        auto offsetat = [&pack](const std::string &name) {
+            MetaHash *metahash = pack.GetContxt()->hash->QueryByName(name);
+            return pack.GetContxt()->block->GetByIndex(metahash->block_index)->offset;
+        };
+        
+        // Free fragments of 10, 20, 30, 40 bytes, kept apart by other entries
+        uint64_t offset30 = 0;
+        for (int i = 1; i <= 4; i++) {
+            std::string name = torch::String::Format("frag%d", i);
+            TEST_TRUE(pack.AddEntry(name, torch::Data(std::string(i * 10, 'a').c_str())));
+            TEST_TRUE(pack.AddEntry(name + "-keep", torch::Data("keep")));
+            if (i == 3) {
+                offset30 = offsetat(name);
+            }
+        }
+        for (int i = 1; i <= 4; i++) {
+            TEST_TRUE(pack.RemoveEntry(torch::String::Format("frag%d", i)));
+        }
+        TEST_TRUE(pack.GetContxt()->block->GetContentReuser()->Size() == 4);
+        
+        std::string a(25, 'x'), b(50, 'y'), c(55, 'z'), d(20, 'w');
+        TEST_TRUE(pack.AddEntry("a", torch::Data(a.c_str())));
+        TEST_TRUE(chainof("a").size() == 1 && offsetat("a") == offset30);
+        
+        uint64_t tail = pack.GetContxt()->header->Metadata()->content_offset + pack.GetContxt()->header->Metadata()->content_size;
+        TEST_TRUE(pack.AddEntry("b", torch::Data(b.c_str())));
+        TEST_TRUE(chainof("b").size() == 1 && offsetat("b") == tail);
+        
+        pack.SetAllocPolicy(AllocPolicy::BoundedChain, 2);
+        TEST_TRUE(pack.AddEntry("c", torch::Data(c.c_str())));
+        TEST_TRUE(chainof("c").size() == 2); // 40, then the rest best fits in 20
+        TEST_TRUE(pack.GetContxt()->block->GetContentReuser()->Size() == 3);
+        
+        pack.SetAllocPolicy(AllocPolicy::SmallestFirst);
+        TEST_TRUE(pack.AddEntry("d", torch::Data(d.c_str())));
+        TEST_TRUE(chainof("d").size() == 3); // 5 + 5 + 10
+        TEST_TRUE(pack.GetContxt()->block->GetContentReuser()->Size() == 0);
+        
+        TEST_TRUE(pack.GetEntryStringByName("a") == a);
+        TEST_TRUE(pack.GetEntryStringByName("b") == b);
+        TEST_TRUE(pack.GetEntryStringByName("c") == c);
+        TEST_TRUE(pack.GetEntryStringByName("d") == d);
+    }
+    
+    { // 测试ContentReuser使用精确的64位排序键，超过16MB/4GB的offset和size不会并列
+        xpack::ContentReuser reuser;
+        MetaBlock blocks[4] = {
+            { 0x1000001ull,   0x1000001ull, -1, 0 },
+            { 0x1000000ull,   0x1000000ull, -1, 0 },
+            { 0x100000000ull, 0x100000002ull, -1, 0 },
+            { 0x100000001ull, 0x100000001ull, -1, 0 },
+        };
+        for (int32_t i = 0; i < 4; i++) {
+            reuser.UpdateEntry(i, &blocks[i]);
+        }
+        TEST_TRUE(reuser.Size() == 4);
+        TEST_TRUE(reuser.GetMaximumOffsetEntry() == 3);
+        TEST_TRUE(reuser.GetMinimumSizeEntry() == 1);
+        
+        std::vector<int32_t> byoffset, bysize;
+        for (auto x : reuser.GetOrderdByOffsetAscendingIterator()) {
+            byoffset.push_back(x.index);
+        }
+        for (auto x : reuser.GetOrderdBySizeAscendingIterator()) {
+            bysize.push_back(x.index);
+        }
+        TEST_TRUE(byoffset == std::vector<int32_t>({ 1, 0, 2, 3 }));
+        TEST_TRUE(bysize == std::vector<int32_t>({ 1, 0, 3, 2 }));
+        
+        blocks[1].size = 0x100000003ull;
+        reuser.UpdateEntry(1, &blocks[1]);
+        TEST_TRUE(reuser.GetMinimumSizeEntry() == 0);
+        reuser.RemoveEntry(3);
+        reuser.RemoveEntry(3);
+        TEST_TRUE(!reuser.Contains(3));
+        TEST_TRUE(reuser.Size() == 3);
+        TEST_TRUE(reuser.GetMaximumOffsetEntry() == 2);
+        reuser.Clear();
+        TEST_TRUE(reuser.Size() == 0 && reuser.GetMaximumOffsetEntry() == -1);
+    }
+
     InfoLog("> test-block ... ok\n");
     return 0;
 }
@@ -0,0 +1,672 @@
+//
+//  xpack
+//
+//  Created by Luwei.
+//  Copyright (c) 2016年 Luwei. All rights reserved.
+//  Github: https://github.com/Luweimy
+//
+
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include "../src/xpack/torch/torch.h"
+#include "../src/xpack/xpack-context.h"
+#include "../src/xpack/xpack-stream.h"
+#include "../src/xpack/xpack-signature.h"
+#include "../src/xpack/xpack-header.h"
+#include "../src/xpack/xpack-hash.h"
+#include "../src/xpack/xpack-block.h"
+#include "../src/xpack/xpack-name.h"
+#include "../src/xpack/xpack-entry.h"
+#include "../src/xpack/xpack-def.h"
+#include "../src/xpack/xpack-base.h"
+#include "../src/xpack/xpack-util.h"
+#include "test.h"
+
+using namespace xpack;
+
+static std::string LoadNextPackage(xpack::Package &pkg) {
+    static int counter = 0;
+    std::string homedir = torch::Path::GetHomeDir();
+    std::string path = torch::String::Format("%s/.xpacktest/entry%03d", homedir.c_str(), counter++);
+    if (torch::FileSystem::IsPathExist(path)) {
+        torch::FileSystem::Remove(path);
+    }
+    bool ok = pkg.OpenNew(path);
+    if (!ok) {
+        ErrorLog("%s: open new xpack(%s) failed\n", __FUNCTION__, path.c_str());
+    }
+    return path;
+}
+
+static std::string MakeContent(int seed, size_t size) {
+    std::string content;
+    content.reserve(size);
+    uint32_t x = seed * 2654435761u + 1;
+    for (size_t i = 0; i < size; i++) {
+        x = x * 1103515245 + 12345;
+        content.push_back('a' + (x >> 16) % 16); // compressible
+    }
+    return content;
+}
+
+static std::string ReadAll(EntryReader &reader, size_t chunk) {
+    std::string content;
+    std::vector<char> buffer(chunk);
+    while (true) {
+        int64_t rsize = reader.Read(buffer.data(), chunk);
+        TEST_TRUE(rsize >= 0);
+        if (rsize == 0) {
+            break;
+        }
+        content.append(buffer.data(), rsize);
+    }
+    return content;
+}
+
+void TestEntry_Reader() {
+    // 测试：
+    // 1.分块读取存储项(未压缩/压缩/加密/压缩+加密)，内容正确
+    // 2.分块存储(block链)的存储项读取正确
+    // 3.Seek/Tell的正确性(向前、向后、末尾)
+    
+    xpack::Package pack;
+    LoadNextPackage(pack);
+    
+    // Make holes so that later entries are chained
+    for (int i = 0; i < 8; i++) {
+        TEST_TRUE(pack.AddEntry(torch::String::Format("hole%d", i), torch::Data(MakeContent(i, 3000).c_str())));
+        TEST_TRUE(pack.AddEntry(torch::String::Format("keep%d", i), torch::Data("-")));
+    }
+    for (int i = 0; i < 8; i++) {
+        TEST_TRUE(pack.RemoveEntry(torch::String::Format("hole%d", i)));
+    }
+    
+    struct Entry {
+        std::string name;
+        std::string content;
+        bool crypto;
+        bool compress;
+    };
+    std::vector<Entry> entries = {
+        {"stored",            MakeContent(100, 20000), false, false},
+        {"crypto",            MakeContent(101, 70000), true,  false},
+        {"compressed",        MakeContent(102, 90000), false, true},
+        {"crypto-compressed", MakeContent(103, 50000), true,  true},
+        {"small",             "x",                      true,  true},
+    };
+    for (auto &e : entries) {
+        TEST_TRUE(pack.AddEntry(e.name, torch::Data(e.content.c_str()), e.crypto, e.compress));
+    }
+    
+    for (auto &e : entries) {
+        EntryReader reader;
+        TEST_TRUE(pack.OpenEntry(e.name, reader));
+        TEST_TRUE(reader.GetSize() == e.content.size());
+        TEST_TRUE(ReadAll(reader, 777) == e.content);
+        TEST_TRUE(reader.Tell() == e.content.size());
+        
+        char buffer[4096];
+        size_t positions[] = { e.content.size() / 2, 1, e.content.size() - 1, 0, e.content.size() / 3 };
+        for (size_t pos : positions) {
+            if (pos > e.content.size()) {
+                continue;
+            }
+            TEST_TRUE(reader.Seek(pos));
+            TEST_TRUE(reader.Tell() == pos);
+            int64_t rsize = reader.Read(buffer, sizeof(buffer));
+            size_t expect = std::min(sizeof(buffer), e.content.size() - pos);
+            TEST_TRUE(rsize == (int64_t)expect);
+            TEST_TRUE(std::string(buffer, rsize) == e.content.substr(pos, expect));
+        }
+        
+        TEST_TRUE(reader.Seek(e.content.size()));
+        TEST_TRUE(reader.Read(buffer, sizeof(buffer)) == 0);
+        TEST_TRUE(!reader.Seek(e.content.size() + 1));
+    }
+    
+    EntryReader reader;
+    TEST_TRUE(!pack.OpenEntry("notexists", reader));
+    TEST_TRUE(!reader.IsOpen());
+    TEST_TRUE(pack.GetEntryStringByName("stored") == entries[0].content);
+}
+
+void TestEntry_ReaderCrc() {
+    // 测试：
+    // 1.顺序读取到末尾时校验CRC，内容被破坏时读取失败
+    
+    std::string packpath;
+    uint32_t offset = 0;
+    {
+        xpack::Package pack;
+        packpath = LoadNextPackage(pack);
+        TEST_TRUE(pack.AddEntry("crc", torch::Data(MakeContent(7, 10000).c_str())));
+        MetaHash *metahash = pack.GetContxt()->hash->QueryByName("crc");
+        offset = pack.GetContxt()->offset + pack.GetContxt()->block->GetByIndex(metahash->block_index)->offset;
+    }
+    {
+        torch::File f;
+        TEST_TRUE(f.Open(packpath, "rb+"));
+        TEST_TRUE(f.SeekSet(offset + 5000));
+        TEST_TRUE(f.Write("#", 1) == 1);
+    }
+    
+    xpack::Package pack;
+    TEST_TRUE(pack.Open(packpath));
+    EntryReader reader;
+    TEST_TRUE(pack.OpenEntry("crc", reader));
+    char buffer[4096];
+    int64_t rsize = 0;
+    while ((rsize = reader.Read(buffer, sizeof(buffer))) > 0) {
+    }
+    TEST_TRUE(rsize < 0);
+    TEST_TRUE(xpack::GetLastError() == (int)Error::CRC);
+    
+    pack.SetNeedCrcVerify(false);
+    TEST_TRUE(pack.OpenEntry("crc", reader));
+    TEST_TRUE(ReadAll(reader, sizeof(buffer)).size() == 10000);
+}
+
+static bool WriteChunked(EntryWriter &writer, const std::string &content, size_t chunk) {
+    for (size_t pos = 0; pos < content.size(); pos += chunk) {
+        size_t n = std::min(chunk, content.size() - pos);
+        if (!writer.Write(content.data() + pos, n)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TestEntry_Writer() {
+    // 测试：
+    // 1.流式写入存储项(未压缩/压缩/加密/压缩+加密/空)，读取内容与CRC正确
+    // 2.写入的内容跨越多个block(复用空洞)时读取正确
+    // 3.Abort/析构会释放已申请的block，同名存储项创建或提交失败
+    // 4.AddEntryFromFile与重新打开包后读取正确
+    // 5.压缩的存储项单次写入超过一段压缩输入(XPACK_ENTRY_DEFLATESIZE)时内容、大小和CRC正确
+    
+    std::string packpath;
+    struct Entry {
+        std::string name;
+        std::string content;
+        bool crypto;
+        bool compress;
+    };
+    std::vector<Entry> entries = {
+        {"stored",            MakeContent(200, 700000), false, false},
+        {"crypto",            MakeContent(201, 300000), true,  false},
+        {"compressed",        MakeContent(202, 900000), false, true},
+        {"crypto-compressed", MakeContent(203, 50000),  true,  true},
+        {"empty",             "",                       true,  true},
+    };
+    {
+        xpack::Package pack;
+        packpath = LoadNextPackage(pack);
+        
+        // Make holes so that written entries are chained
+        for (int i = 0; i < 8; i++) {
+            TEST_TRUE(pack.AddEntry(torch::String::Format("hole%d", i), torch::Data(MakeContent(i, 3000).c_str())));
+            TEST_TRUE(pack.AddEntry(torch::String::Format("keep%d", i), torch::Data("-")));
+        }
+        for (int i = 0; i < 8; i++) {
+            TEST_TRUE(pack.RemoveEntry(torch::String::Format("hole%d", i)));
+        }
+        
+        for (auto &e : entries) {
+            EntryWriter writer;
+            TEST_TRUE(pack.CreateEntry(e.name, writer, e.crypto, e.compress));
+            TEST_TRUE(writer.IsOpen());
+            TEST_TRUE(WriteChunked(writer, e.content, 1000 + e.content.size() / 7));
+            TEST_TRUE(writer.GetSize() == e.content.size());
+            TEST_TRUE(writer.Commit());
+            TEST_TRUE(!writer.IsOpen());
+        }
+        for (auto &e : entries) {
+            TEST_TRUE(pack.GetEntryStringByName(e.name) == e.content);
+            MetaHash *metahash = pack.GetContxt()->hash->QueryByName(e.name);
+            TEST_TRUE(metahash->crc == torch::crypto::Crc32::Compute((const unsigned char *)e.content.data(), e.content.size()));
+        }
+        
+        // One Write spanning several deflate pieces
+        std::string whole = MakeContent(204, 200000);
+        {
+            EntryWriter writer;
+            TEST_TRUE(pack.CreateEntry("compressed-whole", writer, true, true));
+            TEST_TRUE(writer.Write(whole.data(), whole.size()));
+            TEST_TRUE(writer.GetSize() == whole.size());
+            TEST_TRUE(writer.Commit());
+        }
+        TEST_TRUE(pack.GetUnpackedEntrySizeByName("compressed-whole") == whole.size());
+        TEST_TRUE(pack.GetEntryStringByName("compressed-whole") == whole);
+        MetaHash *wholehash = pack.GetContxt()->hash->QueryByName("compressed-whole");
+        TEST_TRUE(wholehash->crc == torch::crypto::Crc32::Compute((const unsigned char *)whole.data(), whole.size()));
+        
+        // Same content as AddEntry
+        TEST_TRUE(pack.AddEntry("added", torch::Data(entries[3].content.c_str()), true, true));
+        TEST_TRUE(pack.GetEntryStringByName("added") == pack.GetEntryStringByName(entries[3].name));
+        
+        // Abort releases the blocks
+        uint32_t contentsize = pack.GetContxt()->header->Metadata()->content_size;
+        {
+            EntryWriter writer;
+            TEST_TRUE(pack.CreateEntry("aborted", writer));
+            TEST_TRUE(WriteChunked(writer, MakeContent(300, 600000), 4096));
+            TEST_TRUE(pack.GetContxt()->header->Metadata()->content_size > contentsize);
+        }
+        TEST_TRUE(pack.GetContxt()->header->Metadata()->content_size == contentsize);
+        TEST_TRUE(!pack.IsEntryExist("aborted"));
+        
+        // Duplicate name
+        EntryWriter writer;
+        TEST_TRUE(!pack.CreateEntry("stored", writer));
+        TEST_TRUE(xpack::GetLastError() == (int)Error::AlreadyExists);
+        TEST_TRUE(pack.CreateEntry("late", writer));
+        TEST_TRUE(writer.Write("late", 4));
+        TEST_TRUE(pack.AddEntry("late", torch::Data("other")));
+        TEST_TRUE(!writer.Commit());
+        TEST_TRUE(!writer.IsOpen());
+        TEST_TRUE(pack.GetEntryStringByName("late") == "other");
+        
+        // From file
+        std::string filepath = packpath + ".file";
+        TEST_TRUE(torch::File::WriteBytes(filepath, entries[0].content.data(), entries[0].content.size()));
+        TEST_TRUE(pack.AddEntryFromFile("file", filepath, true, true));
+        TEST_TRUE(!pack.AddEntryFromFile("file2", filepath + ".notexists"));
+        torch::FileSystem::Remove(filepath);
+    }
+    
+    xpack::Package pack;
+    TEST_TRUE(pack.Open(packpath));
+    for (auto &e : entries) {
+        EntryReader reader;
+        TEST_TRUE(pack.OpenEntry(e.name, reader));
+        TEST_TRUE(ReadAll(reader, 4096) == e.content);
+    }
+    TEST_TRUE(pack.GetEntryStringByName("file") == entries[0].content);
+}
+
+void TestEntry_Range() {
+    // 测试：
+    // 1.范围读取(未压缩/压缩/加密/压缩+加密)内容正确，跨越block边界正确
+    // 2.超出末尾的长度被截断，起始位置超出大小时失败
+    
+    xpack::Package pack;
+    LoadNextPackage(pack);
+    
+    // Make holes so that later entries are chained
+    for (int i = 0; i < 8; i++) {
+        TEST_TRUE(pack.AddEntry(torch::String::Format("hole%d", i), torch::Data(MakeContent(i, 3000).c_str())));
+        TEST_TRUE(pack.AddEntry(torch::String::Format("keep%d", i), torch::Data("-")));
+    }
+    for (int i = 0; i < 8; i++) {
+        TEST_TRUE(pack.RemoveEntry(torch::String::Format("hole%d", i)));
+    }
+    
+    std::string content = MakeContent(400, 40000);
+    TEST_TRUE(pack.AddEntry("stored", torch::Data(content.c_str())));
+    TEST_TRUE(pack.AddEntry("crypto", torch::Data(content.c_str()), true, false));
+    TEST_TRUE(pack.AddEntry("compressed", torch::Data(content.c_str()), false, true));
+    TEST_TRUE(pack.AddEntry("crypto-compressed", torch::Data(content.c_str()), true, true));
+    MetaHash *metahash = pack.GetContxt()->hash->QueryByName("stored");
+    TEST_TRUE(pack.GetContxt()->block->GetByIndex(metahash->block_index)->next_index >= 0);
+    
+    const char *names[] = { "stored", "crypto", "compressed", "crypto-compressed" };
+    size_t ranges[][2] = { {0, 1}, {0, 40000}, {2999, 2}, {3000, 6001}, {12345, 20000}, {39999, 100}, {40000, 10} };
+    torch::Data data;
+    for (const char *name : names) {
+        for (auto &r : ranges) {
+            TEST_TRUE(pack.GetEntryRange(name, r[0], r[1], data));
+            TEST_TRUE(std::string((const char *)data.GetBytes(), data.GetSize()) == content.substr(r[0], r[1]));
+        }
+        TEST_TRUE(!pack.GetEntryRange(name, 40001, 1, data));
+    }
+    TEST_TRUE(!pack.GetEntryRange("notexists", 0, 1, data));
+}
+
+void TestEntry_Batch() {
+    // 测试：
+    // 1.批量读取(未压缩/压缩/加密/压缩+加密，分块存储)内容正确，每个存储项回调一次
+    // 2.不存在的存储项回调失败，整体返回false
+    // 3.callback返回false时中断读取
+    // 4.超过一次合并读取上限(XPACK_BATCH_RUNSIZE)的存储项单独读取，内容正确
+    
+    xpack::Package pack;
+    LoadNextPackage(pack);
+    
+    // Make holes so that some entries are chained
+    for (int i = 0; i < 16; i++) {
+        TEST_TRUE(pack.AddEntry(torch::String::Format("hole%d", i), torch::Data(MakeContent(i, 1000).c_str())));
+        TEST_TRUE(pack.AddEntry(torch::String::Format("keep%d", i), torch::Data("-")));
+    }
+    for (int i = 0; i < 16; i++) {
+        TEST_TRUE(pack.RemoveEntry(torch::String::Format("hole%d", i)));
+    }
+    
+    std::unordered_map<std::string, std::string> contents;
+    std::vector<std::string> names;
+    for (int i = 0; i < 300; i++) {
+        std::string name = torch::String::Format("batch/%d", i);
+        std::string content = MakeContent(i, 100 + (i * 977) % 9000);
+        TEST_TRUE(pack.AddEntry(name, torch::Data(content.c_str()), i % 3 == 0, i % 2 == 0));
+        contents[name] = content;
+        names.push_back(name);
+    }
+    std::reverse(names.begin(), names.end());
+    
+    std::unordered_map<std::string, int> called;
+    TEST_TRUE(pack.GetEntries(names, [&](const std::string &name, const torch::Data &data, bool status)->bool {
+        TEST_TRUE(status);
+        TEST_TRUE(std::string((const char *)data.GetBytes(), data.GetSize()) == contents[name]);
+        called[name]++;
+        return true;
+    }));
+    TEST_TRUE(called.size() == names.size());
+    for (auto &x : called) {
+        TEST_TRUE(x.second == 1);
+    }
+    
+    names.push_back("notexists");
+    int failed = 0;
+    TEST_TRUE(!pack.GetEntries(names, [&](const std::string &name, const torch::Data &data, bool status)->bool {
+        if (!status) {
+            TEST_TRUE(name == "notexists");
+            TEST_TRUE(xpack::GetLastError() == (int)Error::NotExists);
+            failed++;
+        }
+        return true;
+    }));
+    TEST_TRUE(failed == 1);
+    
+    int count = 0;
+    names.pop_back();
+    TEST_TRUE(!pack.GetEntries(names, [&](const std::string &name, const torch::Data &data, bool status)->bool {
+        return ++count < 10;
+    }));
+    TEST_TRUE(count == 10);
+    
+    // Single extents larger than a merged run, between small ones
+    std::vector<std::string> largenames = { "large/0", names[0], "large/1" };
+    contents["large/0"] = MakeContent(400, 6 * 1024 * 1024);
+    contents["large/1"] = MakeContent(401, 5 * 1024 * 1024);
+    TEST_TRUE(pack.AddEntry("large/0", torch::Data(contents["large/0"].c_str()), false, true));
+    TEST_TRUE(pack.AddEntry("large/1", torch::Data(contents["large/1"].c_str())));
+    called.clear();
+    TEST_TRUE(pack.GetEntries(largenames, [&](const std::string &name, const torch::Data &data, bool status)->bool {
+        TEST_TRUE(status);
+        TEST_TRUE(std::string((const char *)data.GetBytes(), data.GetSize()) == contents[name]);
+        called[name]++;
+        return true;
+    }));
+    TEST_TRUE(called.size() == largenames.size());
+}
+
+void TestEntry_Handle() {
+    // 测试：
+    // 1.通过句柄读取的内容、尺寸与通过名字读取的一致(未压缩/压缩/加密，流式读取)
+    // 2.不存在的存储项返回空句柄
+    // 3.包被修改、关闭后句柄失效，其他包的句柄无效
+    
+    xpack::Package pack;
+    std::string packpath = LoadNextPackage(pack);
+    std::vector<std::string> names;
+    for (int i = 0; i < 16; i++) {
+        std::string name = torch::String::Format("handle/%d", i);
+        TEST_TRUE(pack.AddEntry(name, torch::Data(MakeContent(i, 3000 + i * 100).c_str()), i % 2 == 0, i % 3 == 0));
+        names.push_back(name);
+    }
+    
+    std::vector<xpack::EntryHandle> handles;
+    for (auto &name : names) {
+        xpack::EntryHandle handle = pack.Resolve(name);
+        TEST_TRUE(!handle.IsNull() && pack.IsHandleValid(handle));
+        handles.push_back(handle);
+    }
+    TEST_TRUE(pack.Resolve("handle/notexists").IsNull());
+    TEST_TRUE(xpack::GetLastError() == (int)Error::NotExists);
+    
+    torch::Data buffer;
+    for (size_t i = 0; i < names.size(); i++) {
+        xpack::EntryHandle &handle = handles[i];
+        TEST_TRUE(pack.GetEntrySizeByHandle(handle) == pack.GetEntrySizeByName(names[i]));
+        TEST_TRUE(pack.GetUnpackedEntrySizeByHandle(handle) == pack.GetUnpackedEntrySizeByName(names[i]));
+        TEST_TRUE(handle.IsCrypto() == (i % 2 == 0) && handle.IsCompressed() == (i % 3 == 0));
+        TEST_TRUE(pack.GetEntryDataByHandle(handle, buffer));
+        TEST_TRUE(buffer.ToString() == pack.GetEntryStringByName(names[i]));
+        
+        xpack::EntryReader reader;
+        TEST_TRUE(pack.OpenEntryByHandle(handle, reader));
+        std::string content(reader.GetSize(), '\0');
+        TEST_TRUE(reader.Read(&content[0], content.size()) == (int64_t)content.size());
+        TEST_TRUE(content == buffer.ToString());
+    }
+    
+    // Other packages' handles
+    xpack::Package other;
+    LoadNextPackage(other);
+    TEST_TRUE(!other.IsHandleValid(handles[0]));
+    TEST_TRUE(!other.GetEntryDataByHandle(handles[0], buffer));
+    TEST_TRUE(xpack::GetLastError() == (int)Error::InvalidHandle);
+    TEST_TRUE(!pack.GetEntryDataByHandle(xpack::EntryHandle(), buffer));
+    
+    // Expired by modification
+    TEST_TRUE(pack.RemoveEntry(names[0]));
+    for (auto &handle : handles) {
+        TEST_TRUE(!pack.IsHandleValid(handle));
+    }
+    TEST_TRUE(!pack.GetEntryDataByHandle(handles[1], buffer));
+    TEST_TRUE(xpack::GetLastError() == (int)Error::InvalidHandle);
+    TEST_TRUE(pack.GetEntrySizeByHandle(handles[1]) == 0);
+    
+    // Expired by reopening
+    xpack::EntryHandle handle = pack.Resolve(names[1]);
+    TEST_TRUE(pack.IsHandleValid(handle));
+    pack.Close();
+    TEST_TRUE(pack.Open(packpath));
+    TEST_TRUE(!pack.IsHandleValid(handle));
+    TEST_TRUE(pack.GetEntryDataByHandle(pack.Resolve(names[1]), buffer));
+}
+
+void TestEntry_BulkLookup() {
+    // 测试：
+    // 1.AreEntriesExist与逐个IsEntryExist结果一致(读写打开/只读打开/封存后只读打开)
+    // 2.批量Resolve得到的句柄与逐个Resolve一致，不存在的项为空句柄并返回false
+    
+    std::vector<std::string> names, queries;
+    for (int i = 0; i < 300; i++) {
+        names.push_back(torch::String::Format("bulk/%d", i));
+    }
+    for (int i = 0; i < 450; i++) {
+        queries.push_back(torch::String::Format("bulk/%d", (i * 7) % 450)); // a third not exists
+    }
+    
+    xpack::Package pack;
+    std::string packpath = LoadNextPackage(pack);
+    for (auto &name : names) {
+        TEST_TRUE(pack.AddEntry(name, torch::Data(name.c_str())));
+    }
+    
+    auto check = [&](xpack::Package &pack) {
+        std::vector<bool> exists;
+        TEST_TRUE(pack.AreEntriesExist(queries, exists) == names.size());
+        TEST_TRUE(exists.size() == queries.size());
+        for (size_t i = 0; i < queries.size(); i++) {
+            TEST_TRUE(exists[i] == pack.IsEntryExist(queries[i]));
+        }
+        
+        std::vector<xpack::EntryHandle> handles;
+        TEST_TRUE(!pack.Resolve(queries, handles));
+        TEST_TRUE(xpack::GetLastError() == (int)Error::NotExists);
+        for (size_t i = 0; i < queries.size(); i++) {
+            TEST_TRUE(handles[i].IsNull() == !exists[i]);
+            if (exists[i]) {
+                TEST_TRUE(handles[i].GetHashId() == pack.Resolve(queries[i]).GetHashId());
+                TEST_TRUE(pack.GetEntryStringByName(queries[i]) == queries[i]);
+            }
+        }
+        TEST_TRUE(pack.Resolve(names, handles));
+    };
+    check(pack);
+    pack.Close();
+    
+    TEST_TRUE(pack.Open(packpath));
+    check(pack);
+    pack.Close();
+    
+    TEST_TRUE(pack.Open(packpath, false));
+    TEST_TRUE(pack.Seal());
+    pack.Close();
+    TEST_TRUE(pack.Open(packpath));
+    TEST_TRUE(pack.IsSealed());
+    check(pack);
+    
+    std::vector<bool> exists;
+    TEST_TRUE(pack.AreEntriesExist(std::vector<std::string>(), exists) == 0 && exists.empty());
+}
+
+void TestEntry_Compact() {
+    // 测试：
+    // 1.删除部分存储项后原地整理，按budget分多次完成，无效数据全部清除，包变小
+    // 2.内容原样移动(压缩/加密，超过一次复制块大小的存储项与无效区域重叠移动)，读取和CRC校验正确
+    // 3.整理后句柄失效，重新打开结果一致；只读打开时不支持整理
+    // 4.只移动了内容、包信息未写入时中断，原有的包信息依然可以读取全部内容
+    
+    xpack::Package pack;
+    std::string packpath = LoadNextPackage(pack);
+    std::vector<std::string> names, contents;
+    for (int i = 0; i < 40; i++) {
+        names.push_back(torch::String::Format("compact/%d", i));
+        contents.push_back(MakeContent(i, i == 9 ? 1536 * 1024 : 1000 + i * 150));
+        TEST_TRUE(pack.AddEntry(names[i], torch::Data(contents[i].c_str()), i % 2 == 0, i % 3 == 0));
+    }
+    pack.Close();
+    
+    TEST_TRUE(pack.Open(packpath, false));
+    for (int i = 0; i < 40; i += 2) {
+        TEST_TRUE(pack.RemoveEntry(names[i]));
+    }
+    pack.Close();
+    uint64_t packsize = torch::File::GetBytes(packpath).GetSize();
+    
+    TEST_TRUE(pack.Open(packpath, false));
+    TEST_TRUE(pack.GetUnusedContentSize() > 0);
+    xpack::EntryHandle handle = pack.Resolve(names[1]);
+    uint64_t unused = pack.GetUnusedContentSize();
+    torch::Data before = torch::File::GetBytes(packpath);
+    uint64_t contentbegin = pack.GetContxt()->offset + pack.GetContxt()->header->Metadata()->content_offset;
+    TEST_TRUE(pack.Compact(4096));
+    TEST_TRUE(!pack.IsHandleValid(handle));
+    TEST_TRUE(pack.GetUnusedContentSize() > 0 && pack.GetUnusedContentSize() <= unused);
+    for (int i = 1; i < 40; i += 2) {
+        TEST_TRUE(pack.GetEntryStringByName(names[i]) == contents[i]);
+    }
+    
+    // Moved content on top of the metadata before compacting
+    uint64_t contentend = contentbegin + pack.GetContxt()->header->Metadata()->content_size;
+    torch::Data after = torch::File::GetBytes(packpath);
+    memcpy((char *)before.GetBytes() + contentbegin, (char *)after.GetBytes() + contentbegin, (size_t)(contentend - contentbegin));
+    std::string crashpath = packpath + ".crash";
+    TEST_TRUE(torch::File::WriteBytes(crashpath, before));
+    xpack::Package crashed;
+    crashed.SetNeedCrcVerify(true);
+    TEST_TRUE(crashed.Open(crashpath));
+    for (int i = 1; i < 40; i += 2) {
+        TEST_TRUE(crashed.GetEntryStringByName(names[i]) == contents[i]);
+    }
+    crashed.Close();
+    torch::FileSystem::Remove(crashpath);
+    
+    for (int steps = 0; pack.GetUnusedContentSize() > 0 && steps < 100; steps++) {
+        TEST_TRUE(pack.Compact(64 * 1024));
+    }
+    TEST_TRUE(pack.GetUnusedContentSize() == 0);
+    TEST_TRUE(pack.GetContxt()->block->GetContentReuser()->Size() == 0);
+    TEST_TRUE(pack.Compact());
+    pack.Close();
+    TEST_TRUE(torch::File::GetBytes(packpath).GetSize() < packsize);
+    
+    TEST_TRUE(pack.Open(packpath));
+    TEST_TRUE(!pack.Compact());
+    TEST_TRUE(xpack::GetLastError() == (int)Error::NotSupport);
+    TEST_TRUE(pack.GetEntryNames().size() == 20);
+    for (int i = 1; i < 40; i += 2) {
+        TEST_TRUE(pack.GetEntryStringByName(names[i]) == contents[i]);
+    }
+    TEST_TRUE(!pack.IsEntryExist(names[0]));
+}
+
+void TestEntry_Merge() {
+    // 测试：
+    // 1.CopyEntryFrom/Merge原样复制存储数据，存储尺寸、展开尺寸、CRC校验和内容一致
+    // 2.内容密钥不同时加密项重新加密，仍能正确读取；源包中不存在或目标包已存在时失败
+    // 3.Merge的force覆盖已存在的同名项
+    
+    xpack::Package other;
+    LoadNextPackage(other);
+    std::vector<std::string> names, contents;
+    for (int i = 0; i < 12; i++) {
+        names.push_back(torch::String::Format("merge/%d", i));
+        contents.push_back(MakeContent(i + 100, 500 + i * 300));
+        TEST_TRUE(other.AddEntry(names[i], torch::Data(contents[i].c_str()), i % 2 == 0, i % 3 == 0));
+    }
+    
+    xpack::Package pack;
+    std::string packpath = LoadNextPackage(pack);
+    TEST_TRUE(pack.AddEntry(names[0], torch::Data("old")));
+    TEST_TRUE(!pack.CopyEntryFrom(other, names[0]));
+    TEST_TRUE(xpack::GetLastError() == (int)Error::AlreadyExists);
+    TEST_TRUE(!pack.CopyEntryFrom(other, "merge/none"));
+    TEST_TRUE(xpack::GetLastError() == (int)Error::NotExists);
+    TEST_TRUE(PackageHelper::Merge(pack, other, true));
+    for (int i = 0; i < 12; i++) {
+        TEST_TRUE(pack.GetEntrySizeByName(names[i]) == other.GetEntrySizeByName(names[i]));
+        TEST_TRUE(pack.GetUnpackedEntrySizeByName(names[i]) == contents[i].size());
+        TEST_TRUE(pack.GetEntryStringByName(names[i]) == contents[i]);
+    }
+    pack.Close();
+    
+    pack.SetNeedCrcVerify(true);
+    TEST_TRUE(pack.Open(packpath));
+    for (int i = 0; i < 12; i++) {
+        TEST_TRUE(pack.GetEntryStringByName(names[i]) == contents[i]);
+    }
+    pack.Close();
+    
+    xpack::Package keyed;
+    keyed.SetSecretKey((const unsigned char *)"merge-key", 9);
+    std::string keyedpath = LoadNextPackage(keyed);
+    for (int i = 0; i < 12; i++) {
+        TEST_TRUE(keyed.CopyEntryFrom(other, names[i]));
+        TEST_TRUE(keyed.GetEntrySizeByName(names[i]) == other.GetEntrySizeByName(names[i]));
+        TEST_TRUE(keyed.GetUnpackedEntrySizeByName(names[i]) == contents[i].size());
+        TEST_TRUE(keyed.GetEntryStringByName(names[i]) == contents[i]);
+    }
+    keyed.Close();
+    
+    // 超过一次复制大小、源和目标block链分段不同的存储项
+    std::string large = MakeContent(7, 700 * 1024);
+    TEST_TRUE(other.AddEntry("merge/large", torch::Data(large.c_str()), true));
+    TEST_TRUE(keyed.Open(keyedpath, false));
+    TEST_TRUE(keyed.RemoveEntry(names[3]) && keyed.RemoveEntry(names[7]));
+    TEST_TRUE(keyed.CopyEntryFrom(other, "merge/large"));
+    TEST_TRUE(keyed.GetContxt()->block->GetByIndex(keyed.GetContxt()->hash->QueryByName("merge/large")->block_index)->next_index >= 0);
+    keyed.Close();
+    keyed.SetNeedCrcVerify(true);
+    TEST_TRUE(keyed.Open(keyedpath));
+    TEST_TRUE(keyed.GetEntryStringByName("merge/large") == large);
+    TEST_TRUE(keyed.GetEntryStringByName(names[5]) == contents[5]);
+}
+
+int TestEntryMain() {
+    TestEntry_Reader();
+    TestEntry_ReaderCrc();
+    TestEntry_Writer();
+    TestEntry_Range();
+    TestEntry_Batch();
+    TestEntry_Handle();
+    TestEntry_BulkLookup();
+    TestEntry_Compact();
+    TestEntry_Merge();
+    InfoLog("> test-entry ... ok\n");
+    return 0;
+}
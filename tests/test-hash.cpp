@@ -15,6 +15,8 @@
 #include "../src/xpack/xpack-signature.h"
 #include "../src/xpack/xpack-header.h"
 #include "../src/xpack/xpack-hash.h"
+#include "../src/xpack/xpack-hashtable.h"
+#include "../src/xpack/xpack-perfecthash.h"
 #include "../src/xpack/xpack-block.h"
 #include "../src/xpack/xpack-name.h"
 #include "../src/xpack/xpack-def.h"
@@ -317,10 +319,256 @@ void TestHash_RemoveByName() {
     
 }
 
+void TestHash_Table() {
+    // 测试：
+    // 1.大量插入/删除后查询结果与std::unordered_map一致(包括Robin Hood后移删除)
+    // 2.删除的存储会被重用，MetaHash指针在删除前保持不变
+    // 3.遍历只返回未删除的项
+    
+    xpack::MetaHashTable table;
+    std::unordered_map<uint32_t, MetaHash*> expect;
+    
+    uint32_t seed = 12345;
+    auto next = [&seed]() { seed = seed * 1103515245 + 12345; return seed; };
+    
+    for (int i = 0; i < 50000; i++) {
+        uint32_t hashid = next() % 200000; // Force duplicated hashids
+        MetaHash *metahash = table.Set(hashid);
+        if (expect.count(hashid)) {
+            TEST_TRUE(metahash == nullptr);
+        }
+        else {
+            TEST_TRUE(metahash && metahash->hash == hashid);
+            metahash->crc = hashid;
+            expect[hashid] = metahash;
+        }
+        if (i % 3 == 0) {
+            uint32_t removeid = next() % 200000;
+            TEST_TRUE(table.Remove(removeid) == (expect.erase(removeid) == 1));
+        }
+    }
+    TEST_TRUE(table.Size() == expect.size());
+    
+    for (auto &x : expect) {
+        MetaHash *metahash = table.Get(x.first);
+        TEST_TRUE(metahash == x.second && metahash->crc == x.first);
+    }
+    for (uint32_t hashid = 200000; hashid < 201000; hashid++) {
+        TEST_TRUE(table.Get(hashid) == nullptr);
+    }
+    
+    size_t count = 0;
+    for (auto x : table.GetIterator()) {
+        TEST_TRUE(expect.count(x.first) && expect[x.first] == x.second);
+        count++;
+    }
+    TEST_TRUE(count == expect.size());
+    
+    // Freed storage is reused
+    uint32_t hashid = expect.begin()->first;
+    MetaHash *removed = expect.begin()->second;
+    TEST_TRUE(table.Remove(hashid));
+    TEST_TRUE(table.Set(hashid + 300000) == removed);
+    TEST_TRUE(table.GetMemoryUsage() > 0);
+    
+    table.Clear();
+    TEST_TRUE(table.Size() == 0 && table.Get(hashid + 300000) == nullptr);
+    TEST_TRUE(table.Set(1) != nullptr && table.Size() == 1);
+}
+
+void TestHash_Sorted() {
+    // 测试：
+    // 1.0x000A格式写入时Hash区段按hashid排序，并标记HeaderFeatures::SortedHash
+    // 2.只读打开时直接在排序数据上查找(包括冲突链)，遍历结果正确
+    // 3.只读打开后修改会先建立索引表，0x0009格式不标记排序
+    
+    std::vector<std::string> nameArray;
+    for (int i = 0; i < 1000; i++) {
+        nameArray.push_back("name" + torch::String::ToCppString(i));
+    }
+    
+    xpack::Package pack;
+    std::string packpath = LoadNextPackage(pack);
+    for (auto name : nameArray) {
+        TEST_TRUE(pack.AddEntry(name, torch::Data(name.c_str())));
+    }
+    TEST_TRUE(pack.Flush());
+    TEST_TRUE(pack.GetContxt()->header->Metadata()->features & uint32_t(HeaderFeatures::SortedHash));
+    pack.Close();
+    
+    TEST_TRUE(pack.Open(packpath));
+    TEST_TRUE(pack.GetContxt()->header->Metadata()->features & uint32_t(HeaderFeatures::SortedHash));
+    for (auto name : nameArray) {
+        TEST_TRUE(pack.IsEntryExist(name));
+        TEST_TRUE(pack.GetEntryStringByName(name) == name);
+    }
+    TEST_TRUE(!pack.IsEntryExist("name1000"));
+    TEST_TRUE(pack.GetEntryNames().size() == nameArray.size());
+    
+    uint32_t lasthash = 0;
+    bool first = true, sorted = true;
+    pack.GetContxt()->hash->ForeachMetaHash([&](MetaHash *metahash) {
+        sorted &= first || metahash->hash > lasthash;
+        lasthash = metahash->hash;
+        first = false;
+        return true;
+    });
+    TEST_TRUE(sorted);
+    
+    // Falls back to the hash table before modifying
+    TEST_TRUE(pack.RemoveEntry(nameArray[0]));
+    TEST_TRUE(!pack.IsEntryExist(nameArray[0]));
+    TEST_TRUE(pack.IsEntryExist(nameArray[1]));
+    TEST_TRUE(pack.GetContxt()->hash->GetMetaHashMap()->Size() >= nameArray.size() - 1);
+    pack.Close();
+    
+    { // Conflict chains, hashid -> 10
+        std::vector<std::string> conflictArray = {
+            "name53", "name70", "name87"
+        };
+        xpack::Package pack;
+        std::string packpath = LoadNextPackage(pack);
+        pack.GetContxt()->HashMaker = TestHashString;
+        for (auto name : conflictArray) {
+            TEST_TRUE(pack.AddEntry(name, torch::Data(name.c_str())));
+        }
+        pack.Close();
+        
+        TEST_TRUE(pack.Open(packpath));
+        pack.GetContxt()->HashMaker = TestHashString;
+        for (auto name : conflictArray) {
+            TEST_TRUE(pack.GetEntryStringByName(name) == name);
+        }
+        TEST_TRUE(!pack.IsEntryExist("name0"));
+        TEST_TRUE(pack.GetEntryNames().size() == conflictArray.size());
+    }
+    
+    xpack::Package pack32;
+    std::string packpath32 = torch::String::Format("%s/.xpacktest/hash-sorted32", torch::Path::GetHomeDir().c_str());
+    if (torch::FileSystem::IsPathExist(packpath32)) {
+        torch::FileSystem::Remove(packpath32);
+    }
+    TEST_TRUE(pack32.OpenNew(packpath32, xpack::VERSION_32));
+    for (auto name : nameArray) {
+        TEST_TRUE(pack32.AddEntry(name, torch::Data(name.c_str())));
+    }
+    pack32.Close();
+    TEST_TRUE(pack32.Open(packpath32));
+    TEST_TRUE(pack32.GetContxt()->header->Metadata()->features == 0);
+    for (auto name : nameArray) {
+        TEST_TRUE(pack32.GetEntryStringByName(name) == name);
+    }
+}
+
+void TestHash_Seal() {
+    // 测试：
+    // 1.PerfectHash将所有指纹映射到互不相同的槽位，重复指纹无法构建
+    // 2.Seal()后只读打开直接由完美哈希查询(包括冲突链上的项)
+    // 3.未修改时重新写入保持封存，增删后解除封存，只读打开和0x0009格式不能封存
+    
+    std::vector<uint64_t> fingerprints;
+    for (int i = 0; i < 5000; i++) {
+        fingerprints.push_back(i % 7 == 0 ? 0 : xpack::FingerprintString("name" + torch::String::ToCppString(i)));
+    }
+    torch::Data perfecthash;
+    TEST_TRUE(PerfectHash::Build(fingerprints, perfecthash));
+    TEST_TRUE(PerfectHash::IsValid(perfecthash, (uint32_t)fingerprints.size()));
+    for (size_t i = 0; i < fingerprints.size(); i++) {
+        if (fingerprints[i] != 0) {
+            TEST_TRUE(PerfectHash::Lookup(perfecthash, fingerprints[i]) == i);
+        }
+    }
+    fingerprints.push_back(fingerprints[1]);
+    TEST_TRUE(!PerfectHash::Build(fingerprints, perfecthash));
+    TEST_TRUE(xpack::GetLastError() == (int)Error::NotSupport);
+    
+    std::vector<std::string> nameArray;
+    for (int i = 0; i < 1000; i++) {
+        nameArray.push_back("name" + torch::String::ToCppString(i));
+    }
+    
+    xpack::Package pack;
+    std::string packpath = LoadNextPackage(pack);
+    for (auto name : nameArray) {
+        TEST_TRUE(pack.AddEntry(name, torch::Data(name.c_str())));
+    }
+    TEST_TRUE(!pack.IsSealed());
+    TEST_TRUE(pack.Seal());
+    TEST_TRUE(pack.IsSealed());
+    pack.Close();
+    
+    TEST_TRUE(pack.Open(packpath));
+    TEST_TRUE(pack.GetContxt()->header->Metadata()->features & uint32_t(HeaderFeatures::PerfectHash));
+    TEST_TRUE(pack.IsSealed());
+    for (auto name : nameArray) {
+        TEST_TRUE(pack.GetEntryStringByName(name) == name);
+    }
+    TEST_TRUE(!pack.IsEntryExist("name1000"));
+    TEST_TRUE(pack.GetEntryNames().size() == nameArray.size());
+    TEST_TRUE(!pack.Seal()); // Readonly
+    pack.Close();
+    
+    // Rewritten unchanged, still sealed
+    TEST_TRUE(pack.Open(packpath, false));
+    TEST_TRUE(pack.IsSealed());
+    TEST_TRUE(pack.Flush());
+    pack.Close();
+    TEST_TRUE(pack.Open(packpath));
+    TEST_TRUE(pack.IsSealed());
+    TEST_TRUE(pack.GetEntryStringByName(nameArray[10]) == nameArray[10]);
+    pack.Close();
+    
+    // Modified, seal dropped
+    TEST_TRUE(pack.Open(packpath, false));
+    TEST_TRUE(pack.RemoveEntry(nameArray[0]));
+    TEST_TRUE(!pack.IsSealed());
+    pack.Close();
+    TEST_TRUE(pack.Open(packpath));
+    TEST_TRUE(!pack.IsSealed());
+    TEST_TRUE(!(pack.GetContxt()->header->Metadata()->features & uint32_t(HeaderFeatures::PerfectHash)));
+    TEST_TRUE(!pack.IsEntryExist(nameArray[0]));
+    TEST_TRUE(pack.GetEntryStringByName(nameArray[1]) == nameArray[1]);
+    pack.Close();
+    
+    { // Conflict chains are skipped, HashMaker is not needed any more
+        std::vector<std::string> conflictArray = {
+            "name53", "name70", "name87"
+        };
+        xpack::Package pack;
+        std::string packpath = LoadNextPackage(pack);
+        pack.GetContxt()->HashMaker = TestHashString;
+        for (auto name : conflictArray) {
+            TEST_TRUE(pack.AddEntry(name, torch::Data(name.c_str())));
+        }
+        TEST_TRUE(pack.Seal());
+        pack.Close();
+        
+        TEST_TRUE(pack.Open(packpath));
+        TEST_TRUE(pack.IsSealed());
+        for (auto name : conflictArray) {
+            TEST_TRUE(pack.GetEntryStringByName(name) == name);
+        }
+        TEST_TRUE(!pack.IsEntryExist("name0"));
+    }
+    
+    xpack::Package pack32;
+    std::string packpath32 = torch::String::Format("%s/.xpacktest/hash-seal32", torch::Path::GetHomeDir().c_str());
+    if (torch::FileSystem::IsPathExist(packpath32)) {
+        torch::FileSystem::Remove(packpath32);
+    }
+    TEST_TRUE(pack32.OpenNew(packpath32, xpack::VERSION_32));
+    TEST_TRUE(pack32.AddEntry(nameArray[0], torch::Data(nameArray[0].c_str())));
+    TEST_TRUE(!pack32.Seal());
+    TEST_TRUE(xpack::GetLastError() == (int)Error::NotSupport);
+}
+
 int TestHashMain() {
     TestHash_ReadAndWrite();
     TestHash_AddNew();
     TestHash_RemoveByName();
+    TestHash_Table();
+    TestHash_Sorted();
+    TestHash_Seal();
     InfoLog("> test-hash ... ok\n");
     return 0;
 }
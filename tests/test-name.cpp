@@ -9,6 +9,7 @@
 #include <iostream>
 #include <unordered_map>
 #include <vector>
+#include <algorithm>
 #include "../src/xpack/torch/torch.h"
 #include "../src/xpack/xpack-context.h"
 #include "../src/xpack/xpack-stream.h"
@@ -37,6 +38,355 @@ static std::string LoadNextPackage(xpack::Package &pkg) {
     return path;
 }
 
+static uint32_t TestAliasHashString(const std::string &s, uint8_t seed) {
+    // "alias/N" gets the same hashid as "name/N"
+    if (s.compare(0, 6, "alias/") == 0) {
+        return xpack::HashString("name/" + s.substr(6), seed);
+    }
+    return xpack::HashString(s, seed);
+}
+
+void TestName_Fingerprint() {
+    // 测试：
+    // 1.0x000A格式写入名字指纹(HeaderFeatures::NameFingerprint)
+    // 2.只读打开时通过指纹校验，hashid相同但名字不同的项不存在，Name区段在遍历时才读取
+    // 3.可写打开时通过名字校验，修改后指纹重新写入
+    
+    std::vector<std::string> names;
+    for (int i = 0; i < 200; i++) {
+        names.push_back(torch::String::Format("name/%d", i));
+    }
+    
+    xpack::Package pack;
+    std::string packpath = LoadNextPackage(pack);
+    for (auto &name : names) {
+        TEST_TRUE(pack.AddEntry(name, torch::Data(name.c_str())));
+    }
+    pack.Close();
+    
+    TEST_TRUE(pack.Open(packpath));
+    TEST_TRUE(pack.GetContxt()->header->Metadata()->features & uint32_t(HeaderFeatures::NameFingerprint));
+    TEST_TRUE(pack.GetContxt()->hash->HasFingerprints());
+    pack.GetContxt()->HashMaker = TestAliasHashString;
+    for (int i = 0; i < (int)names.size(); i++) {
+        TEST_TRUE(pack.IsEntryExist(names[i]));
+        TEST_TRUE(pack.GetEntryStringByName(names[i]) == names[i]);
+        TEST_TRUE(!pack.IsEntryExist(torch::String::Format("alias/%d", i)));
+    }
+    TEST_TRUE(pack.GetEntryNames().size() == names.size()); // Names are read here
+    TEST_TRUE(pack.GetContxt()->name->Size() == pack.GetContxt()->header->Metadata()->name_size);
+    pack.Close();
+    
+    TEST_TRUE(pack.Open(packpath, false));
+    TEST_TRUE(!pack.GetContxt()->hash->HasFingerprints());
+    pack.GetContxt()->HashMaker = TestAliasHashString;
+    TEST_TRUE(!pack.IsEntryExist("alias/0"));
+    TEST_TRUE(pack.RemoveEntry(names[0]));
+    TEST_TRUE(pack.AddEntry("name/added", torch::Data("added")));
+    pack.Close();
+    
+    TEST_TRUE(pack.Open(packpath));
+    TEST_TRUE(pack.GetContxt()->hash->HasFingerprints());
+    TEST_TRUE(!pack.IsEntryExist(names[0]));
+    TEST_TRUE(pack.GetEntryStringByName("name/added") == "added");
+    for (size_t i = 1; i < names.size(); i++) {
+        TEST_TRUE(pack.GetEntryStringByName(names[i]) == names[i]);
+    }
+}
+
+void TestName_DeferredFailure() {
+    // 测试：
+    // 1.延迟读取Name区段失败时记录错误代码，遍历/列举接口返回失败，按指纹查询不受影响
+    // 2.失败不会被当作已读取，数据恢复后再次使用时可以正常读取
+    
+    xpack::Package pack;
+    std::string packpath = LoadNextPackage(pack);
+    for (int i = 0; i < 50; i++) {
+        std::string name = torch::String::Format("deferred/%d", i);
+        TEST_TRUE(pack.AddEntry(name, torch::Data(name.c_str())));
+    }
+    pack.Close();
+    torch::Data original = torch::File::GetBytes(packpath);
+    
+    TEST_TRUE(pack.Open(packpath));
+    TEST_TRUE(pack.GetContxt()->hash->HasFingerprints());
+    Context *ctx = pack.GetContxt();
+    uint64_t nameoffset = ctx->offset + ctx->header->Metadata()->hash_offset + ctx->GetHashSegmentSize();
+    {
+        torch::File f;
+        TEST_TRUE(f.Open(packpath, "rb+") && f.ReSize(nameoffset));
+    }
+    
+    xpack::SetLastError((int)xpack::Error::NoErr);
+    TEST_TRUE(!pack.ForeachEntryNames([](const std::string &name) { return true; }));
+    TEST_TRUE(xpack::GetLastError() == (int)Error::Format);
+    TEST_TRUE(pack.GetEntryNames().empty());
+    TEST_TRUE(!pack.ListPrefix("deferred/", [](const std::string &name) { return true; }));
+    TEST_TRUE(pack.ListDirectory("").empty());
+    TEST_TRUE(ctx->name->GetNamePtr(ctx->hash->QueryByName("deferred/1")) == nullptr);
+    TEST_TRUE(pack.IsEntryExist("deferred/1"));
+    TEST_TRUE(pack.GetEntryStringByName("deferred/1") == "deferred/1");
+    
+    TEST_TRUE(torch::File::WriteBytes(packpath, original));
+    TEST_TRUE(pack.GetEntryNames().size() == 50);
+    TEST_TRUE(pack.ListPrefix("deferred/").size() == 50);
+    TEST_TRUE(pack.ListDirectory("") == std::vector<std::string>({ "deferred/" }));
+}
+
+void TestName_Index() {
+    // 测试：
+    // 1.ListPrefix按名字顺序列出前缀下的所有项，ListDirectory只列出直接子项(子目录以'/'结尾)
+    // 2.增删后索引重建，结果正确
+    // 3.0x000A格式写入时Name区段按名字顺序排列(HeaderFeatures::SortedNames)，只读打开结果一致
+    
+    std::vector<std::string> names = {
+        "b", "a/2", "textures/ui/y.png", "a/b/d", "a0", "a/1", "textures/z.png", "a/b2", "a/b/c", "textures/ui/x.png"
+    };
+    
+    xpack::Package pack;
+    std::string packpath = LoadNextPackage(pack);
+    for (auto &name : names) {
+        TEST_TRUE(pack.AddEntry(name, torch::Data(name.c_str())));
+    }
+    
+    auto check = [&](xpack::Package &pack) {
+        TEST_TRUE(pack.ListPrefix("a/") == std::vector<std::string>({ "a/1", "a/2", "a/b/c", "a/b/d", "a/b2" }));
+        TEST_TRUE(pack.ListPrefix("textures/ui/") == std::vector<std::string>({ "textures/ui/x.png", "textures/ui/y.png" }));
+        TEST_TRUE(pack.ListPrefix("zz").empty());
+        TEST_TRUE(pack.ListPrefix("").size() == pack.GetEntryNames().size());
+        TEST_TRUE(pack.ListDirectory("a") == std::vector<std::string>({ "a/1", "a/2", "a/b/", "a/b2" }));
+        TEST_TRUE(pack.ListDirectory("a/") == pack.ListDirectory("a"));
+        TEST_TRUE(pack.ListDirectory("") == std::vector<std::string>({ "a/", "a0", "b", "textures/" }));
+        TEST_TRUE(pack.ListDirectory("textures") == std::vector<std::string>({ "textures/ui/", "textures/z.png" }));
+        TEST_TRUE(pack.ListDirectory("none").empty());
+        
+        size_t count = 0;
+        TEST_TRUE(!pack.ListPrefix("a/", [&count](const std::string &name) {
+            return ++count < 2;
+        }));
+        TEST_TRUE(count == 2);
+    };
+    check(pack);
+    
+    TEST_TRUE(pack.AddEntry("a/b/e", torch::Data("e")));
+    TEST_TRUE(pack.ListPrefix("a/b/") == std::vector<std::string>({ "a/b/c", "a/b/d", "a/b/e" }));
+    TEST_TRUE(pack.RemoveEntry("a/b/e"));
+    TEST_TRUE(pack.ListPrefix("a/b/") == std::vector<std::string>({ "a/b/c", "a/b/d" }));
+    pack.Close();
+    
+    TEST_TRUE(pack.Open(packpath));
+    TEST_TRUE(pack.GetContxt()->header->Metadata()->features & uint32_t(HeaderFeatures::SortedNames));
+    check(pack);
+    std::string sorted = "a/1a/2a/b/ca/b/da/b2a0btextures/ui/x.pngtextures/ui/y.pngtextures/z.png";
+    TEST_TRUE(pack.GetContxt()->name->GetRawNames().ToString() == sorted);
+    check(pack);
+    pack.Close();
+    
+    TEST_TRUE(pack.Open(packpath, false));
+    TEST_TRUE(pack.RemoveEntry("a/1"));
+    TEST_TRUE(pack.ListDirectory("a") == std::vector<std::string>({ "a/2", "a/b/", "a/b2" }));
+    TEST_TRUE(pack.GetEntryStringByName("a/2") == "a/2");
+}
+
+void TestName_FrontCoded() {
+    // 测试：
+    // 1.0x000A格式写入时Name区段按桶前缀压缩(HeaderFeatures::FrontCodedNames)，尺寸明显变小
+    // 2.只读打开时直接在压缩数据上查询/遍历/按前缀列出，名字序号跨越多个桶
+    // 3.可写打开时解码为原始名字，增删后重新压缩写入；0x0009格式不压缩
+    
+    std::vector<std::string> names;
+    size_t rawsize = 0;
+    for (int i = 0; i < 300; i++) {
+        names.push_back(torch::String::Format("assets/textures/ui/icon_%03d.png", i));
+        rawsize += names.back().size();
+    }
+    names.push_back("readme");
+    rawsize += names.back().size();
+    
+    xpack::Package pack;
+    std::string packpath = LoadNextPackage(pack);
+    for (auto &name : names) {
+        TEST_TRUE(pack.AddEntry(name, torch::Data(name.c_str())));
+    }
+    pack.Close();
+    
+    std::vector<std::string> sorted = names;
+    std::sort(sorted.begin(), sorted.end());
+    
+    TEST_TRUE(pack.Open(packpath));
+    TEST_TRUE(pack.GetContxt()->header->Metadata()->features & uint32_t(HeaderFeatures::FrontCodedNames));
+    TEST_TRUE(pack.GetContxt()->header->Metadata()->name_size * 3 < rawsize);
+    TEST_TRUE(pack.GetContxt()->name->IsFrontCoded());
+    for (auto &name : names) {
+        TEST_TRUE(pack.GetEntryStringByName(name) == name);
+    }
+    TEST_TRUE(pack.GetEntryNames() == sorted);
+    TEST_TRUE(pack.ListPrefix("assets/textures/ui/icon_1").size() == 100);
+    TEST_TRUE(pack.ListDirectory("") == std::vector<std::string>({ "assets/", "readme" }));
+    TEST_TRUE(pack.ListPrefix("assets/textures/ui/icon_3").empty());
+    MetaHash *metahash = pack.GetContxt()->hash->QueryByName(names[299]);
+    TEST_TRUE(metahash && metahash->name_offset == 299);
+    TEST_TRUE(pack.GetContxt()->name->GetName(metahash) == names[299]);
+    TEST_TRUE(pack.GetContxt()->name->GetNamePtr(metahash) == nullptr);
+    pack.Close();
+    
+    TEST_TRUE(pack.Open(packpath, false));
+    TEST_TRUE(!pack.GetContxt()->name->IsFrontCoded());
+    TEST_TRUE(pack.GetEntryStringByName(names[10]) == names[10]);
+    TEST_TRUE(pack.RemoveEntry(names[0]));
+    TEST_TRUE(pack.AddEntry("assets/added", torch::Data("added")));
+    pack.Close();
+    
+    TEST_TRUE(pack.Open(packpath));
+    TEST_TRUE(!pack.IsEntryExist(names[0]));
+    TEST_TRUE(pack.GetEntryStringByName("assets/added") == "added");
+    TEST_TRUE(pack.ListDirectory("assets") == std::vector<std::string>({ "assets/added", "assets/textures/" }));
+    TEST_TRUE(pack.GetEntryNames().size() == names.size());
+    pack.Close();
+    
+    std::string path32 = packpath + "-32";
+    if (torch::FileSystem::IsPathExist(path32)) {
+        torch::FileSystem::Remove(path32);
+    }
+    TEST_TRUE(pack.OpenNew(path32, xpack::VERSION_32));
+    for (auto &name : names) {
+        TEST_TRUE(pack.AddEntry(name, torch::Data(name.c_str())));
+    }
+    pack.Close();
+    TEST_TRUE(pack.Open(path32));
+    TEST_TRUE(!(pack.GetContxt()->header->Metadata()->features & uint32_t(HeaderFeatures::FrontCodedNames)));
+    TEST_TRUE(pack.GetContxt()->header->Metadata()->name_size == rawsize);
+    TEST_TRUE(pack.GetEntryStringByName(names[0]) == names[0]);
+    pack.Close();
+    torch::FileSystem::Remove(path32);
+}
+
+void TestName_Features() {
+    // 测试：
+    // 1.SetFeatures关闭可选特性位后写入的包不含对应特性，读取、遍历、按前缀列出正确
+    // 2.FrontCodedNames会自动加上SortedNames；关闭NameFingerprint时不能封存，已封存的包重写后解除封存
+    // 3.已有的包按新的设置重写，恢复默认后重新开启全部特性
+    
+    std::vector<std::string> names;
+    for (int i = 0; i < 100; i++) {
+        names.push_back(torch::String::Format("features/%02d", 99 - i));
+    }
+    uint32_t all = uint32_t(xpack::DEFAULT_FEATURES);
+    uint32_t fingerprint = uint32_t(HeaderFeatures::NameFingerprint);
+    uint32_t frontcoded = uint32_t(HeaderFeatures::FrontCodedNames) | uint32_t(HeaderFeatures::SortedNames);
+    
+    xpack::Package pack;
+    pack.SetFeatures(uint32_t(HeaderFeatures::SortedHash));
+    std::string packpath = LoadNextPackage(pack);
+    for (auto &name : names) {
+        TEST_TRUE(pack.AddEntry(name, torch::Data(name.c_str())));
+    }
+    TEST_TRUE(!pack.Seal());
+    TEST_TRUE(xpack::GetLastError() == (int)Error::NotSupport);
+    pack.Close();
+    
+    xpack::Package reader;
+    TEST_TRUE(reader.Open(packpath));
+    TEST_TRUE(reader.GetContxt()->header->Metadata()->features == uint32_t(HeaderFeatures::SortedHash));
+    TEST_TRUE(!reader.GetContxt()->hash->HasFingerprints());
+    TEST_TRUE(!reader.GetContxt()->name->IsFrontCoded());
+    for (auto &name : names) {
+        TEST_TRUE(reader.GetEntryStringByName(name) == name);
+    }
+    TEST_TRUE(reader.ListPrefix("features/1").size() == 10);
+    TEST_TRUE(reader.GetEntryNames().size() == names.size());
+    reader.Close();
+    
+    pack.SetFeatures(uint32_t(HeaderFeatures::FrontCodedNames));
+    TEST_TRUE(pack.Open(packpath, false));
+    TEST_TRUE(pack.AddEntry("features/added", torch::Data("added")));
+    pack.Close();
+    TEST_TRUE(reader.Open(packpath));
+    TEST_TRUE(reader.GetContxt()->header->Metadata()->features == frontcoded);
+    TEST_TRUE(!reader.GetContxt()->name->IsFrontCoded()); // Without fingerprints names are read and decoded at open
+    TEST_TRUE(reader.ListPrefix("features/0").size() == 10);
+    TEST_TRUE(reader.GetEntryStringByName("features/added") == "added");
+    reader.Close();
+    
+    pack.SetFeatures(all);
+    TEST_TRUE(pack.Open(packpath, false));
+    TEST_TRUE(pack.Seal());
+    pack.Close();
+    TEST_TRUE(reader.Open(packpath));
+    TEST_TRUE(reader.GetContxt()->header->Metadata()->features == (all | uint32_t(HeaderFeatures::PerfectHash)));
+    TEST_TRUE(reader.IsSealed());
+    reader.Close();
+    
+    // Rewritten without fingerprints, the seal is dropped
+    pack.SetFeatures(all & ~fingerprint);
+    TEST_TRUE(pack.Open(packpath, false));
+    TEST_TRUE(pack.Flush());
+    pack.Close();
+    TEST_TRUE(reader.Open(packpath));
+    TEST_TRUE(reader.GetContxt()->header->Metadata()->features == (all & ~fingerprint));
+    TEST_TRUE(!reader.IsSealed());
+    for (auto &name : names) {
+        TEST_TRUE(reader.GetEntryStringByName(name) == name);
+    }
+    TEST_TRUE(reader.GetEntryNames().size() == names.size() + 1);
+}
+
+void TestName_Wildcard() {
+    // 测试：
+    // 1.WildcardPattern提取前缀/后缀，匹配结果与WildcardMatcher::Match一致
+    // 2.语法错误返回与WildcardMatcher相同的错误码
+    // 3.用前缀在有序名字中缩小范围后匹配，结果与全部扫描一致
+    
+    torch::WildcardPattern pattern;
+    TEST_TRUE(pattern.Compile("shaders/*.spv") == 0);
+    TEST_TRUE(pattern.GetPrefix() == "shaders/" && pattern.GetSuffix() == ".spv" && !pattern.IsLiteral());
+    TEST_TRUE(pattern.Compile("a\\*b") == 0);
+    TEST_TRUE(pattern.IsLiteral() && pattern.GetPrefix() == "a*b");
+    TEST_TRUE(pattern.Match("a*b") && !pattern.Match("axb"));
+    TEST_TRUE(pattern.Compile("abc\\") == torch::WildcardMatcher::Match("abc\\", "abcd"));
+    TEST_TRUE(pattern.Compile("x[abc") < 0 && !pattern.Match("xa"));
+    TEST_TRUE(pattern.Compile("x[a-]") < 0);
+    
+    std::vector<std::string> wildcards = {
+        "*", "shaders/*.spv", "shaders/*", "*.spv", "a?c", "a*c*e", "[a-c]*", "[^a]*z", "s*/[bm]*.spv",
+        "shaders/\\[x\\].spv", "abc", "*?", "?*?", "shaders/*/*.spv", "a*[cd]"
+    };
+    std::vector<std::string> targets = {
+        "", "a", "ac", "abc", "abcde", "ace", "acz", "bz", "shaders/", "shaders/main.spv", "shaders/.spv",
+        "shaders/blur.spv.bak", "shaders/post/bloom.spv", "shaders/[x].spv", "shader.spv", "textures/ui.png", "zz"
+    };
+    for (auto &wildcard : wildcards) {
+        TEST_TRUE(pattern.Compile(wildcard) == 0);
+        for (auto &target : targets) {
+            TEST_TRUE(pattern.Match(target) == torch::WildcardMatcher::Match(wildcard, target));
+        }
+    }
+    
+    xpack::Package pack;
+    LoadNextPackage(pack);
+    for (auto &target : targets) {
+        if (!target.empty()) {
+            TEST_TRUE(pack.AddEntry(target, torch::Data(target.c_str())));
+        }
+    }
+    for (auto &wildcard : wildcards) {
+        TEST_TRUE(pattern.Compile(wildcard) == 0);
+        std::vector<std::string> narrowed, scanned;
+        pack.ListPrefix(pattern.GetPrefix(), [&](const std::string &name) {
+            if (pattern.Match(name)) {
+                narrowed.push_back(name);
+            }
+            return true;
+        });
+        for (auto &name : pack.ListPrefix("")) {
+            if (torch::WildcardMatcher::Match(wildcard, name) == 1) {
+                scanned.push_back(name);
+            }
+        }
+        TEST_TRUE(narrowed == scanned);
+    }
+}
+
 int TestNameMain() {
     // 测试name模块的增加和安全删除名称的正确性
     xpack::Package pack;
@@ -79,6 +429,12 @@ int TestNameMain() {
         TEST_TRUE(rawnames.ToHex() == "");
     }
 
+    TestName_Fingerprint();
+    TestName_DeferredFailure();
+    TestName_Index();
+    TestName_FrontCoded();
+    TestName_Features();
+    TestName_Wildcard();
     
     InfoLog("> test-name ... ok\n");
     return 0;
@@ -9,6 +9,7 @@
 #include <iostream>
 #include <unordered_map>
 #include <vector>
+#include <math.h>
 #include "../src/xpack/torch/torch.h"
 #include "../src/xpack/xpack-context.h"
 #include "../src/xpack/xpack-stream.h"
@@ -60,6 +61,82 @@ int TestSignatureMain() {
         TEST_TRUE(pack.GetEntryStringByName("hello") == "hello");
     }
     
+    { // 测试格式版本，默认创建64位格式(0x000A)的包
+        std::string packpath = GetNextPath();
+        torch::FileSystem::Remove(packpath);
+        
+        xpack::Package pack;
+        TEST_TRUE(pack.OpenNew(packpath));
+        TEST_TRUE(pack.GetFormatVersion() == xpack::VERSION);
+        TEST_TRUE(pack.GetContxt()->header->Metadata()->content_offset == sizeof(MetaSignature) + sizeof(MetaHeader));
+        TEST_TRUE(pack.AddEntry("hello", torch::Data("hello")));
+        pack.Close();
+        
+        TEST_TRUE(pack.Open(packpath));
+        TEST_TRUE(pack.GetFormatVersion() == xpack::VERSION);
+        TEST_TRUE(pack.GetEntryStringByName("hello") == "hello");
+        
+        TEST_TRUE(!pack.OpenNew(packpath + ".v8", 0x0008));
+        TEST_TRUE(xpack::GetLastError() == (int)Error::Version);
+    }
+    
+    { // 测试0x0009(32位)格式的包，读写后保持原有格式
+        std::string packpath = GetNextPath();
+        torch::FileSystem::Remove(packpath);
+        std::string content = torch::String::Format("%0*d", 5000, 9);
+        {
+            xpack::Package pack;
+            TEST_TRUE(pack.OpenNew(packpath, xpack::VERSION_32));
+            TEST_TRUE(pack.AddEntry("stored", torch::Data(content.c_str())));
+            TEST_TRUE(pack.AddEntry("crypto-compressed", torch::Data(content.c_str()), true, true));
+            TEST_TRUE(pack.AddEntry("removed", torch::Data(content.c_str())));
+            TEST_TRUE(pack.AddEntry("tail", torch::Data("tail")));
+            TEST_TRUE(pack.RemoveEntry("removed"));
+        }
+        
+        torch::Data head = torch::File::GetBytes(packpath, sizeof(MetaSignature));
+        TEST_TRUE(((uint8_t *)head.GetBytes())[8] == 0x00 && ((uint8_t *)head.GetBytes())[9] == 0x09);
+        
+        {
+            xpack::Package pack;
+            TEST_TRUE(pack.Open(packpath, false));
+            TEST_TRUE(pack.GetFormatVersion() == xpack::VERSION_32);
+            TEST_TRUE(pack.GetContxt()->header->Metadata()->content_offset == sizeof(MetaSignature) + sizeof(MetaHeader32));
+            TEST_TRUE(pack.GetEntryStringByName("stored") == content);
+            TEST_TRUE(pack.GetEntryStringByName("crypto-compressed") == content);
+            TEST_TRUE(pack.AddEntry("chained", torch::Data((content + content).c_str())));
+            
+            // Sizes over 4GB can't be stored in 0x0009 format
+            MetaHash *metahash = pack.GetContxt()->hash->QueryByName("tail");
+            metahash->unpacked_size = (1ull << 32);
+            TEST_TRUE(!pack.Flush());
+            TEST_TRUE(xpack::GetLastError() == (int)Error::Format);
+            metahash->unpacked_size = 4;
+        }
+        
+        xpack::Package pack;
+        TEST_TRUE(pack.Open(packpath));
+        TEST_TRUE(pack.GetFormatVersion() == xpack::VERSION_32);
+        TEST_TRUE(pack.GetEntryStringByName("stored") == content);
+        TEST_TRUE(pack.GetEntryStringByName("chained") == content + content);
+        TEST_TRUE(pack.GetEntryStringByName("tail") == "tail");
+        TEST_TRUE(!pack.IsEntryExist("removed"));
+    }
+    
+    { // 测试包含未知特性位的包无法打开
+        std::string packpath = GetNextPath();
+        torch::FileSystem::Remove(packpath);
+        {
+            xpack::Package pack;
+            TEST_TRUE(pack.OpenNew(packpath));
+            TEST_TRUE(pack.AddEntry("hello", torch::Data("hello")));
+            pack.GetContxt()->header->Metadata()->features = 0x80000000;
+        }
+        xpack::Package pack;
+        TEST_TRUE(!pack.Open(packpath));
+        TEST_TRUE(xpack::GetLastError() == (int)Error::Version);
+    }
+    
     InfoLog("> test-signature ... ok\n");
     return 0;
 }
@@ -0,0 +1,348 @@
+//
+//  xpack
+//
+//  Created by Luwei.
+//  Copyright (c) 2016年 Luwei. All rights reserved.
+//  Github: https://github.com/Luweimy
+//
+
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include "../src/xpack/torch/torch.h"
+#include "../src/xpack/xpack-context.h"
+#include "../src/xpack/xpack-stream.h"
+#include "../src/xpack/xpack-signature.h"
+#include "../src/xpack/xpack-header.h"
+#include "../src/xpack/xpack-hash.h"
+#include "../src/xpack/xpack-block.h"
+#include "../src/xpack/xpack-name.h"
+#include "../src/xpack/xpack-def.h"
+#include "../src/xpack/xpack-base.h"
+#include "../src/xpack/xpack-util.h"
+#include "test.h"
+
+using namespace xpack;
+
+static std::string LoadNextPackage(xpack::Package &pkg) {
+    static int counter = 0;
+    std::string homedir = torch::Path::GetHomeDir();
+    std::string path = torch::String::Format("%s/.xpacktest/stream%03d", homedir.c_str(), counter++);
+    if (torch::FileSystem::IsPathExist(path)) {
+        torch::FileSystem::Remove(path);
+    }
+    bool ok = pkg.OpenNew(path);
+    if (!ok) {
+        ErrorLog("%s: open new xpack(%s) failed\n", __FUNCTION__, path.c_str());
+    }
+    return path;
+}
+
+void TestStream_Mmap() {
+    // 测试：
+    // 1.内存映射流读取的内容与文件流一致(包括压缩、加密、分块存储的文件)
+    // 2.内存映射流不允许写入
+    
+    std::string packpath;
+    std::vector<std::string> nameArray;
+    {
+        xpack::Package pack;
+        packpath = LoadNextPackage(pack);
+        
+        for (int i = 0; i < 64; i++) {
+            std::string name = torch::String::Format("mmap/name%03d", i);
+            std::string content = torch::String::Format("%s:%s", name.c_str(), std::string(i * 7, 'x').c_str());
+            TEST_TRUE(pack.AddEntry(name, torch::Data(content.c_str()), i % 3 == 1, i % 4 == 1));
+            nameArray.push_back(name);
+        }
+        // Make some chained entries
+        for (int i = 0; i < 64; i += 2) {
+            TEST_TRUE(pack.RemoveEntry(nameArray[i]));
+        }
+        for (int i = 0; i < 64; i += 2) {
+            std::string content = torch::String::Format("%s:%s", nameArray[i].c_str(), std::string(i * 13, 'y').c_str());
+            TEST_TRUE(pack.AddEntry(nameArray[i], torch::Data(content.c_str())));
+        }
+    }
+    
+    xpack::Package filepack, mmappack;
+    TEST_TRUE(filepack.Open(packpath));
+    TEST_TRUE(mmappack.Open(packpath, true, StreamType::Mmap));
+    TEST_TRUE(mmappack.GetStream()->Size() == filepack.GetStream()->Size());
+    TEST_TRUE(mmappack.GetEntryNames().size() == nameArray.size());
+    
+    for (auto name : nameArray) {
+        TEST_TRUE(mmappack.IsEntryExist(name));
+        TEST_TRUE(mmappack.GetEntrySizeByName(name) == filepack.GetEntrySizeByName(name));
+        TEST_TRUE(mmappack.GetEntryStringByName(name) == filepack.GetEntryStringByName(name));
+    }
+    
+    char c = 0;
+    TEST_TRUE(!mmappack.GetStream()->PutContent(&c, 1, 0));
+    TEST_TRUE(!mmappack.GetStream()->GetContent(&c, 1, mmappack.GetStream()->Size()));
+    
+    xpack::Package rwpack;
+    TEST_TRUE(!rwpack.Open(packpath, false, StreamType::Mmap));
+}
+
+void TestStream_Fd() {
+    // 测试：
+    // 1.位置读写的正确性(乱序写入、覆盖写入)
+    // 2.缓存的文件大小随写入和ReSize同步更新
+    // 3.64位偏移的读写(FdStream/FileStream)
+    
+    std::string homedir = torch::Path::GetHomeDir();
+    std::string path = torch::String::Format("%s/.xpacktest/stream-fd", homedir.c_str());
+    torch::FileSystem::Remove(path);
+    torch::FileSystem::MakeFile(path);
+    
+    {
+        FdStream stream;
+        TEST_TRUE(stream.Open(path, false));
+        TEST_TRUE(stream.Size() == 0);
+        
+        char wbuf[] = "0123456789";
+        TEST_TRUE(stream.PutContent(wbuf, 10, 100));
+        TEST_TRUE(stream.Size() == 110);
+        TEST_TRUE(stream.PutContent(wbuf, 5, 0));
+        TEST_TRUE(stream.Size() == 110);
+        TEST_TRUE(stream.PutContent(wbuf + 5, 5, 103));
+        
+        char rbuf[11] = {0};
+        TEST_TRUE(stream.GetContent(rbuf, 10, 100));
+        TEST_TRUE(std::string(rbuf) == "0125678989");
+        TEST_TRUE(!stream.GetContent(rbuf, 10, 105));
+        
+        TEST_TRUE(stream.ReSize(50));
+        TEST_TRUE(stream.Size() == 50);
+        TEST_TRUE(!stream.GetContent(rbuf, 1, 50));
+        TEST_TRUE(stream.GetContent(rbuf, 5, 0));
+        TEST_TRUE(std::string(rbuf, 5) == "01234");
+    }
+    
+    FdStream stream;
+    TEST_TRUE(stream.Open(path));
+    TEST_TRUE(stream.Size() == 50);
+    TEST_TRUE(!stream.Open(path + ".notexists"));
+    
+    // 超过4GB的偏移不会被截断(稀疏文件，不占用实际空间)
+    uint64_t faroffset = (5ull << 30) + 7;
+    char wbuf[] = "far";
+    for (int i = 0; i < 2; i++) {
+        Stream *fstream = i == 0 ? (Stream *)new FdStream : (Stream *)new FileStream;
+        char rbuf[4] = {0};
+        TEST_TRUE(fstream->Open(path, false));
+        TEST_TRUE(fstream->PutContent(wbuf, 3, faroffset));
+        TEST_TRUE(fstream->Size() == faroffset + 3);
+        TEST_TRUE(fstream->GetContent(rbuf, 3, faroffset));
+        TEST_TRUE(std::string(rbuf) == "far");
+        TEST_TRUE(fstream->GetContent(rbuf, 3, 0) && std::string(rbuf, 3) == "012");
+        TEST_TRUE(fstream->ReSize(50));
+        TEST_TRUE(fstream->Size() == 50);
+        delete fstream;
+    }
+    torch::FileSystem::Remove(path);
+}
+
+void TestStream_View() {
+    // 测试：
+    // 1.单个block的存储项视图为连续数据，内容正确
+    // 2.分块存储的存储项视图包含多个片段，拼接后内容正确
+    // 3.压缩、加密的存储项以及不支持直接访问的流不能获取视图
+    
+    std::string packpath;
+    {
+        xpack::Package pack;
+        packpath = LoadNextPackage(pack);
+        TEST_TRUE(pack.AddEntry("view/single", torch::Data("single-block-content")));
+        TEST_TRUE(pack.AddEntry("view/hole1", torch::Data("0123456789")));
+        TEST_TRUE(pack.AddEntry("view/sep", torch::Data("-")));
+        TEST_TRUE(pack.AddEntry("view/hole2", torch::Data("abcdefghij")));
+        TEST_TRUE(pack.AddEntry("view/tail", torch::Data("-")));
+        TEST_TRUE(pack.AddEntry("view/compressed", torch::Data("compressed-content"), false, true));
+        TEST_TRUE(pack.AddEntry("view/crypto", torch::Data("crypto-content"), true, false));
+        TEST_TRUE(pack.RemoveEntry("view/hole1"));
+        TEST_TRUE(pack.RemoveEntry("view/hole2"));
+        TEST_TRUE(pack.AddEntry("view/chained", torch::Data("chained-content-in-two-holes")));
+    }
+    
+    xpack::Package pack;
+    TEST_TRUE(pack.Open(packpath, true, StreamType::Mmap));
+    
+    EntryView view = pack.GetEntryView("view/single");
+    TEST_TRUE(view.IsContiguous());
+    TEST_TRUE(std::string((const char*)view.GetBytes(), view.GetSize()) == "single-block-content");
+    
+    TEST_TRUE(pack.GetEntryView("view/chained", view));
+    TEST_TRUE(view.GetSpans().size() > 1);
+    std::string chained;
+    for (auto &span : view.GetSpans()) {
+        chained.append((const char*)span.data, span.size);
+    }
+    TEST_TRUE(chained == "chained-content-in-two-holes");
+    
+    TEST_TRUE(!pack.GetEntryView("view/compressed", view));
+    TEST_TRUE(xpack::GetLastError() == (int)Error::NotSupport);
+    TEST_TRUE(!pack.GetEntryView("view/crypto", view));
+    TEST_TRUE(xpack::GetLastError() == (int)Error::NotSupport);
+    TEST_TRUE(!pack.GetEntryView("view/notexists", view));
+    TEST_TRUE(view.IsNull());
+    
+    xpack::Package filepack;
+    TEST_TRUE(filepack.Open(packpath));
+    TEST_TRUE(!filepack.GetEntryView("view/single", view));
+    TEST_TRUE(xpack::GetLastError() == (int)Error::NotSupport);
+}
+
+void TestStream_ConcurrentRead() {
+    // 测试：
+    // 1.只读模式下多线程同时读取同一个包，内容正确(包括压缩、加密的存储项)
+    // 2.错误代码线程独立
+    
+    std::string packpath;
+    std::vector<std::string> nameArray;
+    {
+        xpack::Package pack;
+        packpath = LoadNextPackage(pack);
+        for (int i = 0; i < 128; i++) {
+            std::string name = torch::String::Format("concurrent/name%03d", i);
+            std::string content = torch::String::Format("%s:%s", name.c_str(), std::string(i * 11, 'z').c_str());
+            TEST_TRUE(pack.AddEntry(name, torch::Data(content.c_str()), i % 2 == 0, i % 3 == 0));
+            nameArray.push_back(name);
+        }
+    }
+    
+    for (auto stype : {StreamType::Fd, StreamType::File, StreamType::Mmap}) {
+        xpack::Package pack;
+        TEST_TRUE(pack.Open(packpath, true, stype));
+        
+        std::atomic<int> failed(0);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 8; t++) {
+            threads.push_back(std::thread([&, t]() {
+                torch::Data buffer;
+                for (int round = 0; round < 16; round++) {
+                    for (size_t i = 0; i < nameArray.size(); i++) {
+                        const std::string &name = nameArray[(i + t * 16) % nameArray.size()];
+                        std::string content = torch::String::Format("%s:%s", name.c_str(), std::string(((i + t * 16) % nameArray.size()) * 11, 'z').c_str());
+                        bool ok = pack.IsEntryExist(name);
+                        ok = ok && pack.GetEntrySizeByName(name) > 0;
+                        ok = ok && pack.GetEntryDataByName(name, buffer);
+                        ok = ok && buffer.ToString() == content;
+                        if (!ok) {
+                            failed++;
+                        }
+                    }
+                    xpack::SetLastError((int)Error::NoErr);
+                    if (pack.IsEntryExist(torch::String::Format("concurrent/notexists%d", t))) {
+                        failed++;
+                    }
+                    if (xpack::GetLastError() != (int)Error::NotExists) {
+                        failed++;
+                    }
+                }
+            }));
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        TEST_TRUE(failed == 0);
+    }
+}
+
+void TestStream_LazyLoad() {
+    // 测试：
+    // 1.Lazy/Background模式下读取内容正确，Lazy模式下多个线程同时触发首次加载
+    // 2.Lazy模式可写打开，修改后内容正确
+    // 3.元数据损坏时Open成功，但访问存储项失败并返回格式错误
+    
+    std::string packpath;
+    std::vector<std::string> nameArray;
+    {
+        xpack::Package pack;
+        packpath = LoadNextPackage(pack);
+        for (int i = 0; i < 64; i++) {
+            std::string name = torch::String::Format("lazy/name%03d", i);
+            TEST_TRUE(pack.AddEntry(name, torch::Data(name.c_str()), i % 2 == 0, i % 3 == 0));
+            nameArray.push_back(name);
+        }
+    }
+    
+    for (auto mode : {LoadMode::Lazy, LoadMode::Background}) {
+        xpack::Package pack;
+        pack.SetLoadMode(mode);
+        TEST_TRUE(pack.Open(packpath));
+        
+        std::atomic<int> failed(0);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 8; t++) {
+            threads.push_back(std::thread([&]() {
+                for (auto &name : nameArray) {
+                    if (pack.GetEntryStringByName(name) != name) {
+                        failed++;
+                    }
+                }
+            }));
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        TEST_TRUE(failed == 0);
+        TEST_TRUE(pack.GetEntryNames().size() == nameArray.size());
+    }
+    
+    {
+        xpack::Package pack;
+        pack.SetLoadMode(LoadMode::Lazy);
+        TEST_TRUE(pack.Open(packpath, false));
+        TEST_TRUE(pack.AddEntry("lazy/added", torch::Data("added")));
+        TEST_TRUE(pack.RemoveEntry(nameArray[0]));
+        pack.Close();
+        
+        TEST_TRUE(pack.Open(packpath));
+        TEST_TRUE(pack.GetEntryStringByName("lazy/added") == "added");
+        TEST_TRUE(!pack.IsEntryExist(nameArray[0]));
+        TEST_TRUE(pack.GetEntryStringByName(nameArray[1]) == nameArray[1]);
+    }
+    
+    // Overwrite the hash segment with garbage
+    uint64_t hashoffset = 0;
+    {
+        xpack::Package pack;
+        TEST_TRUE(pack.Open(packpath));
+        hashoffset = pack.GetContxt()->offset + pack.GetContxt()->header->Metadata()->hash_offset;
+    }
+    {
+        torch::File f;
+        TEST_TRUE(f.Open(packpath, "r+b"));
+        TEST_TRUE(f.SeekSet((long)hashoffset));
+        std::string garbage(256, '\x5A');
+        TEST_TRUE(f.Write(garbage.c_str(), garbage.size()) == garbage.size());
+    }
+    {
+        xpack::Package pack;
+        TEST_TRUE(!pack.Open(packpath));
+        TEST_TRUE(xpack::GetLastError() == (int)Error::Format);
+    }
+    for (auto mode : {LoadMode::Lazy, LoadMode::Background}) {
+        xpack::Package pack;
+        pack.SetLoadMode(mode);
+        TEST_TRUE(pack.Open(packpath));
+        xpack::SetLastError((int)Error::NoErr);
+        TEST_TRUE(!pack.IsEntryExist(nameArray[1]));
+        TEST_TRUE(xpack::GetLastError() == (int)Error::Format);
+        TEST_TRUE(pack.GetEntryStringByName(nameArray[1]).empty());
+    }
+}
+
+int TestStreamMain() {
+    TestStream_Mmap();
+    TestStream_Fd();
+    TestStream_View();
+    TestStream_ConcurrentRead();
+    TestStream_LazyLoad();
+    InfoLog("> test-stream ... ok\n");
+    return 0;
+}
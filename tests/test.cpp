@@ -26,6 +26,8 @@ extern int TestSignatureMain();
 extern int TestNameMain();
 extern int TestHashMain();
 extern int TestBlockMain();
+extern int TestStreamMain();
+extern int TestEntryMain();
 
 #ifdef XPACK_TEST
 
@@ -34,6 +36,8 @@ int main(int argc, const char * argv[]) {
     TestNameMain();
     TestHashMain();
     TestBlockMain();
+    TestStreamMain();
+    TestEntryMain();
     InfoLog("* tests pass.\n");
     return 0;
 }